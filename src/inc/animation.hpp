@@ -0,0 +1,187 @@
+#pragma once
+
+#include "color.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ohtoai::rpi {
+    enum class Easing {
+        linear,
+        ease_in,
+        ease_out,
+        ease_in_out,
+        cubic_in,
+        cubic_out,
+        cubic_in_out,
+        sine,
+        step,
+    };
+
+    inline Easing easing_from_string(const std::string& name) {
+        if (name.empty() || name == "linear") return Easing::linear;
+        if (name == "ease_in") return Easing::ease_in;
+        if (name == "ease_out") return Easing::ease_out;
+        if (name == "ease_in_out") return Easing::ease_in_out;
+        if (name == "cubic_in") return Easing::cubic_in;
+        if (name == "cubic_out") return Easing::cubic_out;
+        if (name == "cubic_in_out") return Easing::cubic_in_out;
+        if (name == "sine") return Easing::sine;
+        if (name == "step") return Easing::step;
+        throw std::invalid_argument("easing_from_string " + name);
+    }
+
+    /// @brief t in [0, 1] to eased progress in [0, 1]
+    inline float ease(Easing easing, float t) {
+        switch (easing) {
+            case Easing::linear: return t;
+            case Easing::ease_in: return t * t;
+            case Easing::ease_out: return t * (2 - t);
+            case Easing::ease_in_out: return t < 0.5f ? 2 * t * t : -1 + (4 - 2 * t) * t;
+            case Easing::cubic_in: return t * t * t;
+            case Easing::cubic_out: return 1 + (t - 1) * (t - 1) * (t - 1);
+            case Easing::cubic_in_out: return t < 0.5f ? 4 * t * t * t : 1 + 4 * (t - 1) * (t - 1) * (t - 1);
+            case Easing::sine: return 0.5f - 0.5f * std::cos(t * 3.14159265f);
+            case Easing::step: return t < 1 ? 0.0f : 1.0f;
+        }
+        return t;
+    }
+
+    /// @brief easing applies to the segment starting at this keyframe
+    struct Keyframe {
+        uint32_t time_ms;
+        double value;
+        Easing easing = Easing::linear;
+    };
+
+    /// @brief Keyframed values of one property, numbers are interpolated linearly, colors per channel
+    ///
+    /// Values must be finite, color values within [0, 0xffffffff]; the animate handler checks both.
+    class Track {
+    public:
+        Track(std::vector<Keyframe> keys, bool color = false) : keys_(std::move(keys)), color_(color) {
+            if (keys_.empty()) {
+                throw std::invalid_argument("Track needs at least one keyframe");
+            }
+            std::stable_sort(keys_.begin(), keys_.end(), [](const auto& a, const auto& b) { return a.time_ms < b.time_ms; });
+        }
+
+        double value(uint32_t ms) const {
+            auto next = std::upper_bound(keys_.begin(), keys_.end(), ms, [](uint32_t t, const auto& key) { return t < key.time_ms; });
+            if (next == keys_.begin()) {
+                return keys_.front().value;
+            }
+            if (next == keys_.end()) {
+                return keys_.back().value;
+            }
+            const auto& from = *std::prev(next);
+            const float t = ease(from.easing, static_cast<float>(ms - from.time_ms) / (next->time_ms - from.time_ms));
+            if (color_) {
+                return mix(static_cast<LedColor>(from.value), static_cast<LedColor>(next->value),
+                    static_cast<uint8_t>(std::clamp(t, 0.0f, 1.0f) * 255));
+            }
+            return from.value + (next->value - from.value) * t;
+        }
+
+        uint32_t duration() const { return keys_.back().time_ms; }
+    private:
+        std::vector<Keyframe> keys_;
+        bool color_;
+    };
+
+    /// @brief Tracks bound to property setters, played from the time it is started
+    class Animation {
+    public:
+        using Setter = std::function<void(double)>;
+
+        explicit Animation(bool loop = false) : loop_(loop) {}
+
+        Animation& add(Track track, Setter setter) {
+            duration_ = std::max(duration_, track.duration());
+            bindings_.push_back({std::move(track), std::move(setter)});
+            return *this;
+        }
+
+        /// @brief apply every track at ms after the start, false once a non looping animation has played its last frame
+        bool evaluate(uint32_t ms) const {
+            const bool finished = !loop_ && ms >= duration_;
+            if (loop_ && duration_ > 0) {
+                ms %= duration_;
+            }
+            for (const auto& binding : bindings_) {
+                binding.setter(binding.track.value(ms));
+            }
+            return !finished;
+        }
+
+        uint32_t duration() const { return duration_; }
+    private:
+        struct Binding {
+            Track track;
+            Setter setter;
+        };
+
+        std::vector<Binding> bindings_;
+        uint32_t duration_ = 0;
+        bool loop_;
+    };
+
+    /// @brief Running animations, evaluated once per frame by a scheduler task
+    class AnimationEngine {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        int start(Animation animation, Clock::time_point now = Clock::now()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto id = next_id_++;
+            running_.emplace(id, Running{std::move(animation), now});
+            spdlog::debug("AnimationEngine::start {} {}ms", id, running_.at(id).animation.duration());
+            return id;
+        }
+
+        bool stop(int id) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return running_.erase(id) != 0;
+        }
+
+        /// @brief apply every animation at now, finished ones are dropped after their last frame, returns how many ran
+        size_t evaluate(Clock::time_point now) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto count = running_.size();
+            for (auto it = running_.begin(); it != running_.end();) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - it->second.start).count();
+                bool keep = false;
+                try {
+                    keep = it->second.animation.evaluate(static_cast<uint32_t>(std::max<int64_t>(elapsed, 0)));
+                }
+                catch (const std::exception& e) {
+                    // the animated object went away
+                    spdlog::warn("AnimationEngine::evaluate {} stopped: {}", it->first, e.what());
+                }
+                it = keep ? std::next(it) : running_.erase(it);
+            }
+            return count;
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return running_.size();
+        }
+    private:
+        struct Running {
+            Animation animation;
+            Clock::time_point start;
+        };
+
+        mutable std::mutex mutex_;
+        std::map<int, Running> running_;
+        int next_id_ = 0;
+    };
+}
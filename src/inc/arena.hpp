@@ -0,0 +1,213 @@
+#pragma once
+
+#include "render.hpp"
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory_resource>
+#include <new>
+
+namespace ohtoai::rpi {
+    /// @brief Process wide heap allocation counter, fed by a replaced global operator new when COUNT_ALLOCATIONS is defined
+    class AllocationCounter {
+    public:
+        static void record() { count_.fetch_add(1, std::memory_order_relaxed); }
+        static uint64_t count() { return count_.load(std::memory_order_relaxed); }
+    private:
+        static inline std::atomic<uint64_t> count_{0};
+    };
+
+    /// @brief Monotonic memory resource over a fixed buffer for transient per-frame objects
+    ///
+    /// Allocations that do not fit fall back to the heap and are counted as overflows.
+    /// Memory is given back in one go by a Scope or reset().
+    class FrameArena : public std::pmr::memory_resource {
+    public:
+        explicit FrameArena(size_t capacity = 16 * 1024)
+            : buffer_(new std::byte[capacity]), capacity_(capacity) {}
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+
+        /// @brief gives back everything allocated from the arena during the lifetime of the scope
+        class Scope {
+        public:
+            explicit Scope(FrameArena& arena) : arena_(arena), mark_(arena.offset_) {}
+            ~Scope() { arena_.offset_ = mark_; }
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+            FrameArena& arena() { return arena_; }
+        private:
+            FrameArena& arena_;
+            size_t mark_;
+        };
+
+        /// @brief arena of the calling thread, rpc handlers run on several io threads
+        static FrameArena& local() {
+            thread_local FrameArena arena;
+            return arena;
+        }
+
+        void reset() { offset_ = 0; }
+        size_t capacity() const { return capacity_; }
+        size_t used() const { return offset_; }
+        size_t peak() const { return peak_; }
+        uint64_t allocations() const { return allocations_; }
+        uint64_t overflows() const { return overflows_; }
+        /// @brief overflows of every arena in the process
+        static uint64_t total_overflows() { return total_overflows_.load(std::memory_order_relaxed); }
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            auto aligned = (offset_ + alignment - 1) & ~(alignment - 1);
+            if (aligned + bytes <= capacity_) {
+                offset_ = aligned + bytes;
+                peak_ = std::max(peak_, offset_);
+                ++allocations_;
+                return buffer_.get() + aligned;
+            }
+            ++overflows_;
+            total_overflows_.fetch_add(1, std::memory_order_relaxed);
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            auto ptr = static_cast<std::byte*>(p);
+            if (ptr >= buffer_.get() && ptr < buffer_.get() + capacity_) {
+                return;
+            }
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    private:
+        std::unique_ptr<std::byte[]> buffer_;
+        size_t capacity_;
+        size_t offset_ = 0;
+        size_t peak_ = 0;
+        uint64_t allocations_ = 0;
+        uint64_t overflows_ = 0;
+        static inline std::atomic<uint64_t> total_overflows_{0};
+    };
+
+    /// @brief Fixed number of preallocated slots for objects of type T
+    template <typename T>
+    class ObjectPool {
+    public:
+        explicit ObjectPool(size_t capacity)
+            : slots_(new Slot[capacity]), capacity_(capacity) {
+            for (size_t i = 0; i < capacity; ++i) {
+                slots_[i].next = i + 1 < capacity ? &slots_[i + 1] : nullptr;
+            }
+            free_ = capacity > 0 ? &slots_[0] : nullptr;
+        }
+        ObjectPool(const ObjectPool&) = delete;
+        ObjectPool& operator=(const ObjectPool&) = delete;
+        ~ObjectPool() {
+            if (used_ != 0) {
+                spdlog::warn("ObjectPool::~ObjectPool {} objects still alive", used_);
+            }
+        }
+
+        template <typename... Args>
+        T* create(Args&&... args) {
+            if (!free_) {
+                throw std::bad_alloc();
+            }
+            auto slot = free_;
+            // the object overwrites the link, read it first
+            auto next = slot->next;
+            auto object = new (slot->storage) T(std::forward<Args>(args)...);
+            free_ = next;
+            ++used_;
+            return object;
+        }
+
+        void destroy(T* object) {
+            if (!object) {
+                return;
+            }
+            object->~T();
+            auto slot = reinterpret_cast<Slot*>(object);
+            slot->next = free_;
+            free_ = slot;
+            --used_;
+        }
+
+        size_t capacity() const { return capacity_; }
+        size_t used() const { return used_; }
+    private:
+        union Slot {
+            Slot* next;
+            alignas(T) std::byte storage[sizeof(T)];
+        };
+
+        std::unique_ptr<Slot[]> slots_;
+        size_t capacity_;
+        Slot* free_ = nullptr;
+        size_t used_ = 0;
+    };
+
+    /// @brief Fixed capacity led storage, blocks are carved out of one contiguous buffer with a first-fit free list
+    class LedArena {
+    public:
+        explicit LedArena(size_t capacity)
+            : buffer_(capacity) {
+            if (capacity > 0) {
+                free_[0] = capacity;
+            }
+        }
+        LedArena(const LedArena&) = delete;
+        LedArena& operator=(const LedArena&) = delete;
+
+        LedColor* allocate(size_t n) {
+            if (n == 0) {
+                n = 1;
+            }
+            for (auto it = free_.begin(); it != free_.end(); ++it) {
+                if (it->second < n) {
+                    continue;
+                }
+                auto offset = it->first;
+                auto length = it->second;
+                free_.erase(it);
+                if (length > n) {
+                    free_[offset + n] = length - n;
+                }
+                used_ += n;
+                return buffer_.data() + offset;
+            }
+            throw std::bad_alloc();
+        }
+
+        void deallocate(LedColor* p, size_t n) {
+            if (n == 0) {
+                n = 1;
+            }
+            auto offset = static_cast<size_t>(p - buffer_.data());
+            auto it = free_.emplace(offset, n).first;
+            // merge with the following block
+            auto next = std::next(it);
+            if (next != free_.end() && it->first + it->second == next->first) {
+                it->second += next->second;
+                free_.erase(next);
+            }
+            // merge with the preceding block
+            if (it != free_.begin()) {
+                auto prev = std::prev(it);
+                if (prev->first + prev->second == it->first) {
+                    prev->second += it->second;
+                    free_.erase(it);
+                }
+            }
+            used_ -= n;
+        }
+
+        size_t capacity() const { return buffer_.size(); }
+        size_t used() const { return used_; }
+    private:
+        std::vector<LedColor> buffer_;
+        std::map<size_t, size_t> free_;
+        size_t used_ = 0;
+    };
+}
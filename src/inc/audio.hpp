@@ -0,0 +1,499 @@
+#pragma once
+
+#include "effect.hpp"
+#include "stream.hpp"
+#include <spdlog/spdlog.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ohtoai::rpi {
+    /// @brief layout of raw 16 bit little endian input, wav files bring their own
+    struct PcmFormat {
+        int sample_rate = 44100;
+        int channels = 2;
+    };
+
+    /// @brief 16 bit PCM from a wav file, a raw file, a FIFO or stdin, mixed down to mono floats
+    class PcmReader {
+    public:
+        /// @brief "-" reads stdin, anything else is opened as a file or FIFO
+        explicit PcmReader(const std::string& path, PcmFormat raw = {}) : stream_(path), format_(raw) {}
+
+        /// @brief wait for a wav header, or for the first bytes of raw input, until stop is set
+        ///
+        /// Separate from the constructor so opening a FIFO does not wait for its writer. False when the stream
+        /// ended or stop was set first, throws on a wav file that is not 16 bit PCM.
+        bool read_header(const std::atomic_bool& stop) {
+            std::array<uint8_t, 12> riff{};
+            if (!stream_.read_exact(riff.data(), riff.size(), stop)) {
+                return false;
+            }
+            if (std::memcmp(riff.data(), "RIFF", 4) != 0 || std::memcmp(riff.data() + 8, "WAVE", 4) != 0) {
+                // raw samples, kept for the first read
+                pending_.assign(riff.begin(), riff.end());
+                return valid();
+            }
+            for (;;) {
+                std::array<uint8_t, 8> chunk{};
+                if (!stream_.read_exact(chunk.data(), chunk.size(), stop)) {
+                    return false;
+                }
+                const uint32_t size = le32(chunk.data() + 4);
+                if (std::memcmp(chunk.data(), "data", 4) == 0) {
+                    return valid();
+                }
+                // chunks are padded to even sizes, 64 bits so a size of 0xffffffff does not wrap
+                uint64_t left = uint64_t{size} + (size & 1);
+                if (std::memcmp(chunk.data(), "fmt ", 4) == 0) {
+                    // only the first 16 bytes matter, extensible headers are a little longer
+                    std::array<uint8_t, max_fmt_bytes> body{};
+                    const auto n = static_cast<size_t>(std::min<uint64_t>(left, body.size()));
+                    if (!stream_.read_exact(body.data(), n, stop)) {
+                        return false;
+                    }
+                    left -= n;
+                    if (size < 16 || le16(body.data()) != 1 || le16(body.data() + 14) != 16) {
+                        throw std::invalid_argument("PcmReader only reads 16 bit PCM wav");
+                    }
+                    format_.channels = le16(body.data() + 2);
+                    format_.sample_rate = static_cast<int>(le32(body.data() + 4));
+                }
+                if (!skip(left, stop)) {
+                    return false;
+                }
+            }
+        }
+
+        const PcmFormat& format() const { return format_; }
+        /// @brief a regular file is read faster than real time, the caller paces it
+        bool regular_file() const { return stream_.regular_file(); }
+        bool eof() const { return stream_.eof(); }
+
+        /// @brief up to max mono samples in [-1, 1], waits at most timeout_ms for data, 0 on timeout or at the end
+        size_t read(float* dst, size_t max, int timeout_ms = 100) {
+            const size_t frame = static_cast<size_t>(format_.channels) * 2;
+            raw_.resize(max * frame);
+            size_t have = std::min(pending_.size(), raw_.size());
+            std::copy_n(pending_.begin(), have, raw_.begin());
+            pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(have));
+            if (have < frame) {
+                have += stream_.read_some(raw_.data() + have, raw_.size() - have, timeout_ms);
+            }
+            const size_t frames = have / frame;
+            // a partial frame waits for the rest of it
+            pending_.insert(pending_.begin(), raw_.begin() + static_cast<std::ptrdiff_t>(frames * frame), raw_.begin() + static_cast<std::ptrdiff_t>(have));
+            const float scale = 1.0f / (32768.0f * format_.channels);
+            for (size_t i = 0; i < frames; ++i) {
+                int sum = 0;
+                for (int c = 0; c < format_.channels; ++c) {
+                    const uint8_t* p = raw_.data() + i * frame + c * 2;
+                    sum += static_cast<int16_t>(p[0] | p[1] << 8);
+                }
+                dst[i] = sum * scale;
+            }
+            return frames;
+        }
+    private:
+        static constexpr size_t max_fmt_bytes = 64;
+
+        /// @brief read and drop n bytes in small pieces, a chunk may claim gigabytes
+        bool skip(uint64_t n, const std::atomic_bool& stop) {
+            std::array<uint8_t, 256> scratch;
+            while (n > 0) {
+                const auto piece = static_cast<size_t>(std::min<uint64_t>(n, scratch.size()));
+                if (!stream_.read_exact(scratch.data(), piece, stop)) {
+                    return false;
+                }
+                n -= piece;
+            }
+            return true;
+        }
+
+        bool valid() const {
+            if (format_.sample_rate <= 0 || format_.channels <= 0) {
+                throw std::invalid_argument(fmt::format("PcmReader {}Hz {} channels", format_.sample_rate, format_.channels));
+            }
+            spdlog::debug("PcmReader {}Hz {} channels{}", format_.sample_rate, format_.channels, stream_.regular_file() ? ", file" : "");
+            return true;
+        }
+
+        static uint32_t le32(const uint8_t* p) { return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24; }
+        static uint16_t le16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+
+        InputStream stream_;
+        PcmFormat format_;
+        std::vector<uint8_t> pending_;
+        std::vector<uint8_t> raw_;
+    };
+
+    /// @brief In place radix 2 FFT, twiddles and the bit reversal permutation are computed once
+    class Fft {
+    public:
+        explicit Fft(size_t n) : n_(n), twiddles_(n / 2), reversed_(n) {
+            if (n < 2 || (n & (n - 1)) != 0) {
+                throw std::invalid_argument(fmt::format("Fft size {}", n));
+            }
+            for (size_t i = 0; i < n / 2; ++i) {
+                twiddles_[i] = std::polar(1.0f, static_cast<float>(-2 * 3.14159265358979 * i / n));
+            }
+            size_t bits = 0;
+            while ((size_t{1} << bits) < n) {
+                ++bits;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                size_t r = 0;
+                for (size_t b = 0; b < bits; ++b) {
+                    r |= (i >> b & 1) << (bits - 1 - b);
+                }
+                reversed_[i] = r;
+            }
+        }
+
+        size_t size() const { return n_; }
+
+        void transform(std::complex<float>* data) const {
+            for (size_t i = 0; i < n_; ++i) {
+                if (i < reversed_[i]) {
+                    std::swap(data[i], data[reversed_[i]]);
+                }
+            }
+            for (size_t len = 2; len <= n_; len <<= 1) {
+                const size_t half = len / 2;
+                const size_t stride = n_ / len;
+                for (size_t start = 0; start < n_; start += len) {
+                    for (size_t k = 0; k < half; ++k) {
+                        const auto odd = data[start + k + half] * twiddles_[k * stride];
+                        data[start + k + half] = data[start + k] - odd;
+                        data[start + k] += odd;
+                    }
+                }
+            }
+        }
+    private:
+        size_t n_;
+        std::vector<std::complex<float>> twiddles_;
+        std::vector<size_t> reversed_;
+    };
+
+    /// @brief one analysed block, bands in [0, 1] from low to high frequencies
+    struct Spectrum {
+        static constexpr size_t max_bands = 128;
+        std::array<float, max_bands> bands{};
+        size_t count = 0;
+        /// @brief loudest band before smoothing
+        float level = 0;
+        bool beat = false;
+        /// @brief beats so far, a reader that skipped the block with the beat still sees the count move
+        uint32_t beats = 0;
+    };
+
+    /// @brief Streaming spectrum: Hann windowed FFT blocks with 50% overlap, log spaced bands, smoothing and beats
+    ///
+    /// Band values are the loudest bin of the band in dB, -60 dB to full scale mapped onto [0, 1], rising by attack
+    /// and falling by release of the distance each block. A beat is bass energy well above its average of the
+    /// last second, at most one per 250 ms.
+    class SpectrumAnalyzer {
+    public:
+        SpectrumAnalyzer(int sample_rate, size_t bands, size_t fft_size = 1024, float min_hz = 40, float max_hz = 16000)
+            : fft_(fft_size), window_(fft_size), block_(fft_size), buffer_(fft_size), magnitudes_(fft_size / 2),
+            hop_(fft_size / 2), rate_(sample_rate) {
+            if (bands == 0 || bands > Spectrum::max_bands) {
+                throw std::invalid_argument(fmt::format("SpectrumAnalyzer {} bands", bands));
+            }
+            for (size_t i = 0; i < fft_size; ++i) {
+                window_[i] = 0.5f - 0.5f * std::cos(2 * 3.14159265f * i / fft_size);
+            }
+            max_hz = std::min(max_hz, sample_rate / 2.0f);
+            const float bin_hz = static_cast<float>(sample_rate) / fft_size;
+            size_t first = 1;
+            for (size_t b = 0; b < bands; ++b) {
+                const float upper = min_hz * std::pow(max_hz / min_hz, static_cast<float>(b + 1) / bands);
+                // every band gets at least one bin, the low ones share the resolution the FFT has
+                const size_t last = std::clamp(static_cast<size_t>(upper / bin_hz), first, fft_size / 2 - 1);
+                ranges_.push_back({first, last});
+                first = std::min(last + 1, fft_size / 2 - 1);
+            }
+            bass_last_ = std::max<size_t>(1, static_cast<size_t>(150 / bin_hz));
+            history_size_ = std::max<size_t>(1, static_cast<size_t>(sample_rate / hop_));
+            refractory_ = std::max<size_t>(1, static_cast<size_t>(sample_rate / 4 / hop_));
+            spectrum_.count = bands;
+        }
+
+        /// @brief fractions of the distance to the new value per block, for rising and falling bands
+        void set_smoothing(float attack, float release) {
+            attack_ = std::clamp(attack, 0.0f, 1.0f);
+            release_ = std::clamp(release, 0.0f, 1.0f);
+        }
+
+        /// @brief feed mono samples, on_block(spectrum) runs for every block completed
+        template <typename Fn>
+        void push(const float* samples, size_t n, Fn&& on_block) {
+            for (size_t i = 0; i < n; ++i) {
+                buffer_[filled_++] = samples[i];
+                if (filled_ == buffer_.size()) {
+                    analyse();
+                    on_block(static_cast<const Spectrum&>(spectrum_));
+                    std::copy(buffer_.begin() + hop_, buffer_.end(), buffer_.begin());
+                    filled_ -= hop_;
+                }
+            }
+        }
+
+        const Spectrum& spectrum() const { return spectrum_; }
+        int sample_rate() const { return rate_; }
+        /// @brief samples between blocks
+        size_t hop() const { return hop_; }
+    private:
+        void analyse() {
+            const size_t n = fft_.size();
+            for (size_t i = 0; i < n; ++i) {
+                block_[i] = {buffer_[i] * window_[i], 0.0f};
+            }
+            fft_.transform(block_.data());
+            // a full scale sine peaks at n / 4 through the Hann window
+            const float norm = 4.0f / n;
+            for (size_t i = 0; i < magnitudes_.size(); ++i) {
+                magnitudes_[i] = std::abs(block_[i]) * norm;
+            }
+            float level = 0;
+            for (size_t b = 0; b < ranges_.size(); ++b) {
+                float peak = 0;
+                for (size_t i = ranges_[b].first; i <= ranges_[b].second; ++i) {
+                    peak = std::max(peak, magnitudes_[i]);
+                }
+                const float db = 20 * std::log10(std::max(peak, 1e-6f));
+                const float target = std::clamp((db + 60) / 60, 0.0f, 1.0f);
+                level = std::max(level, target);
+                auto& band = spectrum_.bands[b];
+                band += (target - band) * (target > band ? attack_ : release_);
+            }
+            spectrum_.level = level;
+
+            float energy = 0;
+            for (size_t i = 1; i <= bass_last_; ++i) {
+                energy += magnitudes_[i] * magnitudes_[i];
+            }
+            float average = 0;
+            for (float e : history_) {
+                average += e;
+            }
+            average = history_.empty() ? 0 : average / history_.size();
+            ++since_beat_;
+            // -40 dB keeps silence and hiss from counting
+            spectrum_.beat = history_.size() == history_size_ && energy > 1.5f * average && energy > 1e-4f
+                && since_beat_ >= refractory_;
+            if (spectrum_.beat) {
+                ++spectrum_.beats;
+                since_beat_ = 0;
+            }
+            history_.push_back(energy);
+            if (history_.size() > history_size_) {
+                history_.pop_front();
+            }
+        }
+
+        Fft fft_;
+        std::vector<float> window_;
+        std::vector<std::complex<float>> block_;
+        std::vector<float> buffer_;
+        std::vector<float> magnitudes_;
+        std::vector<std::pair<size_t, size_t>> ranges_;
+        size_t hop_;
+        int rate_;
+        size_t filled_ = 0;
+        float attack_ = 0.6f;
+        float release_ = 0.15f;
+        size_t bass_last_ = 1;
+        std::deque<float> history_;
+        size_t history_size_ = 1;
+        size_t refractory_ = 1;
+        size_t since_beat_ = 0;
+        Spectrum spectrum_;
+    };
+
+    /// @brief Lock free handoff of the latest value from one writer thread to one reader thread
+    ///
+    /// The writer fills back() and publishes it, the reader takes the newest published buffer; neither waits
+    /// and a slow reader simply skips values.
+    template <typename T>
+    class TripleBuffer {
+    public:
+        T& back() { return buffers_[back_]; }
+
+        void publish() {
+            back_ = state_.exchange(static_cast<uint8_t>(back_ | dirty), std::memory_order_acq_rel) & index;
+        }
+
+        /// @brief the newest published value, the previous one again when nothing new came
+        const T& read() {
+            if (state_.load(std::memory_order_relaxed) & dirty) {
+                front_ = state_.exchange(front_, std::memory_order_acq_rel) & index;
+            }
+            return buffers_[front_];
+        }
+    private:
+        static constexpr uint8_t dirty = 4;
+        static constexpr uint8_t index = 3;
+
+        std::array<T, 3> buffers_{};
+        // index of the middle buffer, dirty once the writer swapped a new one in
+        std::atomic<uint8_t> state_{1};
+        uint8_t back_ = 0;
+        uint8_t front_ = 2;
+    };
+
+    /// @brief Reads and analyses a PCM stream on its own thread, handing spectra to the render thread
+    class AudioInput {
+    public:
+        using Output = TripleBuffer<Spectrum>;
+
+        AudioInput() : output_(std::make_shared<Output>()) {}
+        ~AudioInput() { close(); }
+
+        /// @brief stop the current stream and start reading path, bands spread from 40 Hz to 16 kHz
+        void open(const std::string& path, PcmFormat raw = {}, size_t bands = 64) {
+            if (bands == 0 || bands > Spectrum::max_bands) {
+                throw std::invalid_argument(fmt::format("AudioInput {} bands", bands));
+            }
+            // rpc threads open and close concurrently, one stream and one writer of the output at a time
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop();
+            auto reader = std::make_shared<PcmReader>(path, raw);
+            stop_ = false;
+            thread_ = std::thread([this, reader, bands] {
+                try {
+                    if (reader->read_header(stop_)) {
+                        SpectrumAnalyzer analyzer(reader->format().sample_rate, bands);
+                        run(*reader, analyzer);
+                    }
+                }
+                catch (const std::exception& e) {
+                    spdlog::warn("AudioInput stopped: {}", e.what());
+                }
+            });
+        }
+
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop();
+        }
+
+        /// @brief the same buffer across streams, effects keep it for their lifetime
+        std::shared_ptr<Output> output() const { return output_; }
+    private:
+        void stop() {
+            stop_ = true;
+            if (thread_.joinable()) {
+                thread_.join();
+            }
+        }
+
+        void run(PcmReader& reader, SpectrumAnalyzer& analyzer) {
+            std::vector<float> samples(analyzer.hop());
+            const auto start = std::chrono::steady_clock::now();
+            uint64_t total = 0;
+            while (!stop_) {
+                const size_t n = reader.read(samples.data(), samples.size());
+                if (n == 0 && reader.eof()) {
+                    break;
+                }
+                analyzer.push(samples.data(), n, [&](const Spectrum& spectrum) {
+                    output_->back() = spectrum;
+                    output_->publish();
+                });
+                total += n;
+                if (reader.regular_file()) {
+                    // files play in real time, pipes and FIFOs are paced by their writer
+                    std::this_thread::sleep_until(start + std::chrono::microseconds(total * 1000000 / analyzer.sample_rate()));
+                }
+            }
+            // bars drop to silence once the stream ends
+            output_->back() = Spectrum{};
+            output_->back().count = analyzer.spectrum().count;
+            output_->publish();
+            spdlog::debug("AudioInput finished after {} samples", total);
+        }
+
+        std::shared_ptr<Output> output_;
+        std::mutex mutex_;
+        std::thread thread_;
+        std::atomic_bool stop_ = false;
+    };
+
+    /// @brief Spectrum bars, one band per column group, green at the bottom to red at the top, with falling peaks
+    ///
+    /// On a beat the background flashes with the flash parameter as brightness; peak_fall is rows per second.
+    class SpectrumEffect final : public Effect {
+    public:
+        SpectrumEffect(int w, int h, std::shared_ptr<AudioInput::Output> input)
+            : Effect(w, h), input_(std::move(input)), peaks_(static_cast<size_t>(w)), colors_(static_cast<size_t>(h)) {
+            std::vector<Hsv> hsv(colors_.size());
+            // bottom row green, the top one red
+            hue_gradient(hsv.data(), hsv.size(), 65536 / 3, -65536 / 3, 255, 255);
+            hsv_to_rgb(hsv.data(), colors_.data(), colors_.size());
+        }
+
+    protected:
+        void apply_param(const std::string& key, double value) override {
+            if (key == "flash") {
+                flash_ = static_cast<uint8_t>(std::clamp(value, 0.0, 255.0));
+            }
+            else if (key == "peak_fall") {
+                peak_fall_ = static_cast<float>(std::max(value, 0.0));
+            }
+            else {
+                Effect::apply_param(key, value);
+            }
+        }
+
+        void render(uint32_t t) override {
+            const auto& spectrum = input_->read();
+            const float dt = t >= last_ ? (t - last_) / 1000.0f : 0;
+            last_ = t;
+            if (spectrum.beats != beats_) {
+                beats_ = spectrum.beats;
+                glow_ = flash_;
+            }
+            const uint32_t g = glow_;
+            const LedColor back = g << 16 | g << 8 | g;
+            glow_ = static_cast<uint8_t>(glow_ * 7 / 8);
+            std::fill(frame_.begin(), frame_.end(), back);
+            if (spectrum.count == 0) {
+                return;
+            }
+            for (int x = 0; x < width_; ++x) {
+                const float value = spectrum.bands[static_cast<size_t>(x) * spectrum.count / width_];
+                const float bar = value * height_;
+                auto& peak = peaks_[x];
+                peak = std::max(bar, peak - peak_fall_ * dt);
+                for (int i = 0; i < static_cast<int>(bar + 0.5f) && i < height_; ++i) {
+                    row(height_ - 1 - i)[x] = colors_[i];
+                }
+                const int top = std::min(height_ - 1, static_cast<int>(peak));
+                if (peak >= 1) {
+                    row(height_ - 1 - top)[x] = Led::White;
+                }
+            }
+        }
+    private:
+        std::shared_ptr<AudioInput::Output> input_;
+        std::vector<float> peaks_;
+        std::vector<LedColor> colors_;
+        float peak_fall_ = 12;
+        uint8_t flash_ = 40;
+        uint8_t glow_ = 0;
+        uint32_t beats_ = 0;
+        uint32_t last_ = 0;
+    };
+}
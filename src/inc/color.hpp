@@ -0,0 +1,29 @@
+#pragma once
+
+#include <ws2811.h>
+#include <cstdint>
+
+namespace ohtoai::rpi {
+    using LedColor = ws2811_led_t;
+
+    enum Led: LedColor {
+        White = 0xffffff,
+        Red = 0xff0000,
+        Green = 0x00ff00,
+        Blue = 0x0000ff,
+        Yellow = 0xffff00,
+        Cyan = 0x00ffff,
+        Magenta = 0xff00ff,
+        Black = 0x000000,
+    };
+
+    /// @brief linear interpolation between two colors on all four channels, t = 0 gives a, t = 255 gives b
+    inline LedColor mix(LedColor a, LedColor b, uint8_t t) {
+        // two channels per 32-bit lane, the 8 bit gap between them absorbs the product
+        const uint32_t ta = 256 - t - (t == 255);
+        const uint32_t tb = t + (t == 255);
+        const uint32_t rb = ((a & 0x00ff00ff) * ta + (b & 0x00ff00ff) * tb) >> 8;
+        const uint32_t wg = ((a >> 8) & 0x00ff00ff) * ta + ((b >> 8) & 0x00ff00ff) * tb;
+        return (rb & 0x00ff00ff) | (wg & 0xff00ff00);
+    }
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "color.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace ohtoai::rpi {
+    /// @brief hue covers the full circle in 65536 steps, fine enough for gradients over thousands of leds
+    struct Hsv {
+        uint16_t h;
+        uint8_t s;
+        uint8_t v;
+
+        /// @brief wire form used by the rpc calls, 0xHHHHSSVV
+        static constexpr Hsv unpack(uint32_t packed) {
+            return {static_cast<uint16_t>(packed >> 16), static_cast<uint8_t>(packed >> 8), static_cast<uint8_t>(packed)};
+        }
+    };
+
+    struct Hsl {
+        uint16_t h;
+        uint8_t s;
+        uint8_t l;
+
+        /// @brief 0xHHHHSSLL
+        static constexpr Hsl unpack(uint32_t packed) {
+            return {static_cast<uint16_t>(packed >> 16), static_cast<uint8_t>(packed >> 8), static_cast<uint8_t>(packed)};
+        }
+    };
+
+    namespace detail {
+        /// @brief x / 255 rounded down, exact for x up to 65535
+        constexpr uint32_t div255(uint32_t x) {
+            return (x + 1 + (x >> 8)) >> 8;
+        }
+
+        /// @brief index into {v, p, q, t} of r, g and b for each hue sector
+        inline constexpr std::array<std::array<uint8_t, 3>, 6> hue_sectors = {{
+            {0, 3, 1}, {2, 0, 1}, {1, 0, 3}, {1, 2, 0}, {3, 1, 0}, {0, 1, 2},
+        }};
+    }
+
+    /// @brief integer only and branch free per pixel, the sector picks channels through a small table
+    inline void hsv_to_rgb(const Hsv* src, LedColor* dst, size_t n) {
+        using detail::div255;
+        for (size_t i = 0; i < n; ++i) {
+            const uint32_t h6 = static_cast<uint32_t>(src[i].h) * 6;
+            const uint32_t sector = h6 >> 16;
+            const uint32_t f = (h6 >> 8) & 0xff;
+            const uint32_t s = src[i].s;
+            const uint32_t v = src[i].v;
+            const uint32_t values[4] = {
+                v,
+                div255(v * (255 - s)),
+                div255(v * (255 - div255(s * f))),
+                div255(v * (255 - div255(s * (255 - f)))),
+            };
+            const auto& pick = detail::hue_sectors[sector];
+            dst[i] = values[pick[0]] << 16 | values[pick[1]] << 8 | values[pick[2]];
+        }
+    }
+
+    inline LedColor hsv_to_rgb(Hsv hsv) {
+        LedColor color;
+        hsv_to_rgb(&hsv, &color, 1);
+        return color;
+    }
+
+    /// @brief through the equivalent hsv value
+    inline void hsl_to_rgb(const Hsl* src, LedColor* dst, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            const uint32_t l = src[i].l;
+            const uint32_t chroma = detail::div255(src[i].s * std::min(l, 255 - l));
+            const uint32_t v = l + chroma;
+            const uint32_t s = v == 0 ? 0 : std::min<uint32_t>(255, 2 * chroma * 255 / v);
+            const Hsv hsv{src[i].h, static_cast<uint8_t>(s), static_cast<uint8_t>(v)};
+            hsv_to_rgb(&hsv, dst + i, 1);
+        }
+    }
+
+    inline void rgb_to_hsv(const LedColor* src, Hsv* dst, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            const int32_t r = (src[i] >> 16) & 0xff;
+            const int32_t g = (src[i] >> 8) & 0xff;
+            const int32_t b = src[i] & 0xff;
+            const int32_t max = std::max(r, std::max(g, b));
+            const int32_t delta = max - std::min(r, std::min(g, b));
+            int32_t h = 0;
+            if (delta != 0) {
+                // each sector is a sixth of the circle, offsets of 0, 1/3 and 2/3 for r, g and b
+                if (max == r) {
+                    h = (g - b) * 65536 / (6 * delta);
+                }
+                else if (max == g) {
+                    h = 65536 / 3 + (b - r) * 65536 / (6 * delta);
+                }
+                else {
+                    h = 2 * 65536 / 3 + (r - g) * 65536 / (6 * delta);
+                }
+            }
+            dst[i] = {
+                static_cast<uint16_t>(h & 0xffff),
+                static_cast<uint8_t>(max == 0 ? 0 : (delta * 255 + max / 2) / max),
+                static_cast<uint8_t>(max),
+            };
+        }
+    }
+
+    /// @brief black body color from 1000 K to 40000 K, interpolated from a table in 100 K steps
+    inline void kelvin_to_rgb(const uint16_t* src, LedColor* dst, size_t n) {
+        constexpr int lowest = 1000;
+        constexpr int step = 100;
+        constexpr int entries = (40000 - lowest) / step + 1;
+        // Tanner Helland's fit of the Planckian locus, evaluated once
+        static const auto table = [] {
+            std::array<LedColor, entries> colors{};
+            for (int i = 0; i < entries; ++i) {
+                const double t = (lowest + i * step) / 100.0;
+                const double r = t <= 66 ? 255 : 329.698727446 * std::pow(t - 60, -0.1332047592);
+                const double g = t <= 66 ? 99.4708025861 * std::log(t) - 161.1195681661
+                    : 288.1221695283 * std::pow(t - 60, -0.0755148492);
+                const double b = t >= 66 ? 255 : t <= 19 ? 0 : 138.5177312231 * std::log(t - 10) - 305.0447927307;
+                auto channel = [](double c) { return static_cast<LedColor>(std::clamp(std::lround(c), 0L, 255L)); };
+                colors[i] = channel(r) << 16 | channel(g) << 8 | channel(b);
+            }
+            return colors;
+        }();
+        for (size_t i = 0; i < n; ++i) {
+            const int k = std::clamp<int>(src[i], lowest, lowest + (entries - 1) * step) - lowest;
+            const int index = k / step;
+            const auto t = static_cast<uint8_t>((k % step) * 255 / step);
+            dst[i] = index + 1 < entries ? mix(table[index], table[index + 1], t) : table[index];
+        }
+    }
+
+    inline LedColor kelvin_to_rgb(uint16_t kelvin) {
+        LedColor color;
+        kelvin_to_rgb(&kelvin, &color, 1);
+        return color;
+    }
+
+    /// @brief n hues from start, advancing by span over the whole run, span may wrap the circle several times
+    inline void hue_gradient(Hsv* dst, size_t n, uint32_t start, int32_t span, uint8_t s, uint8_t v) {
+        // 16.16 hue so long runs do not accumulate rounding
+        const int64_t step = n > 1 ? (static_cast<int64_t>(span) << 16) / static_cast<int64_t>(n - 1) : 0;
+        int64_t h = static_cast<int64_t>(start) << 16;
+        for (size_t i = 0; i < n; ++i, h += step) {
+            dst[i] = {static_cast<uint16_t>(h >> 16), s, v};
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <yaml-cpp/yaml.h>
+#include <spdlog/spdlog.h>
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ohtoai::rpi {
+    /// @brief Physical region of the strip with its own color correction
+    struct PanelConfig {
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+        std::array<float, 9> matrix = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+        std::array<float, 3> offset = {0, 0, 0};
+    };
+
+    /// @brief Server settings, every key of the yaml file is optional
+    ///
+    /// width: 16
+    /// height: 32
+    /// gpio: 18
+    /// dma: 10
+    /// port: 9000
+    /// pixel_format: grb    # rgb, grb, brg, rgbw, grbw or wwa
+    /// brightness: 255
+    /// gamma: 1.0
+    /// power_budget_ma: 0   # supply current limit, 0 disables the limiter
+    /// led_milliamps: 20    # full scale current of one channel
+    /// led_idle_milliamps: 1
+    /// voltage: 5.0
+    /// panels:              # physical regions, before rotation, with a 3x3 color matrix and offsets
+    ///   - {x: 0, y: 0, width: 16, height: 16, matrix: [1, 0, 0, 0, 0.9, 0, 0, 0, 1], offset: [0, 0, 0]}
+    struct StripConfig {
+        int width = 16;
+        int height = 32;
+        int gpio = 18;
+        int dma = 10;
+        int port = 9000;
+        std::string pixel_format = "grb";
+        int brightness = 255;
+        float gamma = 1.0f;
+        int power_budget_ma = 0;
+        float led_milliamps = 20.0f;
+        float led_idle_milliamps = 1.0f;
+        float voltage = 5.0f;
+        std::vector<PanelConfig> panels;
+
+        static StripConfig load(const std::string& path) {
+            StripConfig config;
+            auto root = YAML::LoadFile(path);
+            read(root, "width", config.width);
+            read(root, "height", config.height);
+            read(root, "gpio", config.gpio);
+            read(root, "dma", config.dma);
+            read(root, "port", config.port);
+            read(root, "pixel_format", config.pixel_format);
+            read(root, "brightness", config.brightness);
+            read(root, "gamma", config.gamma);
+            read(root, "power_budget_ma", config.power_budget_ma);
+            read(root, "led_milliamps", config.led_milliamps);
+            read(root, "led_idle_milliamps", config.led_idle_milliamps);
+            read(root, "voltage", config.voltage);
+            for (const auto& node : root["panels"]) {
+                PanelConfig panel;
+                read(node, "x", panel.x);
+                read(node, "y", panel.y);
+                read(node, "width", panel.width);
+                read(node, "height", panel.height);
+                read_array(node, "matrix", panel.matrix);
+                read_array(node, "offset", panel.offset);
+                config.panels.push_back(panel);
+            }
+            spdlog::debug("StripConfig::load {} {}x{}, GPIO: {}, DMA: {}, format: {}",
+                path, config.width, config.height, config.gpio, config.dma, config.pixel_format);
+            return config;
+        }
+    private:
+        template <typename T>
+        static void read(const YAML::Node& node, const char* key, T& value) {
+            if (node[key]) {
+                value = node[key].as<T>();
+            }
+        }
+
+        template <typename T, size_t N>
+        static void read_array(const YAML::Node& node, const char* key, std::array<T, N>& value) {
+            if (!node[key]) {
+                return;
+            }
+            auto values = node[key].as<std::vector<T>>();
+            if (values.size() != N) {
+                throw std::invalid_argument(fmt::format("StripConfig {} needs {} values, got {}", key, N, values.size()));
+            }
+            std::copy(values.begin(), values.end(), value.begin());
+        }
+    };
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "arena.hpp"
+#include <cstdlib>
+#include <new>
+
+// Replaced global allocation functions feeding AllocationCounter. They are definitions, not inline:
+// include this header from exactly one translation unit of a program.
+//
+// gcc pairs deletes inlined at call sites with its builtin operator new and flags the free() calls,
+// the pairs here do match.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(std::size_t size) {
+    ohtoai::rpi::AllocationCounter::record();
+    if (auto p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return ::operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,492 @@
+#pragma once
+
+#include "render.hpp"
+#include "color_space.hpp"
+#include "filter.hpp"
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ohtoai::rpi {
+    /// @brief Paint source generated on the server, advance() renders the frame for a point in time
+    ///
+    /// The whole frame is computed at once into a row major buffer, so led() is a plain read and the
+    /// generators are free to work a row at a time.
+    class Effect : public IPaintSource {
+    public:
+        Effect(int w, int h) : width_(w), height_(h), frame_(static_cast<size_t>(w) * h), view_(frame_.data()) {}
+        virtual ~Effect() = default;
+
+        int width() const override { return width_; }
+        int height() const override { return height_; }
+        const LedColor& led(int x, int y) const override { return view_[static_cast<size_t>(y) * width_ + x]; }
+
+        /// @brief render the frame ms after the effect started, scaled by the speed parameter
+        void advance(uint32_t ms) {
+            // scaled time wraps like the clock itself, a fast effect running for weeks must not overflow the cast
+            render(static_cast<uint32_t>(std::fmod(ms * speed_, 4294967296.0)));
+            post_process();
+        }
+
+        /// @brief every effect understands speed, a time scale, and the blur and bloom post filters; unknown keys
+        /// and values that are not finite throw
+        void set_param(const std::string& key, double value) {
+            if (!std::isfinite(value)) {
+                throw std::invalid_argument(fmt::format("Effect::set_param {} {}", key, value));
+            }
+            apply_param(key, value);
+        }
+
+        static constexpr double max_speed = 100;
+
+        /// @brief the frame as shown, after the post filters
+        const LedColor* data() const { return view_; }
+    protected:
+        virtual void render(uint32_t t) = 0;
+
+        /// @brief set one parameter from a finite value, effects handle their own keys and pass the rest on here
+        virtual void apply_param(const std::string& key, double value) {
+            if (key == "speed") {
+                speed_ = std::clamp(value, 0.0, max_speed);
+            }
+            else if (key == "blur") {
+                blur_ = std::clamp(value, 0.0, static_cast<double>(Filter::max_radius));
+            }
+            else if (key == "bloom") {
+                bloom_ = static_cast<int>(std::clamp(value, 0.0, 16.0) * 256);
+            }
+            else if (key == "bloom_threshold") {
+                bloom_threshold_ = static_cast<uint8_t>(std::clamp(value, 0.0, 255.0));
+            }
+            else if (key == "bloom_radius") {
+                bloom_radius_ = static_cast<int>(std::clamp(value, 1.0, static_cast<double>(Filter::max_radius)));
+            }
+            else {
+                throw std::invalid_argument(fmt::format("Effect::set_param {}", key));
+            }
+        }
+
+        LedColor* row(int y) { return frame_.data() + static_cast<size_t>(y) * width_; }
+
+        int width_;
+        int height_;
+        std::vector<LedColor> frame_;
+        double speed_ = 1.0;
+    private:
+        /// @brief filters work on a copy, effects building on their previous frame must not feed back the glow
+        void post_process() {
+            const double blur = blur_;
+            const int bloom = bloom_;
+            if (!(blur > 0) && bloom <= 0) {
+                view_ = frame_.data();
+                return;
+            }
+            filtered_.assign(frame_.begin(), frame_.end());
+            filter_.gaussian_blur(filtered_.data(), width_, height_, blur);
+            filter_.bloom(filtered_.data(), width_, height_, bloom_threshold_, bloom_radius_, bloom);
+            view_ = filtered_.data();
+        }
+
+        Filter filter_;
+        std::vector<LedColor> filtered_;
+        const LedColor* view_;
+        double blur_ = 0;
+        // gain in 1/256
+        int bloom_ = 0;
+        uint8_t bloom_threshold_ = 160;
+        int bloom_radius_ = 2;
+    };
+
+    namespace detail {
+        /// @brief xorshift32, cheap and good enough for sparks
+        class Random {
+        public:
+            explicit Random(uint32_t seed = 0x9e3779b9) : state_(seed ? seed : 1) {}
+            uint32_t next() {
+                state_ ^= state_ << 13;
+                state_ ^= state_ >> 17;
+                state_ ^= state_ << 5;
+                return state_;
+            }
+            /// @brief [0, bound)
+            uint32_t below(uint32_t bound) { return static_cast<uint32_t>((static_cast<uint64_t>(next()) * bound) >> 32); }
+        private:
+            uint32_t state_;
+        };
+
+        /// @brief 128 + 127 * sin over 256 steps of a turn
+        inline const std::array<uint8_t, 256>& sine8() {
+            static const auto table = [] {
+                std::array<uint8_t, 256> values{};
+                for (int i = 0; i < 256; ++i) {
+                    values[i] = static_cast<uint8_t>(std::lround(128 + 127 * std::sin(i * 2 * 3.14159265358979 / 256)));
+                }
+                return values;
+            }();
+            return table;
+        }
+
+        inline std::array<LedColor, 256> rainbow_palette() {
+            std::array<Hsv, 256> hsv{};
+            hue_gradient(hsv.data(), hsv.size(), 0, 65536 - 256, 255, 255);
+            std::array<LedColor, 256> colors{};
+            hsv_to_rgb(hsv.data(), colors.data(), colors.size());
+            return colors;
+        }
+
+        /// @brief fixed step count for simulations that advance in frames rather than by time
+        class Stepper {
+        public:
+            explicit Stepper(uint32_t period_ms = 16) : period_(period_ms) {}
+            /// @brief steps due at t, at most a second worth after a stall
+            uint32_t steps(uint32_t t) {
+                if (!started_ || t < last_) {
+                    started_ = true;
+                    last_ = t;
+                    return 1;
+                }
+                const uint32_t due = (t - last_) / period_;
+                last_ += due * period_;
+                return std::min<uint32_t>(due, 1000 / period_);
+            }
+        private:
+            uint32_t period_;
+            uint32_t last_ = 0;
+            bool started_ = false;
+        };
+    }
+
+    /// @brief scrolling rainbow, spread is the hue step per led with 65536 as a full turn
+    class RainbowEffect final : public Effect {
+    public:
+        RainbowEffect(int w, int h) : Effect(w, h) {
+            // 1024 hues are finer than leds can show, a lookup beats converting every pixel
+            std::array<Hsv, 1024> hsv{};
+            hue_gradient(hsv.data(), hsv.size(), 0, 65536 - 64, 255, 255);
+            hsv_to_rgb(hsv.data(), palette_.data(), palette_.size());
+        }
+
+    protected:
+        void apply_param(const std::string& key, double value) override {
+            if (key == "spread") {
+                spread_ = static_cast<int32_t>(std::clamp(value, -65536.0, 65536.0));
+            }
+            else {
+                Effect::apply_param(key, value);
+            }
+        }
+
+        void render(uint32_t t) override {
+            // one turn every 4 seconds at speed 1
+            const uint32_t base = t * 16;
+            for (int y = 0; y < height_; ++y) {
+                // hues wrap, so the products are taken modulo 2^32
+                uint32_t hue = base + static_cast<uint32_t>(y) * static_cast<uint32_t>(spread_);
+                auto out = row(y);
+                for (int x = 0; x < width_; ++x, hue += spread_) {
+                    out[x] = palette_[(hue >> 6) & 0x3ff];
+                }
+            }
+        }
+    private:
+        int32_t spread_ = 1024;
+        std::array<LedColor, 1024> palette_{};
+    };
+
+    /// @brief sum of sine waves over x, y and the diagonal, mapped through a rainbow palette
+    class PlasmaEffect final : public Effect {
+    public:
+        PlasmaEffect(int w, int h) : Effect(w, h), palette_(detail::rainbow_palette()) {}
+    protected:
+        void render(uint32_t t) override {
+            const auto& sine = detail::sine8();
+            columns_.resize(width_);
+            const uint32_t t1 = t / 8, t2 = t / 11, t3 = t / 7;
+            for (int x = 0; x < width_; ++x) {
+                columns_[x] = sine[(x * 9 + t1) & 0xff];
+            }
+            for (int y = 0; y < height_; ++y) {
+                const uint32_t wave_y = sine[(y * 7 + t2) & 0xff];
+                auto out = row(y);
+                for (int x = 0; x < width_; ++x) {
+                    const uint32_t diagonal = sine[((x + y) * 5 + t3) & 0xff];
+                    out[x] = palette_[(columns_[x] + wave_y + 2 * diagonal) >> 2];
+                }
+            }
+        }
+    private:
+        std::array<LedColor, 256> palette_;
+        std::vector<uint32_t> columns_;
+    };
+
+    /// @brief Fire2012 style heat simulation per column, rising from the bottom row
+    class FireEffect final : public Effect {
+    public:
+        FireEffect(int w, int h) : Effect(w, h), heat_(static_cast<size_t>(w) * h) {
+            // black, red, yellow, white
+            for (int i = 0; i < 256; ++i) {
+                const uint32_t third = i * 3;
+                const uint32_t r = std::min<uint32_t>(third, 255);
+                const uint32_t g = third > 255 ? std::min<uint32_t>(third - 256, 255) : 0;
+                const uint32_t b = third > 511 ? third - 512 : 0;
+                palette_[i] = r << 16 | g << 8 | b;
+            }
+        }
+
+    protected:
+        void apply_param(const std::string& key, double value) override {
+            if (key == "cooling") {
+                cooling_ = static_cast<uint32_t>(std::clamp(value, 0.0, 255.0));
+            }
+            else if (key == "sparking") {
+                sparking_ = static_cast<uint32_t>(std::clamp(value, 0.0, 255.0));
+            }
+            else {
+                Effect::apply_param(key, value);
+            }
+        }
+
+        void render(uint32_t t) override {
+            for (auto steps = stepper_.steps(t); steps > 0; --steps) {
+                step();
+            }
+            for (size_t i = 0; i < frame_.size(); ++i) {
+                frame_[i] = palette_[heat_[i]];
+            }
+        }
+    private:
+        uint8_t& heat(int x, int y) { return heat_[static_cast<size_t>(y) * width_ + x]; }
+
+        void step() {
+            const uint32_t cool_max = cooling_ * 10 / std::max(height_, 1) + 2;
+            for (auto& h : heat_) {
+                h = static_cast<uint8_t>(std::max<int>(0, h - static_cast<int>(random_.below(cool_max))));
+            }
+            // heat drifts up and diffuses, row y takes from the two rows below it
+            for (int y = 0; y + 2 < height_; ++y) {
+                for (int x = 0; x < width_; ++x) {
+                    heat(x, y) = static_cast<uint8_t>((heat(x, y + 1) + 2 * heat(x, y + 2)) / 3);
+                }
+            }
+            for (int x = 0; x < width_; ++x) {
+                if (random_.below(256) < sparking_) {
+                    auto& h = heat(x, height_ - 1);
+                    h = static_cast<uint8_t>(std::min<uint32_t>(255, h + 160 + random_.below(96)));
+                }
+            }
+        }
+
+        std::vector<uint8_t> heat_;
+        std::array<LedColor, 256> palette_{};
+        detail::Random random_;
+        detail::Stepper stepper_;
+        uint32_t cooling_ = 55;
+        uint32_t sparking_ = 120;
+    };
+
+    /// @brief random leds flash up in a random hue and decay
+    class TwinkleEffect final : public Effect {
+    public:
+        TwinkleEffect(int w, int h)
+            : Effect(w, h), level_(static_cast<size_t>(w) * h), hue_(static_cast<size_t>(w) * h), hsv_(static_cast<size_t>(w) * h) {}
+
+    protected:
+        void apply_param(const std::string& key, double value) override {
+            if (key == "density") {
+                // new sparkles per 65536 leds and step
+                density_ = static_cast<uint32_t>(std::clamp(value, 0.0, 65536.0));
+            }
+            else if (key == "decay") {
+                decay_ = static_cast<uint32_t>(std::clamp(value, 0.0, 255.0));
+            }
+            else {
+                Effect::apply_param(key, value);
+            }
+        }
+
+        void render(uint32_t t) override {
+            for (auto steps = stepper_.steps(t); steps > 0; --steps) {
+                for (auto& level : level_) {
+                    level = static_cast<uint8_t>(level * (decay_ + 1) >> 8);
+                }
+                // expected count with the fraction carried, instead of a random draw per led
+                spawn_ += static_cast<uint64_t>(density_) * level_.size();
+                for (; spawn_ >= 65536; spawn_ -= 65536) {
+                    const auto i = random_.below(static_cast<uint32_t>(level_.size()));
+                    level_[i] = 255;
+                    hue_[i] = static_cast<uint16_t>(random_.next());
+                }
+            }
+            for (size_t i = 0; i < level_.size(); ++i) {
+                hsv_[i] = {hue_[i], 200, level_[i]};
+            }
+            hsv_to_rgb(hsv_.data(), frame_.data(), frame_.size());
+        }
+    private:
+        std::vector<uint8_t> level_;
+        std::vector<uint16_t> hue_;
+        std::vector<Hsv> hsv_;
+        detail::Random random_;
+        detail::Stepper stepper_;
+        uint32_t density_ = 300;
+        uint32_t decay_ = 235;
+        uint64_t spawn_ = 0;
+    };
+
+    /// @brief 3d gradient noise in 24.8 fixed point, Perlin's reference construction with a cubic fade
+    class GradientNoise {
+    public:
+        explicit GradientNoise(uint32_t seed = 1) {
+            for (int i = 0; i < 256; ++i) {
+                perm_[i] = static_cast<uint8_t>(i);
+            }
+            detail::Random random(seed);
+            for (int i = 255; i > 0; --i) {
+                std::swap(perm_[i], perm_[random.below(i + 1)]);
+            }
+            for (int i = 0; i < 256; ++i) {
+                perm_[256 + i] = perm_[i];
+            }
+        }
+
+        /// @brief coordinates with 8 fractional bits, result 0 to 255
+        uint8_t operator()(uint32_t x, uint32_t y, uint32_t z) const {
+            const int xi = (x >> 8) & 0xff, yi = (y >> 8) & 0xff, zi = (z >> 8) & 0xff;
+            const int xf = x & 0xff, yf = y & 0xff, zf = z & 0xff;
+            const int u = fade(xf), v = fade(yf), w = fade(zf);
+            const int a = perm_[xi] + yi, aa = perm_[a] + zi, ab = perm_[a + 1] + zi;
+            const int b = perm_[xi + 1] + yi, ba = perm_[b] + zi, bb = perm_[b + 1] + zi;
+            const int n = lerp(w,
+                lerp(v, lerp(u, grad(perm_[aa], xf, yf, zf), grad(perm_[ba], xf - 256, yf, zf)),
+                        lerp(u, grad(perm_[ab], xf, yf - 256, zf), grad(perm_[bb], xf - 256, yf - 256, zf))),
+                lerp(v, lerp(u, grad(perm_[aa + 1], xf, yf, zf - 256), grad(perm_[ba + 1], xf - 256, yf, zf - 256)),
+                        lerp(u, grad(perm_[ab + 1], xf, yf - 256, zf - 256), grad(perm_[bb + 1], xf - 256, yf - 256, zf - 256))));
+            // n stays within about +-256 in practice
+            return static_cast<uint8_t>(std::clamp((n >> 1) + 128, 0, 255));
+        }
+    private:
+        static int fade(int t) {
+            // 3t^2 - 2t^3 with t in 1/256
+            return t * t * (3 * 256 - 2 * t) >> 16;
+        }
+
+        static int lerp(int t, int a, int b) {
+            return a + ((b - a) * t >> 8);
+        }
+
+        static int grad(int hash, int x, int y, int z) {
+            const int h = hash & 15;
+            const int u = h < 8 ? x : y;
+            const int v = h < 4 ? y : h == 12 || h == 14 ? x : z;
+            return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+        }
+
+        std::array<uint8_t, 512> perm_{};
+    };
+
+    /// @brief slowly moving noise field mapped through a rainbow palette, scale is the field step per led in 1/256
+    class NoiseEffect final : public Effect {
+    public:
+        NoiseEffect(int w, int h) : Effect(w, h), palette_(detail::rainbow_palette()) {}
+
+    protected:
+        void apply_param(const std::string& key, double value) override {
+            if (key == "scale") {
+                scale_ = static_cast<uint32_t>(std::clamp(value, 1.0, 65536.0));
+            }
+            else {
+                Effect::apply_param(key, value);
+            }
+        }
+
+        void render(uint32_t t) override {
+            const uint32_t z = t / 4;
+            for (int y = 0; y < height_; ++y) {
+                auto out = row(y);
+                for (int x = 0; x < width_; ++x) {
+                    out[x] = palette_[noise_(x * scale_, y * scale_, z)];
+                }
+            }
+        }
+    private:
+        GradientNoise noise_;
+        std::array<LedColor, 256> palette_;
+        uint32_t scale_ = 40;
+    };
+
+    /// @brief Named running effects, all advanced together by a scheduler task
+    ///
+    /// Effects are only touched under the registry lock: the render task advances them under it, and readers and
+    /// parameter changes go through with(), so neither a destroy nor a set_param can cut into a frame.
+    class EffectRegistry {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        void add(const std::string& name, std::unique_ptr<Effect> effect) {
+            effect->advance(0);
+            // destroyed once the lock is released, effects with reader threads join them on destruction
+            std::unique_ptr<Effect> replaced;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto& entry = effects_[name];
+                replaced = std::exchange(entry.effect, std::move(effect));
+                entry.start = Clock::now();
+            }
+        }
+
+        bool destroy(const std::string& name) {
+            // like add, the effect itself goes after the lock is released
+            std::unique_ptr<Effect> destroyed;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = effects_.find(name);
+                if (it == effects_.end()) {
+                    return false;
+                }
+                destroyed = std::move(it->second.effect);
+                effects_.erase(it);
+            }
+            return true;
+        }
+
+        /// @brief fn(effect) under the registry lock, its result is returned
+        template <typename Fn>
+        decltype(auto) with(const std::string& name, Fn&& fn) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = effects_.find(name);
+            if (it == effects_.end()) {
+                throw std::out_of_range(fmt::format("EffectRegistry::with {}", name));
+            }
+            return fn(*it->second.effect);
+        }
+
+        bool contains(const std::string& name) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return effects_.count(name) != 0;
+        }
+
+        /// @brief render every effect for now, returns how many there are
+        size_t advance(Clock::time_point now) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& [name, entry] : effects_) {
+                auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - entry.start).count();
+                entry.effect->advance(static_cast<uint32_t>(std::max<int64_t>(ms, 0)));
+            }
+            return effects_.size();
+        }
+    private:
+        struct Entry {
+            std::unique_ptr<Effect> effect;
+            Clock::time_point start;
+        };
+
+        mutable std::mutex mutex_;
+        std::map<std::string, Entry> effects_;
+    };
+}
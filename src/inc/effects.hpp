@@ -0,0 +1,26 @@
+#pragma once
+
+#include "effect.hpp"
+#include "life.hpp"
+#include "particles.hpp"
+#include "program.hpp"
+#include <memory>
+#include <string>
+
+namespace ohtoai::rpi {
+    /// @brief rainbow, plasma, fire, twinkle, noise, life, fireworks or rain
+    inline std::unique_ptr<Effect> make_effect(const std::string& kind, int w, int h) {
+        if (w <= 0 || h <= 0) {
+            throw std::invalid_argument(fmt::format("make_effect {} {}x{}", kind, w, h));
+        }
+        if (kind == "rainbow") return std::make_unique<RainbowEffect>(w, h);
+        if (kind == "plasma") return std::make_unique<PlasmaEffect>(w, h);
+        if (kind == "fire") return std::make_unique<FireEffect>(w, h);
+        if (kind == "twinkle") return std::make_unique<TwinkleEffect>(w, h);
+        if (kind == "noise") return std::make_unique<NoiseEffect>(w, h);
+        if (kind == "life") return std::make_unique<LifeEffect>(w, h);
+        if (kind == "fireworks") return std::make_unique<ParticleEffect>(w, h, true);
+        if (kind == "rain") return std::make_unique<ParticleEffect>(w, h, false);
+        throw std::invalid_argument("make_effect " + kind);
+    }
+}
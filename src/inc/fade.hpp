@@ -0,0 +1,109 @@
+#pragma once
+
+#include "color.hpp"
+#include <algorithm>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace ohtoai::rpi {
+    /// @brief scale all four channels of every led by (factor + 1) / 256, 255 keeps the colors unchanged
+    inline void fade(LedColor* leds, size_t n, uint8_t factor) {
+        if (factor == 255) {
+            return;
+        }
+        const uint32_t k = factor + 1u;
+        for (size_t i = 0; i < n; ++i) {
+            const uint32_t c = leds[i];
+            // two channels per multiply, the products never reach the neighbouring field
+            const uint32_t rb = ((c & 0x00ff00ff) * k >> 8) & 0x00ff00ff;
+            const uint32_t wg = ((c >> 8) & 0x00ff00ff) * k & 0xff00ff00;
+            leds[i] = rb | wg;
+        }
+    }
+
+    /// @brief per led factors, same rules as the uniform fade
+    inline void fade(LedColor* leds, const uint8_t* factors, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            const uint32_t c = leds[i];
+            const uint32_t k = factors[i] + 1u;
+            const uint32_t rb = ((c & 0x00ff00ff) * k >> 8) & 0x00ff00ff;
+            const uint32_t wg = ((c >> 8) & 0x00ff00ff) * k & 0xff00ff00;
+            leds[i] = rb | wg;
+        }
+    }
+
+    /// @brief Decay factor per led of a buffer, stored in the buffer's own led order
+    ///
+    /// Regions are given in logical coordinates and mapped through the device index when set, so rotating
+    /// the device afterwards does not move existing regions.
+    class DecayMap {
+    public:
+        explicit DecayMap(size_t n, uint8_t factor = 255) : factors_(n, factor), uniform_(factor) {}
+
+        void fill(uint8_t factor) {
+            std::fill(factors_.begin(), factors_.end(), factor);
+            uniform_ = factor;
+        }
+
+        /// @brief Device provides index(x, y), width() and height()
+        template <typename Device>
+        void set_region(const Device& device, int x, int y, int w, int h, uint8_t factor) {
+            for (int dy = std::max(y, 0); dy < std::min(y + h, device.height()); ++dy) {
+                for (int dx = std::max(x, 0); dx < std::min(x + w, device.width()); ++dx) {
+                    const auto index = static_cast<size_t>(device.index(dx, dy));
+                    if (index < factors_.size()) {
+                        factors_[index] = factor;
+                    }
+                }
+            }
+            uniform_.reset();
+        }
+
+        void apply(LedColor* leds, size_t n) const {
+            n = std::min(n, factors_.size());
+            if (uniform_) {
+                fade(leds, n, *uniform_);
+            }
+            else {
+                fade(leds, factors_.data(), n);
+            }
+        }
+
+        size_t size() const { return factors_.size(); }
+    private:
+        std::vector<uint8_t> factors_;
+        // set while every led shares one factor, the uniform kernel needs no map reads
+        std::optional<uint8_t> uniform_;
+    };
+
+    /// @brief DecayMap shared between rpc handlers editing it and the scheduler task applying it
+    class Trail {
+    public:
+        explicit Trail(size_t n) : map_(n) {}
+
+        void fill(uint8_t factor) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            map_.fill(factor);
+        }
+
+        template <typename Device>
+        void set_region(const Device& device, int x, int y, int w, int h, uint8_t factor) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            map_.set_region(device, x, y, w, h, factor);
+        }
+
+        void apply(LedColor* leds, size_t n) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            map_.apply(leds, n);
+        }
+
+        size_t size() const { return map_.size(); }
+
+        /// @brief scheduler task applying the map, -1 while decay is stopped, guarded by the owner of the trail
+        int task = -1;
+    private:
+        mutable std::mutex mutex_;
+        DecayMap map_;
+    };
+}
@@ -0,0 +1,271 @@
+#pragma once
+
+#include "render.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <type_traits>
+#include <vector>
+
+namespace ohtoai::rpi {
+    namespace detail {
+        constexpr int filter_shifts[4] = {0, 8, 16, 24};
+
+        /// @brief 16 bit reciprocal of a box width, exact after rounding for widths up to 255
+        inline uint32_t box_reciprocal(int width) {
+            return ((1u << 16) + static_cast<uint32_t>(width) / 2) / static_cast<uint32_t>(width);
+        }
+    }
+
+    /// @brief One box pass along a row, src and dst do not overlap, edges repeat the border led
+    ///
+    /// Running sums per channel, so the cost does not depend on the radius.
+    inline void box_blur_row(const LedColor* src, LedColor* dst, int n, int radius) {
+        const uint32_t inverse = detail::box_reciprocal(2 * radius + 1);
+        uint32_t sum[4];
+        for (int c = 0; c < 4; ++c) {
+            const int shift = detail::filter_shifts[c];
+            sum[c] = (src[0] >> shift & 0xff) * static_cast<uint32_t>(radius + 1);
+            for (int k = 1; k <= radius; ++k) {
+                sum[c] += src[std::min(k, n - 1)] >> shift & 0xff;
+            }
+        }
+        for (int x = 0; x < n; ++x) {
+            const LedColor in = src[std::min(x + radius + 1, n - 1)];
+            const LedColor out = src[std::max(x - radius, 0)];
+            LedColor color = 0;
+            for (int c = 0; c < 4; ++c) {
+                const int shift = detail::filter_shifts[c];
+                color |= std::min<uint32_t>((sum[c] * inverse + 0x8000) >> 16, 255) << shift;
+                sum[c] += (in >> shift & 0xff) - (out >> shift & 0xff);
+            }
+            dst[x] = color;
+        }
+    }
+
+    /// @brief One box pass down the columns of a w x h frame, a row span at a time
+    ///
+    /// sums holds w * 4 column sums, channel major, and the inner loops run over whole rows so the
+    /// compiler can vectorise them.
+    inline void box_blur_columns(const LedColor* src, LedColor* dst, int w, int h, int radius, std::vector<uint32_t>& sums) {
+        const auto width = static_cast<size_t>(w);
+        const uint32_t inverse = detail::box_reciprocal(2 * radius + 1);
+        auto row = [&](int y) { return src + static_cast<size_t>(std::clamp(y, 0, h - 1)) * width; };
+        sums.assign(width * 4, 0);
+        for (int k = -radius; k <= radius; ++k) {
+            const LedColor* r = row(k);
+            for (int c = 0; c < 4; ++c) {
+                uint32_t* s = sums.data() + c * width;
+                const int shift = detail::filter_shifts[c];
+                for (size_t x = 0; x < width; ++x) {
+                    s[x] += r[x] >> shift & 0xff;
+                }
+            }
+        }
+        for (int y = 0; y < h; ++y) {
+            LedColor* out = dst + static_cast<size_t>(y) * width;
+            std::fill(out, out + width, 0);
+            const LedColor* in = row(y + radius + 1);
+            const LedColor* gone = row(y - radius);
+            for (int c = 0; c < 4; ++c) {
+                uint32_t* s = sums.data() + c * width;
+                const int shift = detail::filter_shifts[c];
+                for (size_t x = 0; x < width; ++x) {
+                    out[x] |= std::min<uint32_t>((s[x] * inverse + 0x8000) >> 16, 255) << shift;
+                    s[x] += (in[x] >> shift & 0xff) - (gone[x] >> shift & 0xff);
+                }
+            }
+        }
+    }
+
+    /// @brief In place filters over row major led frames: separable blurs, bloom and 3x3 convolution
+    ///
+    /// Keeps its scratch buffers between calls, so a filter applied every frame does not allocate.
+    /// Devices whose buffer is not row major, like the snake wired strip or a rotated pixmap, are copied
+    /// through logical coordinates first.
+    class Filter {
+    public:
+        static constexpr int max_radius = 127;
+        static constexpr int max_tap = 1024;
+
+        /// @brief passes box blurs of radius, three approach a Gaussian
+        void box_blur(LedColor* leds, int w, int h, int radius, int passes = 1) {
+            radius = std::clamp(radius, 0, max_radius);
+            if (radius == 0 || w <= 0 || h <= 0) {
+                return;
+            }
+            for (int i = 0; i < passes; ++i) {
+                blur_pass(leds, w, h, radius);
+            }
+        }
+
+        /// @brief Gaussian blur of standard deviation sigma, approximated by three box passes, sigma is capped at max_radius
+        void gaussian_blur(LedColor* leds, int w, int h, double sigma) {
+            if (!(sigma > 0) || w <= 0 || h <= 0) {
+                return;
+            }
+            for (int radius : gaussian_boxes(sigma)) {
+                if (radius > 0) {
+                    blur_pass(leds, w, h, std::min(radius, max_radius));
+                }
+            }
+        }
+
+        /// @brief add a blurred copy of the channels above threshold, scaled by gain / 256
+        void bloom(LedColor* leds, int w, int h, uint8_t threshold, int radius, int gain) {
+            if (w <= 0 || h <= 0 || gain <= 0) {
+                return;
+            }
+            const size_t n = static_cast<size_t>(w) * h;
+            bright_.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                LedColor color = 0;
+                for (int shift : detail::filter_shifts) {
+                    const uint32_t v = leds[i] >> shift & 0xff;
+                    color |= (v > threshold ? v - threshold : 0) << shift;
+                }
+                bright_[i] = color;
+            }
+            box_blur(bright_.data(), w, h, radius, 3);
+            const auto k = static_cast<uint32_t>(gain);
+            for (size_t i = 0; i < n; ++i) {
+                LedColor color = 0;
+                for (int shift : detail::filter_shifts) {
+                    const uint32_t v = (leds[i] >> shift & 0xff) + ((bright_[i] >> shift & 0xff) * k >> 8);
+                    color |= std::min<uint32_t>(v, 255) << shift;
+                }
+                leds[i] = color;
+            }
+        }
+
+        /// @brief 3x3 kernel in row order, the result divided by divisor then offset by bias
+        ///
+        /// A zero divisor uses the sum of the kernel, or 1 when that is zero too. Edges repeat the border leds.
+        /// Taps and bias are clamped to +-max_tap, so the sums of nine 8 bit taps stay far inside an int.
+        void convolve(LedColor* leds, int w, int h, std::array<int, 9> kernel, int divisor = 0, int bias = 0) {
+            if (w <= 0 || h <= 0) {
+                return;
+            }
+            for (int& k : kernel) {
+                k = std::clamp(k, -max_tap, max_tap);
+            }
+            bias = std::clamp(bias, -max_tap, max_tap);
+            if (divisor == 0) {
+                for (int k : kernel) {
+                    divisor += k;
+                }
+                divisor = divisor == 0 ? 1 : divisor;
+            }
+            // three padded rows of the original frame, unpacked to channel planes so the taps run over spans
+            // and output rows can overwrite the frame
+            const size_t stride = static_cast<size_t>(w) + 2;
+            planes_.resize(stride * 4 * 3);
+            sum_.resize(static_cast<size_t>(w));
+            auto load = [&](int16_t* dst, int y) {
+                const LedColor* src = leds + static_cast<size_t>(std::clamp(y, 0, h - 1)) * w;
+                for (int c = 0; c < 4; ++c) {
+                    int16_t* plane = dst + c * stride;
+                    const int shift = detail::filter_shifts[c];
+                    for (int x = 0; x < w; ++x) {
+                        plane[x + 1] = static_cast<int16_t>(src[x] >> shift & 0xff);
+                    }
+                    plane[0] = plane[1];
+                    plane[w + 1] = plane[w];
+                }
+            };
+            int16_t* above = planes_.data();
+            int16_t* middle = above + stride * 4;
+            int16_t* below = middle + stride * 4;
+            load(above, -1);
+            load(middle, 0);
+            for (int y = 0; y < h; ++y) {
+                load(below, y + 1);
+                LedColor* out = leds + static_cast<size_t>(y) * w;
+                std::fill(out, out + w, 0);
+                const int16_t* taps[3] = {above, middle, below};
+                for (int c = 0; c < 4; ++c) {
+                    std::fill(sum_.begin(), sum_.end(), 0);
+                    for (int r = 0; r < 3; ++r) {
+                        const int16_t* plane = taps[r] + c * stride;
+                        for (int k = 0; k < 3; ++k) {
+                            const int weight = kernel[r * 3 + k];
+                            if (weight == 0) {
+                                continue;
+                            }
+                            for (int x = 0; x < w; ++x) {
+                                sum_[x] += weight * plane[x + k];
+                            }
+                        }
+                    }
+                    const int shift = detail::filter_shifts[c];
+                    for (int x = 0; x < w; ++x) {
+                        out[x] |= static_cast<uint32_t>(std::clamp(sum_[x] / divisor + bias, 0, 255)) << shift;
+                    }
+                }
+                std::swap(above, middle);
+                std::swap(middle, below);
+            }
+        }
+
+        /// @brief run fn(leds, w, h) over the logical row major frame of a device
+        template <typename Device, typename Fn>
+        void apply(Device& device, Fn&& fn) {
+            const int w = device.width(), h = device.height();
+            if constexpr (std::is_same_v<Device, Pixmap>) {
+                if (!device.rotated()) {
+                    fn(device.data(), w, h);
+                    return;
+                }
+            }
+            frame_.resize(static_cast<size_t>(w) * h);
+            LedColor* leds = device.data();
+            for (int y = 0; y < h; ++y) {
+                for (int x = 0; x < w; ++x) {
+                    frame_[static_cast<size_t>(y) * w + x] = leds[device.index(x, y)];
+                }
+            }
+            fn(frame_.data(), w, h);
+            for (int y = 0; y < h; ++y) {
+                for (int x = 0; x < w; ++x) {
+                    leds[device.index(x, y)] = frame_[static_cast<size_t>(y) * w + x];
+                }
+            }
+        }
+
+        /// @brief radii of three box passes whose combined variance matches sigma, capped at max_radius
+        static std::array<int, 3> gaussian_boxes(double sigma) {
+            if (!(sigma > 0)) {
+                return {};
+            }
+            // also keeps the box widths below converted to int finite and in range
+            sigma = std::min(sigma, static_cast<double>(max_radius));
+            // widths wl and wl + 2 mixed so the summed variance, (w * w - 1) / 12 per pass, hits sigma squared
+            const double ideal = std::sqrt(12 * sigma * sigma / 3 + 1);
+            int wl = static_cast<int>(std::floor(ideal));
+            wl -= wl % 2 == 0 ? 1 : 0;
+            const int wu = wl + 2;
+            const double m = (12 * sigma * sigma - 3.0 * wl * wl - 12.0 * wl - 9) / (-4.0 * wl - 4);
+            const int lower = static_cast<int>(std::lround(m));
+            std::array<int, 3> radii{};
+            for (int i = 0; i < 3; ++i) {
+                radii[i] = ((i < lower ? wl : wu) - 1) / 2;
+            }
+            return radii;
+        }
+    private:
+        void blur_pass(LedColor* leds, int w, int h, int radius) {
+            scratch_.resize(static_cast<size_t>(w) * h);
+            for (int y = 0; y < h; ++y) {
+                box_blur_row(leds + static_cast<size_t>(y) * w, scratch_.data() + static_cast<size_t>(y) * w, w, radius);
+            }
+            box_blur_columns(scratch_.data(), leds, w, h, radius, sums_);
+        }
+
+        std::vector<LedColor> scratch_;
+        std::vector<LedColor> bright_;
+        std::vector<int16_t> planes_;
+        std::vector<int32_t> sum_;
+        std::vector<LedColor> frame_;
+        std::vector<uint32_t> sums_;
+    };
+}
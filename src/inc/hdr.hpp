@@ -0,0 +1,99 @@
+#pragma once
+
+#include "render.hpp"
+#include "output.hpp"
+#include <algorithm>
+
+namespace ohtoai::rpi {
+    /// @brief Surface with 16 bits per channel for effects and compositing, tone mapped when presented
+    ///
+    /// 8 bit colors are promoted so that 255 becomes ToneMapper::unity, sums above it are kept
+    /// and fades lose no precision between frames.
+    class HdrPixmap {
+    public:
+        static constexpr uint32_t unity = ToneMapper::unity;
+
+        HdrPixmap(int w, int h)
+            : width_(w), height_(h), data_(4 * static_cast<size_t>(w) * h) {}
+
+        int width() const { return width_; }
+        int height() const { return height_; }
+
+        /// @brief four channels in b, g, r, w order
+        uint16_t* pixel(int x, int y) { return &data_[4 * (static_cast<size_t>(y) * width_ + x)]; }
+        const uint16_t* pixel(int x, int y) const { return &data_[4 * (static_cast<size_t>(y) * width_ + x)]; }
+
+        void clear() {
+            std::fill(data_.begin(), data_.end(), 0);
+        }
+
+        void set(int x, int y, LedColor color) {
+            auto p = pixel(x, y);
+            for (int k = 0; k < 4; ++k) {
+                p[k] = promote(color >> (8 * k));
+            }
+        }
+
+        /// @brief saturating add of color scaled by gain / 256
+        void add(int x, int y, LedColor color, uint32_t gain = 256) {
+            auto p = pixel(x, y);
+            for (int k = 0; k < 4; ++k) {
+                // 64 bit product, a full scale channel times a large gain does not fit in 32 bits
+                p[k] = saturate(p[k] + (uint64_t{promote(color >> (8 * k))} * gain >> 8));
+            }
+        }
+
+        void draw(const IPaintSource& src, int x, int y) {
+            for_each_overlap(src, x, y, [&](int dx, int dy, LedColor color) { set(dx, dy, color); });
+        }
+
+        void add(const IPaintSource& src, int x, int y, uint32_t gain = 256) {
+            for_each_overlap(src, x, y, [&](int dx, int dy, LedColor color) { add(dx, dy, color, gain); });
+        }
+
+        /// @brief multiply every channel by factor / 65536
+        void scale(uint32_t factor) {
+            for (auto& v : data_) {
+                v = static_cast<uint16_t>(v * factor >> 16);
+            }
+        }
+
+        /// @brief reorder into the strip's led order and render through its output stage
+        auto present(WS2811Strip& strip) {
+            if (strip.width() != width_ || strip.height() != height_) {
+                throw std::invalid_argument(fmt::format("HdrPixmap::present {}x{} onto {}x{}", width_, height_, strip.width(), strip.height()));
+            }
+            strip_order_.resize(data_.size());
+            for (int y = 0; y < height_; ++y) {
+                for (int x = 0; x < width_; ++x) {
+                    std::copy_n(pixel(x, y), 4, &strip_order_[4 * static_cast<size_t>(strip.index(x, y))]);
+                }
+            }
+            return strip.render(strip_order_.data());
+        }
+
+        const std::vector<uint16_t>& data() const { return data_; }
+    private:
+        static uint32_t promote(uint32_t v8) {
+            return ((v8 & 0xff) * unity + 127) / 255;
+        }
+
+        static uint16_t saturate(uint64_t v) {
+            return static_cast<uint16_t>(std::min<uint64_t>(v, 0xffff));
+        }
+
+        template <typename Fn>
+        void for_each_overlap(const IPaintSource& src, int x, int y, Fn&& fn) {
+            for (int sy = std::max(0, -y); sy < src.height() && y + sy < height_; ++sy) {
+                for (int sx = std::max(0, -x); sx < src.width() && x + sx < width_; ++sx) {
+                    fn(x + sx, y + sy, src.led(sx, sy));
+                }
+            }
+        }
+
+        int width_;
+        int height_;
+        std::vector<uint16_t> data_;
+        std::vector<uint16_t> strip_order_;
+    };
+}
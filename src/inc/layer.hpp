@@ -0,0 +1,76 @@
+#pragma once
+
+#include "render.hpp"
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace ohtoai::rpi {
+    /// @brief A surface composed onto a target every frame, the properties animations usually drive
+    struct Layer {
+        std::string dst;
+        std::string src;
+        float x = 0;
+        float y = 0;
+        /// @brief source offset, wrapping around, for marquee text
+        float scroll_x = 0;
+        float scroll_y = 0;
+        /// @brief 255 is opaque, below that the source is mixed with the target content underneath
+        int opacity = 255;
+        bool visible = true;
+    };
+
+    /// @brief Copy of a device's leds that layers are composed into, rebuilt from the device every frame
+    ///
+    /// Composing into the device itself would mix translucent layers with their own output of the last frame
+    /// and leave moved layers behind. Keeps the size, rotation and led order of the device it was loaded from.
+    template <typename Device>
+    class LayerFrame final : public IPaintDevice {
+    public:
+        /// @brief copy the leds of device, which must outlive every other call until the next load
+        void load(const Device& device) {
+            device_ = &device;
+            leds_.assign(device.data(), device.data() + device.size());
+            set_background(device.background());
+            set_transparent(device.transparent());
+        }
+
+        int width() const override { return device_->width(); }
+        int height() const override { return device_->height(); }
+        LedColor& led_ref(int x, int y) override { return leds_[device_->index(x, y)]; }
+        const LedColor& led(int x, int y) const override { return leds_[device_->index(x, y)]; }
+
+        /// @brief leds in the order of the device
+        const LedColor* data() const { return leds_.data(); }
+        size_t size() const { return leds_.size(); }
+    private:
+        const Device* device_ = nullptr;
+        std::vector<LedColor> leds_;
+    };
+
+    /// @brief draw src at the layer position with its scroll offset, covering exactly src.width() x src.height() leds
+    inline void compose(IPaintDevice& dst, const IPaintSource& src, const Layer& layer) {
+        const int w = src.width();
+        const int h = src.height();
+        if (!layer.visible || w <= 0 || h <= 0) {
+            return;
+        }
+        const int x = static_cast<int>(std::lround(layer.x));
+        const int y = static_cast<int>(std::lround(layer.y));
+        const int scroll_x = ((static_cast<int>(std::lround(layer.scroll_x)) % w) + w) % w;
+        const int scroll_y = ((static_cast<int>(std::lround(layer.scroll_y)) % h) + h) % h;
+        const auto opacity = static_cast<uint8_t>(std::clamp(layer.opacity, 0, 255));
+        const LedColor back = dst.background();
+        for (int sy = std::max(0, -y); sy < h && y + sy < dst.height(); ++sy) {
+            const int src_y = (sy + scroll_y) % h;
+            for (int sx = std::max(0, -x); sx < w && x + sx < dst.width(); ++sx) {
+                auto color = src.led((sx + scroll_x) % w, src_y);
+                if (dst.transparent() && color == back) {
+                    continue;
+                }
+                auto& dst_led = dst.led_ref(x + sx, y + sy);
+                dst_led = opacity == 255 ? color : mix(dst_led, color, opacity);
+            }
+        }
+    }
+}
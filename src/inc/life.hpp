@@ -0,0 +1,232 @@
+#pragma once
+
+#include "effect.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ohtoai::rpi {
+    /// @brief Life-like cellular automaton on bitboards, 64 cells per word, stepped with bit sliced adders
+    class CellGrid {
+    public:
+        CellGrid(int w, int h)
+            : width_(w), height_(h), words_((w + 63) / 64),
+            cells_(words_ * h), next_(words_ * h), west_(words_ * h), east_(words_ * h), zero_(words_) {
+            if (w <= 0 || h <= 0) {
+                throw std::invalid_argument(fmt::format("CellGrid {}x{}", w, h));
+            }
+        }
+
+        int width() const { return width_; }
+        int height() const { return height_; }
+
+        bool get(int x, int y) const {
+            return cells_[index(x, y)] >> (x & 63) & 1;
+        }
+
+        void set(int x, int y, bool alive) {
+            auto& word = cells_[index(x, y)];
+            const uint64_t bit = uint64_t{1} << (x & 63);
+            word = alive ? word | bit : word & ~bit;
+        }
+
+        void clear() {
+            std::fill(cells_.begin(), cells_.end(), 0);
+        }
+
+        /// @brief each cell alive with probability density / 256
+        void randomize(uint32_t density, uint32_t seed = 0x2545f491) {
+            detail::Random random(seed);
+            for (int y = 0; y < height_; ++y) {
+                for (int x = 0; x < width_; ++x) {
+                    set(x, y, random.below(256) < density);
+                }
+            }
+        }
+
+        /// @brief B/S notation such as "B3/S23" for Conway's life or "B36/S23" for HighLife
+        void set_rule(const std::string& rule) {
+            uint16_t birth = 0, survive = 0;
+            uint16_t* current = nullptr;
+            for (char c : rule) {
+                if (c == 'B' || c == 'b') {
+                    current = &birth;
+                }
+                else if (c == 'S' || c == 's') {
+                    current = &survive;
+                }
+                else if (c >= '0' && c <= '8' && current) {
+                    *current |= static_cast<uint16_t>(1 << (c - '0'));
+                }
+                else if (c != '/') {
+                    throw std::invalid_argument("CellGrid::set_rule " + rule);
+                }
+            }
+            birth_ = birth;
+            survive_ = survive;
+        }
+
+        /// @brief cells past the edges wrap around, otherwise they are dead
+        void set_wrap(bool wrap) { wrap_ = wrap; }
+
+        void step() {
+            for (int y = 0; y < height_; ++y) {
+                shift_row(row(cells_, y), row(west_, y), row(east_, y));
+            }
+            for (int y = 0; y < height_; ++y) {
+                const int up = y > 0 ? y - 1 : wrap_ ? height_ - 1 : -1;
+                const int down = y + 1 < height_ ? y + 1 : wrap_ ? 0 : -1;
+                auto pick = [&](const std::vector<uint64_t>& plane, int r) {
+                    return r < 0 ? zero_.data() : row(plane, r);
+                };
+                const uint64_t* n = pick(cells_, up);
+                const uint64_t* nw = pick(west_, up);
+                const uint64_t* ne = pick(east_, up);
+                const uint64_t* w = row(west_, y);
+                const uint64_t* e = row(east_, y);
+                const uint64_t* s = pick(cells_, down);
+                const uint64_t* sw = pick(west_, down);
+                const uint64_t* se = pick(east_, down);
+                const uint64_t* alive = row(cells_, y);
+                uint64_t* out = row(next_, y);
+                for (size_t i = 0; i < words_; ++i) {
+                    // neighbour count as four bit planes
+                    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+                    for (uint64_t m : {n[i], nw[i], ne[i], w[i], e[i], s[i], sw[i], se[i]}) {
+                        const uint64_t c0 = s0 & m;
+                        s0 ^= m;
+                        const uint64_t c1 = s1 & c0;
+                        s1 ^= c0;
+                        const uint64_t c2 = s2 & c1;
+                        s2 ^= c1;
+                        s3 |= c2;
+                    }
+                    uint64_t born = 0, kept = 0;
+                    for (int count = 0; count <= 8; ++count) {
+                        const uint64_t is = (count & 1 ? s0 : ~s0) & (count & 2 ? s1 : ~s1)
+                            & (count & 4 ? s2 : ~s2) & (count & 8 ? s3 : ~s3);
+                        born |= birth_ >> count & 1 ? is : 0;
+                        kept |= survive_ >> count & 1 ? is : 0;
+                    }
+                    out[i] = (~alive[i] & born) | (alive[i] & kept);
+                }
+                out[words_ - 1] &= last_mask();
+            }
+            cells_.swap(next_);
+        }
+
+        size_t population() const {
+            size_t count = 0;
+            for (auto word : cells_) {
+                count += static_cast<size_t>(__builtin_popcountll(word));
+            }
+            return count;
+        }
+    private:
+        size_t index(int x, int y) const { return static_cast<size_t>(y) * words_ + (x >> 6); }
+        const uint64_t* row(const std::vector<uint64_t>& plane, int y) const { return plane.data() + static_cast<size_t>(y) * words_; }
+        uint64_t* row(std::vector<uint64_t>& plane, int y) { return plane.data() + static_cast<size_t>(y) * words_; }
+
+        uint64_t last_mask() const {
+            const int used = width_ - static_cast<int>(words_ - 1) * 64;
+            return used == 64 ? ~uint64_t{0} : (uint64_t{1} << used) - 1;
+        }
+
+        /// @brief west bit x holds cell x - 1, east bit x holds cell x + 1
+        void shift_row(const uint64_t* src, uint64_t* west, uint64_t* east) const {
+            const uint64_t first = src[0] & 1;
+            const uint64_t last = src[words_ - 1] >> ((width_ - 1) & 63) & 1;
+            for (size_t i = 0; i < words_; ++i) {
+                const uint64_t carry_in = i > 0 ? src[i - 1] >> 63 : wrap_ ? last : 0;
+                west[i] = src[i] << 1 | carry_in;
+                const uint64_t carry_next = i + 1 < words_ ? src[i + 1] << 63 : 0;
+                east[i] = src[i] >> 1 | carry_next;
+            }
+            west[words_ - 1] &= last_mask();
+            if (wrap_ && first) {
+                east[words_ - 1] |= uint64_t{1} << ((width_ - 1) & 63);
+            }
+        }
+
+        int width_;
+        int height_;
+        size_t words_;
+        std::vector<uint64_t> cells_;
+        std::vector<uint64_t> next_;
+        std::vector<uint64_t> west_;
+        std::vector<uint64_t> east_;
+        // neighbour row beyond the edges without wrapping
+        std::vector<uint64_t> zero_;
+        uint16_t birth_ = 1 << 3;
+        uint16_t survive_ = 1 << 2 | 1 << 3;
+        bool wrap_ = true;
+    };
+
+    /// @brief CellGrid as an effect, cells colored by how many frames they have been alive
+    ///
+    /// rate is generations per second and may exceed the frame rate, several generations then run per frame.
+    class LifeEffect final : public Effect {
+    public:
+        LifeEffect(int w, int h) : Effect(w, h), grid_(w, h), age_(static_cast<size_t>(w) * h) {
+            std::array<Hsv, 256> hsv{};
+            // young cells warm white, old ones settle into blue
+            hue_gradient(hsv.data(), hsv.size(), 65536 / 8, 65536 / 2, 255, 255);
+            hsv[0].s = 60;
+            hsv_to_rgb(hsv.data(), palette_.data(), palette_.size());
+            grid_.randomize(80);
+        }
+
+        CellGrid& grid() { return grid_; }
+    protected:
+        void apply_param(const std::string& key, double value) override {
+            if (key == "rate") {
+                period_ = static_cast<uint32_t>(1000 / std::clamp(value, 1.0, 1000.0));
+            }
+            else if (key == "density") {
+                grid_.randomize(static_cast<uint32_t>(std::clamp(value, 0.0, 256.0)), seed_ += 0x9e3779b9);
+                std::fill(age_.begin(), age_.end(), 0);
+            }
+            else if (key == "wrap") {
+                grid_.set_wrap(value != 0);
+            }
+            else {
+                Effect::apply_param(key, value);
+            }
+        }
+
+        void render(uint32_t t) override {
+            if (!started_ || t < last_) {
+                started_ = true;
+                last_ = t;
+            }
+            const uint32_t due = (t - last_) / period_;
+            last_ += due * period_;
+            // at most a second worth of generations after a stall
+            for (uint32_t steps = std::min(due, 1000 / period_ + 1); steps > 0; --steps) {
+                grid_.step();
+            }
+            for (int y = 0; y < height_; ++y) {
+                auto out = row(y);
+                auto age = age_.data() + static_cast<size_t>(y) * width_;
+                for (int x = 0; x < width_; ++x) {
+                    if (grid_.get(x, y)) {
+                        age[x] = static_cast<uint8_t>(std::min(age[x] + 1, 255));
+                        out[x] = palette_[age[x] - 1];
+                    }
+                    else {
+                        age[x] = 0;
+                        out[x] = Led::Black;
+                    }
+                }
+            }
+        }
+    private:
+        CellGrid grid_;
+        std::vector<uint8_t> age_;
+        std::array<LedColor, 256> palette_{};
+        uint32_t period_ = 100;
+        uint32_t last_ = 0;
+        uint32_t seed_ = 1;
+        bool started_ = false;
+    };
+}
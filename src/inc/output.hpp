@@ -0,0 +1,532 @@
+#pragma once
+
+#include "color.hpp"
+#include "pixel_format.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace ohtoai::rpi {
+    /// @brief Per-channel 256-entry tables folding gamma, white balance and brightness into one lookup
+    class ColorLut {
+    public:
+        ColorLut() { rebuild(); }
+
+        void set_gamma(float gamma) {
+            if (!(gamma > 0)) {
+                throw std::invalid_argument("ColorLut::set_gamma");
+            }
+            gamma_ = gamma;
+            rebuild();
+        }
+
+        void set_white_balance(uint8_t r, uint8_t g, uint8_t b) {
+            balance_ = {r, g, b};
+            rebuild();
+        }
+
+        void set_brightness(uint8_t brightness) {
+            brightness_ = brightness;
+            rebuild();
+        }
+
+        float gamma() const { return gamma_; }
+        uint8_t brightness() const { return brightness_; }
+        bool identity() const { return identity_; }
+
+        /// @brief src and dst may alias
+        void apply(const LedColor* src, LedColor* dst, size_t n) const {
+            if (identity_) {
+                if (src != dst) {
+                    std::memcpy(dst, src, n * sizeof(LedColor));
+                }
+                return;
+            }
+            if (linear_) {
+                // without gamma every table is a plain scale, arithmetic instead of lookups lets the loop vectorize
+                const uint32_t kw = scale_[0], kr = scale_[1], kg = scale_[2], kb = scale_[3];
+                for (size_t i = 0; i < n; ++i) {
+                    const uint32_t c = src[i];
+                    dst[i] = (((c >> 24) * kw >> 8) << 24)
+                        | ((((c >> 16) & 0xff) * kr >> 8) << 16)
+                        | ((((c >> 8) & 0xff) * kg >> 8) << 8)
+                        | ((c & 0xff) * kb >> 8);
+                }
+                return;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                const uint32_t c = src[i];
+                dst[i] = (static_cast<uint32_t>(table_[0][c >> 24]) << 24)
+                    | (static_cast<uint32_t>(table_[1][(c >> 16) & 0xff]) << 16)
+                    | (static_cast<uint32_t>(table_[2][(c >> 8) & 0xff]) << 8)
+                    | table_[3][c & 0xff];
+            }
+        }
+
+        /// @brief 8.8 fixed point output for the temporal dither, four values per led in b, g, r, w order
+        void expand(const LedColor* src, uint16_t* dst, size_t n) const {
+            for (size_t i = 0; i < n; ++i) {
+                const uint32_t c = src[i];
+                dst[4 * i + 0] = wide_[3][c & 0xff];
+                dst[4 * i + 1] = wide_[2][(c >> 8) & 0xff];
+                dst[4 * i + 2] = wide_[1][(c >> 16) & 0xff];
+                dst[4 * i + 3] = wide_[0][c >> 24];
+            }
+        }
+
+        /// @brief apply the tables to 8.8 values in b, g, r, w order, interpolating between entries, src and dst may alias
+        void map_wide(const uint16_t* src, uint16_t* dst, size_t n) const {
+            if (identity_) {
+                if (src != dst) {
+                    std::memcpy(dst, src, 4 * n * sizeof(uint16_t));
+                }
+                return;
+            }
+            for (size_t i = 0; i < 4 * n; ++i) {
+                const auto& table = wide_[3 - i % 4];
+                const uint32_t v = src[i];
+                const uint32_t index = v >> 8;
+                const uint32_t frac = v & 0xff;
+                const uint32_t lo = table[index];
+                const uint32_t hi = index < 255 ? table[index + 1] : table[255];
+                dst[i] = static_cast<uint16_t>(lo + ((hi - lo) * frac >> 8));
+            }
+        }
+
+        /// @brief table for channel 0 = w, 1 = r, 2 = g, 3 = b
+        const std::array<uint8_t, 256>& table(int channel) const { return table_[channel]; }
+        const std::array<uint16_t, 256>& wide_table(int channel) const { return wide_[channel]; }
+    private:
+        void rebuild() {
+            // channel gain in 1/256 steps, 256 keeps the value unchanged
+            scale_[0] = brightness_ + 1;
+            for (int c = 1; c < 4; ++c) {
+                scale_[c] = (brightness_ * balance_[c - 1] + 127) / 255 + 1;
+            }
+            linear_ = gamma_ == 1.0f;
+            identity_ = linear_;
+            for (int c = 0; c < 4; ++c) {
+                identity_ = identity_ && scale_[c] == 256;
+                for (int i = 0; i < 256; ++i) {
+                    if (linear_) {
+                        wide_[c][i] = static_cast<uint16_t>(i * scale_[c]);
+                        table_[c][i] = static_cast<uint8_t>(wide_[c][i] >> 8);
+                    }
+                    else {
+                        auto v = std::pow(i / 255.0, static_cast<double>(gamma_)) * 255.0 * scale_[c];
+                        wide_[c][i] = static_cast<uint16_t>(std::lround(v));
+                        table_[c][i] = static_cast<uint8_t>(std::lround(v / 256.0));
+                    }
+                }
+            }
+        }
+
+        float gamma_ = 1.0f;
+        uint8_t brightness_ = 255;
+        std::array<uint8_t, 3> balance_ = {255, 255, 255};
+        std::array<uint32_t, 4> scale_{};
+        std::array<std::array<uint8_t, 256>, 4> table_{};
+        std::array<std::array<uint16_t, 256>, 4> wide_{};
+        bool linear_ = true;
+        bool identity_ = true;
+    };
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "TemporalDither packs leds assuming a little endian LedColor"
+#endif
+    /// @brief Frame rate control, the fraction lost when cutting 8.8 values down to 8 bits is carried to the next frame
+    ///
+    /// Averaged over a few frames each channel shows its full precision value, which hides banding in slow dark fades.
+    class TemporalDither {
+    public:
+        /// @brief src holds four 8.8 values per led in b, g, r, w order
+        void quantize(const uint16_t* src, LedColor* dst, size_t n) {
+            const size_t count = 4 * n;
+            if (error_.size() != count) {
+                error_.resize(count);
+                bytes_.resize(count);
+                // staggered start so neighbouring leds do not step up on the same frame
+                for (size_t i = 0; i < count; ++i) {
+                    error_[i] = static_cast<uint8_t>(i * 97);
+                }
+            }
+            // max 0xff00 + 0xff, the sum never leaves 16 bits
+            for (size_t i = 0; i < count; ++i) {
+                const uint16_t sum = src[i] + error_[i];
+                bytes_[i] = static_cast<uint8_t>(sum >> 8);
+                error_[i] = static_cast<uint8_t>(sum);
+            }
+            // b, g, r, w bytes are the in-memory layout of a little endian LedColor
+            std::memcpy(dst, bytes_.data(), count);
+        }
+
+        void reset() {
+            error_.clear();
+            bytes_.clear();
+        }
+    private:
+        std::vector<uint8_t> error_;
+        std::vector<uint8_t> bytes_;
+    };
+
+    /// @brief Compresses 16 bit high dynamic range leds into 8.8 fixed point output range
+    ///
+    /// Channels up to unity pass linearly, so promoted 8 bit content presents unchanged. The headroom above it
+    /// rolls off towards white: the brightest color channel's excess is compressed and added to all three, so
+    /// additive highlights saturate gracefully instead of clipping to a hue shifted color.
+    class ToneMapper {
+    public:
+        /// @brief value of a full 8 bit channel, leaves 8x headroom for accumulation
+        static constexpr uint32_t unity = 8192;
+        static constexpr uint32_t headroom = 0xffff - unity;
+
+        /// @brief n leds of four values in b, g, r, w order
+        static void map(const uint16_t* src, uint16_t* dst, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                const uint16_t* in = src + 4 * i;
+                uint16_t* out = dst + 4 * i;
+                const uint32_t peak = std::max({in[0], in[1], in[2]});
+                // half of unity at full headroom, so even the brightest highlight keeps some of its hue
+                const uint32_t excess = peak > unity ? peak - unity : 0;
+                const uint32_t bleed = unity * excess / (excess + headroom);
+                for (int k = 0; k < 4; ++k) {
+                    const uint32_t v = std::min<uint32_t>(in[k] + (k < 3 ? bleed : 0), unity);
+                    // 255 * 256 / unity
+                    out[k] = static_cast<uint16_t>(v * 255 >> 5);
+                }
+            }
+        }
+    };
+
+    /// @brief 3x3 color matrix plus offsets for one panel, rows produce r, g, b from r, g, b, white passes through
+    ///
+    /// Matrices without cross terms fold into three 256 entry tables, the rest run in 4.12 fixed point.
+    class ColorCorrection {
+    public:
+        /// @brief throws on values that are not finite, matrix entries are clamped to +-max_gain and offsets to +-255
+        /// so that the fixed point sums stay within 32 bits
+        ColorCorrection(const std::array<float, 9>& matrix, const std::array<float, 3>& offset) {
+            if (!std::all_of(matrix.begin(), matrix.end(), [](float v) { return std::isfinite(v); })
+                || !std::all_of(offset.begin(), offset.end(), [](float v) { return std::isfinite(v); })) {
+                throw std::invalid_argument("ColorCorrection");
+            }
+            diagonal_ = true;
+            for (int row = 0; row < 3; ++row) {
+                for (int col = 0; col < 3; ++col) {
+                    const float m = std::clamp(matrix[row * 3 + col], -max_gain, max_gain);
+                    matrix_[row * 3 + col] = static_cast<int32_t>(std::lround(m * one));
+                    diagonal_ = diagonal_ && (row == col || m == 0);
+                }
+                offset_[row] = static_cast<int32_t>(std::lround(std::clamp(offset[row], -255.0f, 255.0f) * one)) + one / 2;
+            }
+            if (diagonal_) {
+                for (int c = 0; c < 3; ++c) {
+                    for (int v = 0; v < 256; ++v) {
+                        table_[c][v] = clamp8(matrix_[c * 4] * v + offset_[c]);
+                    }
+                }
+            }
+        }
+
+        void apply(LedColor* leds, size_t n) const {
+            if (diagonal_) {
+                for (size_t i = 0; i < n; ++i) {
+                    const uint32_t c = leds[i];
+                    leds[i] = (c & 0xff000000)
+                        | static_cast<uint32_t>(table_[0][(c >> 16) & 0xff]) << 16
+                        | static_cast<uint32_t>(table_[1][(c >> 8) & 0xff]) << 8
+                        | table_[2][c & 0xff];
+                }
+                return;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                const uint32_t c = leds[i];
+                const int32_t r = (c >> 16) & 0xff, g = (c >> 8) & 0xff, b = c & 0xff;
+                leds[i] = (c & 0xff000000)
+                    | static_cast<uint32_t>(clamp8(matrix_[0] * r + matrix_[1] * g + matrix_[2] * b + offset_[0])) << 16
+                    | static_cast<uint32_t>(clamp8(matrix_[3] * r + matrix_[4] * g + matrix_[5] * b + offset_[1])) << 8
+                    | clamp8(matrix_[6] * r + matrix_[7] * g + matrix_[8] * b + offset_[2]);
+            }
+        }
+
+        bool diagonal() const { return diagonal_; }
+
+        static constexpr int32_t one = 1 << 12;
+        static constexpr float max_gain = 16;
+    private:
+        static uint8_t clamp8(int32_t v) {
+            return static_cast<uint8_t>(std::clamp(v >> 12, 0, 255));
+        }
+
+        std::array<int32_t, 9> matrix_{};
+        std::array<int32_t, 3> offset_{};
+        std::array<std::array<uint8_t, 256>, 3> table_{};
+        bool diagonal_ = false;
+    };
+
+    /// @brief Color corrections applied to regions of the DMA buffer, each region a set of led indices
+    ///
+    /// Indices are merged into contiguous runs up front, the per frame work is one loop per run.
+    class PanelCalibration {
+    public:
+        void add(const ColorCorrection& correction, std::vector<int> leds) {
+            const auto panel = corrections_.size();
+            corrections_.push_back(correction);
+            std::sort(leds.begin(), leds.end());
+            leds.erase(std::unique(leds.begin(), leds.end()), leds.end());
+            for (auto led : leds) {
+                if (!runs_.empty() && runs_.back().panel == panel && runs_.back().begin + runs_.back().count == static_cast<size_t>(led)) {
+                    ++runs_.back().count;
+                }
+                else {
+                    runs_.push_back({static_cast<size_t>(led), 1, panel});
+                }
+            }
+        }
+
+        void apply(LedColor* dma, size_t n) const {
+            for (const auto& run : runs_) {
+                if (run.begin < n) {
+                    corrections_[run.panel].apply(dma + run.begin, std::min(run.count, n - run.begin));
+                }
+            }
+        }
+
+        bool empty() const { return runs_.empty(); }
+        size_t runs() const { return runs_.size(); }
+    private:
+        struct Run {
+            size_t begin;
+            size_t count;
+            size_t panel;
+        };
+
+        std::vector<ColorCorrection> corrections_;
+        std::vector<Run> runs_;
+    };
+
+    /// @brief Estimates the supply current of a frame and scales it down to stay within a budget
+    ///
+    /// Each channel draws its full scale current proportionally to its value, plus a constant idle current per led.
+    /// Limiting takes effect on the same frame, recovering is rate limited and only starts once the frame is
+    /// clearly below the budget, so content hovering around the limit does not pump.
+    class PowerLimiter {
+    public:
+        /// @brief 0 disables limiting, the estimate is still reported
+        void set_budget(uint32_t milliamps) {
+            budget_ = milliamps;
+        }
+
+        /// @brief full scale current of each channel and the quiescent current of a led, in milliamps
+        void set_model(float r, float g, float b, float w, float idle) {
+            // 16.16 milliamps per channel step
+            model_ = {
+                static_cast<uint32_t>(w * 65536 / 255),
+                static_cast<uint32_t>(r * 65536 / 255),
+                static_cast<uint32_t>(g * 65536 / 255),
+                static_cast<uint32_t>(b * 65536 / 255),
+            };
+            idle_ = idle;
+        }
+
+        void set_voltage(float volts) {
+            voltage_ = volts;
+        }
+
+        /// @brief current of the frame without limiting, in milliamps
+        float estimate(const LedColor* dma, size_t n) const {
+            // per channel sums, split in blocks so the 32 bit accumulators cannot overflow
+            uint64_t total[4] = {};
+            for (size_t begin = 0; begin < n; begin += 1 << 24) {
+                const size_t end = std::min(n, begin + (size_t{1} << 24));
+                uint32_t sum_w = 0, sum_r = 0, sum_g = 0, sum_b = 0;
+                for (size_t i = begin; i < end; ++i) {
+                    const uint32_t c = dma[i];
+                    sum_w += c >> 24;
+                    sum_r += (c >> 16) & 0xff;
+                    sum_g += (c >> 8) & 0xff;
+                    sum_b += c & 0xff;
+                }
+                total[0] += sum_w;
+                total[1] += sum_r;
+                total[2] += sum_g;
+                total[3] += sum_b;
+            }
+            uint64_t weighted = 0;
+            for (int c = 0; c < 4; ++c) {
+                weighted += total[c] * model_[c];
+            }
+            return static_cast<float>(weighted / 65536.0) + idle_ * n;
+        }
+
+        /// @brief scale dma in place when it exceeds the budget
+        void limit(LedColor* dma, size_t n) {
+            const float drawn = estimate(dma, n);
+            const float idle = idle_ * n;
+            uint32_t target = 256;
+            if (budget_ > 0 && drawn > budget_) {
+                // a budget below the idle current leaves nothing for the channels, black frames included
+                const float available = budget_ - idle;
+                const float channels = drawn - idle;
+                target = 0;
+                if (available > 0 && channels > 0) {
+                    target = static_cast<uint32_t>(std::clamp(256 * available / channels, 0.0f, 256.0f));
+                }
+            }
+            if (target < scale_) {
+                scale_ = target;
+            }
+            else if (scale_ < 256) {
+                // ramp back up only while the next step stays 1/16 below the budget
+                const uint32_t next = std::min<uint32_t>(256, scale_ + recover_step);
+                if (budget_ == 0 || idle + (drawn - idle) * next / 256 <= budget_ * 15.0f / 16) {
+                    scale_ = next;
+                }
+            }
+            if (scale_ < 256) {
+                for (size_t i = 0; i < n; ++i) {
+                    const uint32_t c = dma[i];
+                    // every channel at once, the two halves keep a spare byte between fields
+                    const uint32_t rb = ((c & 0x00ff00ff) * scale_ >> 8) & 0x00ff00ff;
+                    const uint32_t wg = (((c >> 8) & 0x00ff00ff) * scale_) & 0xff00ff00;
+                    dma[i] = rb | wg;
+                }
+            }
+            milliamps_ = idle + (drawn - idle) * scale_ / 256;
+        }
+
+        float milliamps() const { return milliamps_; }
+        float watts() const { return milliamps_ * voltage_ / 1000; }
+        /// @brief applied gain in 1/256 steps
+        uint32_t scale() const { return scale_; }
+
+        static constexpr uint32_t recover_step = 4;
+    private:
+        uint32_t budget_ = 0;
+        std::array<uint32_t, 4> model_ = {20 * 65536 / 255, 20 * 65536 / 255, 20 * 65536 / 255, 20 * 65536 / 255};
+        float idle_ = 1.0f;
+        float voltage_ = 5.0f;
+        uint32_t scale_ = 256;
+        float milliamps_ = 0;
+    };
+
+    /// @brief Output stage run once per presented frame, from the logical framebuffer into the DMA buffer
+    class OutputPipeline {
+    public:
+        void set_gamma(float gamma) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            lut_.set_gamma(gamma);
+        }
+
+        void set_white_balance(uint8_t r, uint8_t g, uint8_t b) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            lut_.set_white_balance(r, g, b);
+        }
+
+        void set_brightness(uint8_t brightness) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            lut_.set_brightness(brightness);
+        }
+
+        void set_dither(bool dither) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            dither_enabled_ = dither;
+            if (!dither) {
+                dither_.reset();
+            }
+        }
+
+        void set_power_budget(uint32_t milliamps) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            power_.set_budget(milliamps);
+        }
+
+        void set_power_model(float r, float g, float b, float w, float idle, float volts) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            power_.set_model(r, g, b, w, idle);
+            power_.set_voltage(volts);
+        }
+
+        /// @brief per panel color correction, replaces the previous one
+        void set_calibration(PanelCalibration calibration) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            calibration_ = std::move(calibration);
+        }
+
+        /// @brief estimated draw of the last processed frame
+        float watts() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return power_.watts();
+        }
+
+        uint32_t power_scale() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return power_.scale();
+        }
+
+        /// @brief only the white extraction is done here, rpi_ws281x orders the bytes itself
+        void set_pixel_format(PixelFormatId format) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            format_ = format;
+        }
+
+        void process(const LedColor* frame, LedColor* dma, size_t n) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (dither_enabled_) {
+                wide_.resize(4 * n);
+                lut_.expand(frame, wide_.data(), n);
+                dither_.quantize(wide_.data(), dma, n);
+            }
+            else {
+                lut_.apply(frame, dma, n);
+            }
+            finish(dma, n);
+        }
+
+        /// @brief present a 16 bit frame, four values per led in b, g, r, w order with ToneMapper::unity as white
+        void process(const uint16_t* hdr, LedColor* dma, size_t n) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wide_.resize(4 * n);
+            ToneMapper::map(hdr, wide_.data(), n);
+            lut_.map_wide(wide_.data(), wide_.data(), n);
+            if (dither_enabled_) {
+                dither_.quantize(wide_.data(), dma, n);
+            }
+            else {
+                for (size_t i = 0; i < n; ++i) {
+                    const uint16_t* v = wide_.data() + 4 * i;
+                    dma[i] = round8(v[3]) << 24 | round8(v[2]) << 16 | round8(v[1]) << 8 | round8(v[0]);
+                }
+            }
+            finish(dma, n);
+        }
+    private:
+        void finish(LedColor* dma, size_t n) {
+            if (!calibration_.empty()) {
+                calibration_.apply(dma, n);
+            }
+            if (needs_conversion(format_)) {
+                convert_pixels(format_, dma, dma, n);
+            }
+            // after white extraction, the estimate follows the leds actually lit
+            power_.limit(dma, n);
+        }
+
+        static LedColor round8(uint32_t v) {
+            return std::min<uint32_t>((v + 0x80) >> 8, 0xff);
+        }
+
+        mutable std::mutex mutex_;
+        ColorLut lut_;
+        PanelCalibration calibration_;
+        PowerLimiter power_;
+        bool dither_enabled_ = false;
+        PixelFormatId format_ = PixelFormatId::grb;
+        TemporalDither dither_;
+        std::vector<uint16_t> wide_;
+    };
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "render.hpp"
+#include "surface.hpp"
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+namespace ohtoai::rpi {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "rgb24 packing assumes a little endian LedColor"
+#endif
+    /// @brief drop the white byte, three bytes per led in b, g, r order, the in-memory layout of a LedColor without w
+    inline void pack_rgb24(const LedColor* src, uint8_t* dst, size_t n) {
+        size_t i = 0;
+        // four leds become three words, shifts instead of byte copies
+        for (; i + 4 <= n; i += 4) {
+            const uint32_t p0 = src[i], p1 = src[i + 1], p2 = src[i + 2], p3 = src[i + 3];
+            const uint32_t words[3] = {
+                (p0 & 0xffffff) | p1 << 24,
+                ((p1 >> 8) & 0xffff) | p2 << 16,
+                ((p2 >> 16) & 0xff) | p3 << 8,
+            };
+            std::memcpy(dst + 3 * i, words, sizeof(words));
+        }
+        for (; i < n; ++i) {
+            std::memcpy(dst + 3 * i, &src[i], 3);
+        }
+    }
+
+    /// @brief inverse of pack_rgb24, white is zero
+    inline void unpack_rgb24(const uint8_t* src, LedColor* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            uint32_t words[3];
+            std::memcpy(words, src + 3 * i, sizeof(words));
+            dst[i] = words[0] & 0xffffff;
+            dst[i + 1] = (words[0] >> 24 | words[1] << 8) & 0xffffff;
+            dst[i + 2] = (words[1] >> 16 | words[2] << 16) & 0xffffff;
+            dst[i + 3] = words[2] >> 8;
+        }
+        for (; i < n; ++i) {
+            LedColor color = 0;
+            std::memcpy(&color, src + 3 * i, 3);
+            dst[i] = color;
+        }
+    }
+
+    /// @brief Surface with three bytes per led for rgb content, a quarter less memory than a Pixmap
+    ///
+    /// Rows are converted in bulk when drawing into it and out of it, single leds are read by value.
+    class PackedPixmap {
+    public:
+        PackedPixmap(int w, int h, LedColor back = Led::Black)
+            : width_(w), height_(h), back_(back), data_(3 * static_cast<size_t>(w) * h) {
+            clear();
+        }
+
+        int width() const { return width_; }
+        int height() const { return height_; }
+
+        LedColor led(int x, int y) const {
+            LedColor color = 0;
+            std::memcpy(&color, &data_[3 * (static_cast<size_t>(y) * width_ + x)], 3);
+            return color;
+        }
+
+        void set(int x, int y, LedColor color) {
+            std::memcpy(&data_[3 * (static_cast<size_t>(y) * width_ + x)], &color, 3);
+        }
+
+        void set_background(LedColor color) { back_ = color; }
+
+        void clear() {
+            LedColor chunk[chunk_size];
+            std::fill(std::begin(chunk), std::end(chunk), back_);
+            for (int y = 0; y < height_; ++y) {
+                for (int x = 0; x < width_; x += chunk_size) {
+                    pack_rgb24(chunk, row(y) + 3 * x, std::min(chunk_size, width_ - x));
+                }
+            }
+        }
+
+        /// @brief copy src at x, y, clipped
+        void draw(const IPaintSource& src, int x, int y) {
+            const int x0 = std::max(0, x);
+            const int x1 = std::min(width_, x + src.width());
+            if (x0 >= x1) {
+                return;
+            }
+            LedColor chunk[chunk_size];
+            for (int dy = std::max(0, y); dy < std::min(height_, y + src.height()); ++dy) {
+                for (int cx = x0; cx < x1; cx += chunk_size) {
+                    const int n = std::min(chunk_size, x1 - cx);
+                    for (int i = 0; i < n; ++i) {
+                        chunk[i] = src.led(cx + i - x, dy - y);
+                    }
+                    pack_rgb24(chunk, row(dy) + 3 * cx, n);
+                }
+            }
+        }
+
+        /// @brief unpack into dst at x, y, clipped, whole rows at a time when dst is an unrotated Pixmap of the same width
+        void unpack(Pixmap& dst, int x = 0, int y = 0) const {
+            const bool rows = x == 0 && dst.width() == width_ && !dst.rotated();
+            for (int sy = std::max(0, -y); sy < height_ && y + sy < dst.height(); ++sy) {
+                if (rows) {
+                    unpack_rgb24(row(sy), dst.data() + static_cast<size_t>(y + sy) * width_, width_);
+                    continue;
+                }
+                for (int sx = std::max(0, -x); sx < width_ && x + sx < dst.width(); ++sx) {
+                    dst.led_ref(x + sx, y + sy) = led(sx, sy);
+                }
+            }
+        }
+
+        const uint8_t* row(int y) const { return data_.data() + 3 * static_cast<size_t>(y) * width_; }
+        uint8_t* row(int y) { return data_.data() + 3 * static_cast<size_t>(y) * width_; }
+        size_t bytes() const { return data_.size(); }
+    private:
+        // conversion scratch lives on the stack of each call, handlers on several rpc threads draw into one surface
+        static constexpr int chunk_size = 64;
+
+        int width_;
+        int height_;
+        LedColor back_;
+        std::vector<uint8_t> data_;
+    };
+
+    using PackedSurfaceRegistry = NamedSurfaceRegistry<PackedPixmap>;
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "render.hpp"
+#include "surface.hpp"
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace ohtoai::rpi {
+    using Palette = std::array<LedColor, 256>;
+
+    /// @brief 8-bit palette indices per led, a quarter of the memory of a Pixmap
+    ///
+    /// Color cycling only rewrites the palette, the indices stay untouched.
+    class IndexedPixmap final : public IPaintSource {
+    public:
+        IndexedPixmap(int w, int h)
+            : width_(w), height_(h), indices_(static_cast<size_t>(w) * h) {
+            palette_.fill(Led::Black);
+        }
+
+        int width() const override { return width_; }
+        int height() const override { return height_; }
+        const LedColor& led(int x, int y) const override {
+            return palette_[indices_[static_cast<size_t>(y) * width_ + x]];
+        }
+
+        uint8_t index(int x, int y) const { return indices_[static_cast<size_t>(y) * width_ + x]; }
+        void set_index(int x, int y, uint8_t index) { indices_[static_cast<size_t>(y) * width_ + x] = index; }
+
+        void set_indices(const std::vector<uint8_t>& indices) {
+            if (indices.size() != indices_.size()) {
+                throw std::invalid_argument(fmt::format("IndexedPixmap::set_indices {} for {}x{}", indices.size(), width_, height_));
+            }
+            indices_ = indices;
+        }
+
+        const Palette& palette() const { return palette_; }
+
+        void set_palette(const std::vector<LedColor>& colors, int first = 0) {
+            if (first < 0 || first + colors.size() > palette_.size()) {
+                throw std::out_of_range(fmt::format("IndexedPixmap::set_palette {} colors @ {}", colors.size(), first));
+            }
+            std::copy(colors.begin(), colors.end(), palette_.begin() + first);
+            ++palette_version_;
+        }
+
+        /// @brief rotate entries [first, last] by steps, the classic color cycling animation
+        void cycle_palette(int first, int last, int steps) {
+            if (first < 0 || last >= static_cast<int>(palette_.size()) || first >= last) {
+                throw std::out_of_range(fmt::format("IndexedPixmap::cycle_palette [{}, {}]", first, last));
+            }
+            const int span = last - first + 1;
+            steps = ((steps % span) + span) % span;
+            std::rotate(palette_.begin() + first, palette_.begin() + last + 1 - steps, palette_.begin() + last + 1);
+            ++palette_version_;
+        }
+
+        /// @brief expand row y into dst, width() leds
+        void expand_row(int y, LedColor* dst) const {
+            const uint8_t* src = indices_.data() + static_cast<size_t>(y) * width_;
+            const LedColor* palette = palette_.data();
+            int x = 0;
+            // independent loads keep the pipeline busy, there is no byte indexed table lookup wide enough for 256 words
+            for (; x + 4 <= width_; x += 4) {
+                dst[x] = palette[src[x]];
+                dst[x + 1] = palette[src[x + 1]];
+                dst[x + 2] = palette[src[x + 2]];
+                dst[x + 3] = palette[src[x + 3]];
+            }
+            for (; x < width_; ++x) {
+                dst[x] = palette[src[x]];
+            }
+        }
+
+        /// @brief expand into a Pixmap of at least the same size
+        void expand(Pixmap& dst) const {
+            if (dst.width() < width_ || dst.height() < height_) {
+                throw std::invalid_argument("IndexedPixmap::expand");
+            }
+            const bool rows = dst.width() == width_ && !dst.rotated();
+            for (int y = 0; y < height_; ++y) {
+                if (rows) {
+                    expand_row(y, dst.data() + static_cast<size_t>(y) * width_);
+                }
+                else {
+                    for (int x = 0; x < width_; ++x) {
+                        dst.led_ref(x, y) = led(x, y);
+                    }
+                }
+            }
+        }
+
+        /// @brief map true color pixels onto the current palette, optionally with Floyd-Steinberg error diffusion
+        void quantize(const std::vector<LedColor>& pixels, bool dither) {
+            if (pixels.size() != indices_.size()) {
+                throw std::invalid_argument(fmt::format("IndexedPixmap::quantize {} for {}x{}", pixels.size(), width_, height_));
+            }
+            build_inverse();
+            if (!dither) {
+                for (size_t i = 0; i < pixels.size(); ++i) {
+                    auto c = pixels[i];
+                    indices_[i] = nearest((c >> 16) & 0xff, (c >> 8) & 0xff, c & 0xff);
+                }
+                return;
+            }
+            // error rows for the current and the next line, one slot of padding on both sides
+            std::vector<int> current(3 * (width_ + 2)), next(3 * (width_ + 2));
+            for (int y = 0; y < height_; ++y) {
+                std::fill(next.begin(), next.end(), 0);
+                for (int x = 0; x < width_; ++x) {
+                    auto c = pixels[static_cast<size_t>(y) * width_ + x];
+                    int want[3] = {
+                        static_cast<int>((c >> 16) & 0xff) + current[3 * (x + 1)] / 16,
+                        static_cast<int>((c >> 8) & 0xff) + current[3 * (x + 1) + 1] / 16,
+                        static_cast<int>(c & 0xff) + current[3 * (x + 1) + 2] / 16,
+                    };
+                    for (auto& v : want) {
+                        v = std::clamp(v, 0, 255);
+                    }
+                    auto index = nearest(want[0], want[1], want[2]);
+                    indices_[static_cast<size_t>(y) * width_ + x] = index;
+                    auto got = palette_[index];
+                    int err[3] = {
+                        want[0] - static_cast<int>((got >> 16) & 0xff),
+                        want[1] - static_cast<int>((got >> 8) & 0xff),
+                        want[2] - static_cast<int>(got & 0xff),
+                    };
+                    for (int k = 0; k < 3; ++k) {
+                        current[3 * (x + 2) + k] += err[k] * 7;
+                        next[3 * x + k] += err[k] * 3;
+                        next[3 * (x + 1) + k] += err[k] * 5;
+                        next[3 * (x + 2) + k] += err[k];
+                    }
+                }
+                std::swap(current, next);
+            }
+        }
+
+        const std::vector<uint8_t>& indices() const { return indices_; }
+    private:
+        static size_t cell(int r, int g, int b) {
+            return static_cast<size_t>(r >> 3) << 10 | static_cast<size_t>(g >> 3) << 5 | static_cast<size_t>(b >> 3);
+        }
+
+        uint8_t nearest(int r, int g, int b) const {
+            return inverse_[cell(r, g, b)];
+        }
+
+        /// @brief 5:5:5 inverse color map, rebuilt only when the palette changed since the last import
+        void build_inverse() {
+            if (inverse_version_ == palette_version_ && !inverse_.empty()) {
+                return;
+            }
+            inverse_.resize(1 << 15);
+            for (int r = 0; r < 32; ++r) {
+                for (int g = 0; g < 32; ++g) {
+                    for (int b = 0; b < 32; ++b) {
+                        const int cr = r << 3 | 4, cg = g << 3 | 4, cb = b << 3 | 4;
+                        int best = 0;
+                        int best_distance = std::numeric_limits<int>::max();
+                        for (int i = 0; i < static_cast<int>(palette_.size()); ++i) {
+                            const int dr = cr - static_cast<int>((palette_[i] >> 16) & 0xff);
+                            const int dg = cg - static_cast<int>((palette_[i] >> 8) & 0xff);
+                            const int db = cb - static_cast<int>(palette_[i] & 0xff);
+                            const int distance = dr * dr + dg * dg + db * db;
+                            if (distance < best_distance) {
+                                best_distance = distance;
+                                best = i;
+                            }
+                        }
+                        inverse_[cell(r << 3, g << 3, b << 3)] = static_cast<uint8_t>(best);
+                    }
+                }
+            }
+            inverse_version_ = palette_version_;
+        }
+
+        int width_;
+        int height_;
+        std::vector<uint8_t> indices_;
+        Palette palette_;
+        uint64_t palette_version_ = 0;
+        uint64_t inverse_version_ = 0;
+        std::vector<uint8_t> inverse_;
+    };
+
+    using IndexedSurfaceRegistry = NamedSurfaceRegistry<IndexedPixmap>;
+}
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "effect.hpp"
+#include "fade.hpp"
+#include <cmath>
+#include <vector>
+
+namespace ohtoai::rpi {
+    /// @brief Spawns particles in a rectangle, heading at angle (radians, 0 is +x, y grows downwards) within spread
+    struct Emitter {
+        float x = 0;
+        float y = 0;
+        float w = 0;
+        float h = 0;
+        /// @brief particles per second, 0 for bursts only
+        float rate = 0;
+        float angle = 0;
+        float spread = 3.14159265f;
+        float speed_min = 5;
+        float speed_max = 10;
+        float life_min = 1;
+        float life_max = 2;
+        /// @brief color at birth and at the end of life, mixed over the lifetime
+        LedColor color_from = Led::White;
+        LedColor color_to = Led::Black;
+    };
+
+    /// @brief adds each channel, saturating at 255
+    inline LedColor add_saturate(LedColor a, LedColor b) {
+        // per byte sums with the carries taken out, then every byte that overflowed is filled with ones
+        const uint32_t sum = (a & 0x7f7f7f7f) + (b & 0x7f7f7f7f);
+        const uint32_t carry = ((a & b) | ((a | b) & sum)) & 0x80808080;
+        return (sum ^ ((a ^ b) & 0x80808080)) | (carry - (carry >> 7)) | carry;
+    }
+
+    /// @brief Particles kept as structure of arrays in a pool allocated up front
+    ///
+    /// Integration runs as plain loops over each array, dead particles are swapped with the last live one,
+    /// so the live range stays contiguous. Spawning beyond the capacity drops the particle.
+    class ParticleSystem {
+    public:
+        explicit ParticleSystem(size_t capacity)
+            : capacity_(capacity), x_(capacity), y_(capacity), vx_(capacity), vy_(capacity),
+            age_(capacity), life_(capacity), from_(capacity), to_(capacity) {}
+
+        void set_gravity(float gx, float gy) {
+            gx_ = gx;
+            gy_ = gy;
+        }
+
+        /// @brief velocity multiplier per second, 1 keeps full speed
+        void set_drag(float drag) { drag_ = drag; }
+
+        bool spawn(float x, float y, float vx, float vy, float life, LedColor from, LedColor to) {
+            if (count_ == capacity_ || !(life > 0)) {
+                ++dropped_;
+                return false;
+            }
+            const auto i = count_++;
+            x_[i] = x;
+            y_[i] = y;
+            vx_[i] = vx;
+            vy_[i] = vy;
+            age_[i] = 0;
+            life_[i] = life;
+            from_[i] = from;
+            to_[i] = to;
+            return true;
+        }
+
+        /// @brief count particles from an emitter at once
+        void burst(const Emitter& emitter, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                emit(emitter);
+            }
+        }
+
+        /// @brief continuous emission over dt seconds, the fractional particle carries to the next call
+        void emit(const Emitter& emitter, float dt, float& carry) {
+            carry += emitter.rate * dt;
+            // beyond the capacity every spawn is dropped, and at huge counts carry -= 1 no longer changes the float
+            if (!(carry <= static_cast<float>(capacity_))) {
+                carry = static_cast<float>(capacity_);
+            }
+            for (; carry >= 1; carry -= 1) {
+                emit(emitter);
+            }
+        }
+
+        void update(float dt) {
+            const size_t n = count_;
+            const float gx = gx_ * dt, gy = gy_ * dt;
+            const float drag = drag_ == 1 ? 1 : std::pow(drag_, dt);
+            for (size_t i = 0; i < n; ++i) {
+                vx_[i] = (vx_[i] + gx) * drag;
+                vy_[i] = (vy_[i] + gy) * drag;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                x_[i] += vx_[i] * dt;
+                y_[i] += vy_[i] * dt;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                age_[i] += dt;
+            }
+            for (size_t i = 0; i < count_;) {
+                if (age_[i] >= life_[i]) {
+                    remove(i);
+                }
+                else {
+                    ++i;
+                }
+            }
+        }
+
+        /// @brief add every particle into a row major w x h buffer, colors saturate
+        void splat(LedColor* buffer, int w, int h) const {
+            for (size_t i = 0; i < count_; ++i) {
+                // compare as floats first, NaN and out of range values fail here and never reach the cast
+                if (!(x_[i] >= 0 && x_[i] < static_cast<float>(w) && y_[i] >= 0 && y_[i] < static_cast<float>(h))) {
+                    continue;
+                }
+                const int px = static_cast<int>(x_[i]);
+                const int py = static_cast<int>(y_[i]);
+                const auto t = static_cast<uint8_t>(std::min(age_[i] / life_[i], 1.0f) * 255);
+                auto& led = buffer[static_cast<size_t>(py) * w + px];
+                led = add_saturate(led, mix(from_[i], to_[i], t));
+            }
+        }
+
+        void clear() { count_ = 0; }
+        size_t size() const { return count_; }
+        size_t capacity() const { return capacity_; }
+        /// @brief spawns refused because the pool was full
+        uint64_t dropped() const { return dropped_; }
+    private:
+        void emit(const Emitter& e) {
+            const float angle = e.angle + e.spread * (uniform() * 2 - 1);
+            const float speed = e.speed_min + (e.speed_max - e.speed_min) * uniform();
+            spawn(e.x + e.w * uniform(), e.y + e.h * uniform(), std::cos(angle) * speed, std::sin(angle) * speed,
+                e.life_min + (e.life_max - e.life_min) * uniform(), e.color_from, e.color_to);
+        }
+
+        float uniform() { return (random_.next() >> 8) * (1.0f / 16777216); }
+
+        void remove(size_t i) {
+            const auto last = --count_;
+            x_[i] = x_[last];
+            y_[i] = y_[last];
+            vx_[i] = vx_[last];
+            vy_[i] = vy_[last];
+            age_[i] = age_[last];
+            life_[i] = life_[last];
+            from_[i] = from_[last];
+            to_[i] = to_[last];
+        }
+
+        size_t capacity_;
+        size_t count_ = 0;
+        std::vector<float> x_;
+        std::vector<float> y_;
+        std::vector<float> vx_;
+        std::vector<float> vy_;
+        std::vector<float> age_;
+        std::vector<float> life_;
+        std::vector<LedColor> from_;
+        std::vector<LedColor> to_;
+        float gx_ = 0;
+        float gy_ = 0;
+        float drag_ = 1;
+        uint64_t dropped_ = 0;
+        detail::Random random_;
+    };
+
+    /// @brief Particle presets as an effect, "fireworks" bursts rockets in random hues, "rain" drops from the top row
+    class ParticleEffect final : public Effect {
+    public:
+        ParticleEffect(int w, int h, bool fireworks, size_t capacity = 4096)
+            : Effect(w, h), particles_(capacity), fireworks_(fireworks) {
+            if (fireworks_) {
+                particles_.set_gravity(0, h * 0.5f);
+                particles_.set_drag(0.5f);
+                emitter_.speed_min = 2;
+                emitter_.speed_max = h * 0.4f;
+                emitter_.life_min = 0.8f;
+                emitter_.life_max = 1.6f;
+                emitter_.rate = 0.8f;
+            }
+            else {
+                particles_.set_gravity(0, h * 0.8f);
+                emitter_.w = static_cast<float>(w);
+                emitter_.angle = 3.14159265f / 2;
+                emitter_.spread = 0.05f;
+                emitter_.speed_min = h * 0.5f;
+                emitter_.speed_max = h * 0.8f;
+                emitter_.life_min = emitter_.life_max = 2;
+                emitter_.rate = w * 2.0f;
+                emitter_.color_from = 0x3050ff;
+                emitter_.color_to = 0x000830;
+            }
+        }
+
+        const ParticleSystem& particles() const { return particles_; }
+
+        /// @brief particles, or rockets for fireworks, per second
+        static constexpr double max_rate = 100000;
+    protected:
+        void apply_param(const std::string& key, double value) override {
+            if (key == "rate") {
+                emitter_.rate = static_cast<float>(std::clamp(value, 0.0, max_rate));
+            }
+            else if (key == "gravity") {
+                particles_.set_gravity(0, static_cast<float>(value));
+            }
+            else if (key == "trail") {
+                trail_ = static_cast<uint8_t>(std::clamp(value, 0.0, 255.0));
+            }
+            else {
+                Effect::apply_param(key, value);
+            }
+        }
+
+        void render(uint32_t t) override {
+            const float dt = started_ && t >= last_ ? std::min((t - last_) / 1000.0f, 0.25f) : 0;
+            started_ = true;
+            last_ = t;
+            if (fireworks_) {
+                // every rocket bursts at least 60 particles, more than the pool holds would only be dropped
+                rockets_ = std::min(rockets_ + emitter_.rate * dt, static_cast<float>(particles_.capacity() / 60 + 1));
+                for (; rockets_ >= 1; rockets_ -= 1) {
+                    Emitter shell = emitter_;
+                    shell.x = width_ * (0.2f + 0.6f * (random_.below(1024) / 1024.0f));
+                    shell.y = height_ * (0.2f + 0.4f * (random_.below(1024) / 1024.0f));
+                    shell.color_from = hsv_to_rgb({static_cast<uint16_t>(random_.next()), 200, 255});
+                    particles_.burst(shell, 60 + random_.below(60));
+                }
+            }
+            else {
+                particles_.emit(emitter_, dt, carry_);
+            }
+            particles_.update(dt);
+            fade(frame_.data(), frame_.size(), trail_);
+            particles_.splat(frame_.data(), width_, height_);
+        }
+    private:
+        ParticleSystem particles_;
+        Emitter emitter_;
+        detail::Random random_{0x51ed270b};
+        bool fireworks_;
+        uint8_t trail_ = 0;
+        float carry_ = 0;
+        float rockets_ = 0;
+        uint32_t last_ = 0;
+        bool started_ = false;
+    };
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "color.hpp"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+
+namespace ohtoai::rpi {
+    /// @brief Channel layout of a strip, shifts of each channel in the word sent on the wire, -1 for a missing one
+    ///
+    /// Drawing code always works in 0xWWRRGGBB. rpi_ws281x reorders bytes by strip_type, so the output stage only
+    /// has to derive the white channel; pack() and unpack() give the wire word for code writing raw buffers.
+    template <int RShift, int GShift, int BShift, int WShift, int StripType>
+    struct PixelFormat {
+        static constexpr int strip_type = StripType;
+        static constexpr bool has_white = WShift >= 0;
+
+        static constexpr uint32_t pack(uint8_t r, uint8_t g, uint8_t b, uint8_t w = 0) {
+            uint32_t wire = static_cast<uint32_t>(r) << RShift | static_cast<uint32_t>(g) << GShift | static_cast<uint32_t>(b) << BShift;
+            if constexpr (has_white) {
+                wire |= static_cast<uint32_t>(w) << WShift;
+            }
+            return wire;
+        }
+
+        /// @brief r, g, b, w
+        static constexpr std::array<uint8_t, 4> unpack(uint32_t wire) {
+            return {
+                static_cast<uint8_t>(wire >> RShift),
+                static_cast<uint8_t>(wire >> GShift),
+                static_cast<uint8_t>(wire >> BShift),
+                static_cast<uint8_t>(has_white ? wire >> (WShift < 0 ? 0 : WShift) : 0),
+            };
+        }
+
+        /// @brief logical color to the value handed to rpi_ws281x
+        static constexpr LedColor convert(LedColor color) {
+            if constexpr (has_white) {
+                // the common grey part moves to the white led
+                const uint32_t r = (color >> 16) & 0xff;
+                const uint32_t g = (color >> 8) & 0xff;
+                const uint32_t b = color & 0xff;
+                const uint32_t grey = std::min(r, std::min(g, b));
+                const uint32_t w = std::min<uint32_t>((color >> 24) + grey, 0xff);
+                return w << 24 | (r - grey) << 16 | (g - grey) << 8 | (b - grey);
+            }
+            else {
+                return color;
+            }
+        }
+    };
+
+    using PixelRgb = PixelFormat<16, 8, 0, -1, WS2811_STRIP_RGB>;
+    using PixelGrb = PixelFormat<8, 16, 0, -1, WS2811_STRIP_GRB>;
+    using PixelBrg = PixelFormat<8, 0, 16, -1, WS2811_STRIP_BRG>;
+    using PixelRgbw = PixelFormat<24, 16, 8, 0, SK6812_STRIP_RGBW>;
+    using PixelGrbw = PixelFormat<16, 24, 8, 0, SK6812_STRIP_GRBW>;
+
+    /// @brief Warm white, cool white and amber leds wired as the r, g and b channels of a WS2811 chip
+    struct PixelWwa {
+        static constexpr int strip_type = WS2811_STRIP_RGB;
+        static constexpr bool has_white = false;
+
+        static constexpr uint32_t pack(uint8_t warm, uint8_t cool, uint8_t amber, uint8_t = 0) {
+            return PixelRgb::pack(warm, cool, amber);
+        }
+
+        static constexpr std::array<uint8_t, 4> unpack(uint32_t wire) {
+            return PixelRgb::unpack(wire);
+        }
+
+        /// @brief approximation: the grey part drives cool white, the yellow part warm white and the red rest amber
+        static constexpr LedColor convert(LedColor color) {
+            const uint32_t r = (color >> 16) & 0xff;
+            const uint32_t g = (color >> 8) & 0xff;
+            const uint32_t b = color & 0xff;
+            const uint32_t cool = std::min(r, std::min(g, b));
+            const uint32_t warm = std::min(r - cool, g - cool);
+            const uint32_t amber = r - cool - warm;
+            return warm << 16 | cool << 8 | amber;
+        }
+    };
+
+    enum class PixelFormatId {
+        rgb,
+        grb,
+        brg,
+        rgbw,
+        grbw,
+        wwa,
+    };
+
+    inline PixelFormatId pixel_format_from_string(const std::string& name) {
+        if (name == "rgb") return PixelFormatId::rgb;
+        if (name == "grb") return PixelFormatId::grb;
+        if (name == "brg") return PixelFormatId::brg;
+        if (name == "rgbw") return PixelFormatId::rgbw;
+        if (name == "grbw") return PixelFormatId::grbw;
+        if (name == "wwa") return PixelFormatId::wwa;
+        throw std::invalid_argument("pixel_format_from_string " + name);
+    }
+
+    /// @brief call fn with a default constructed format type for id
+    template <typename Fn>
+    decltype(auto) visit_pixel_format(PixelFormatId id, Fn&& fn) {
+        switch (id) {
+            case PixelFormatId::rgb: return fn(PixelRgb{});
+            case PixelFormatId::grb: return fn(PixelGrb{});
+            case PixelFormatId::brg: return fn(PixelBrg{});
+            case PixelFormatId::rgbw: return fn(PixelRgbw{});
+            case PixelFormatId::grbw: return fn(PixelGrbw{});
+            case PixelFormatId::wwa: return fn(PixelWwa{});
+        }
+        throw std::invalid_argument("visit_pixel_format");
+    }
+
+    inline int strip_type_of(PixelFormatId id) {
+        return visit_pixel_format(id, [](auto format) { return decltype(format)::strip_type; });
+    }
+
+    /// @brief whether the output stage has to touch the colors at all for this format
+    inline bool needs_conversion(PixelFormatId id) {
+        return id == PixelFormatId::rgbw || id == PixelFormatId::grbw || id == PixelFormatId::wwa;
+    }
+
+    template <typename Format>
+    void convert_pixels(const LedColor* src, LedColor* dst, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            dst[i] = Format::convert(src[i]);
+        }
+    }
+
+    /// @brief src and dst may alias
+    inline void convert_pixels(PixelFormatId id, const LedColor* src, LedColor* dst, size_t n) {
+        visit_pixel_format(id, [&](auto format) { convert_pixels<decltype(format)>(src, dst, n); });
+    }
+}
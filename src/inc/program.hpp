@@ -0,0 +1,417 @@
+#pragma once
+
+#include "effect.hpp"
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ohtoai::rpi {
+    /// @brief Per pixel program compiled from a small expression language into a register machine
+    ///
+    /// A program is a list of assignments followed by the result, for example
+    /// `d = hypot(x - w / 2, y - h / 2); hsv(fract(d / 16 - t), 1, 0.5 + 0.5 * sin(d - t * 4))`.
+    /// Inputs are x, y, w, h and t in seconds; the result is rgb(r, g, b), hsv(h, s, v) with components in [0, 1],
+    /// or a single value for grey. There are no loops or memory accesses, division by zero gives 0 and NaN turns black,
+    /// so a program always finishes in as many steps as it has instructions.
+    ///
+    /// Every instruction runs over a whole row of registers, so decoding is paid once per row instead of per pixel
+    /// and the inner loops are plain float arithmetic over spans.
+    class PixelProgram {
+    public:
+        static constexpr size_t max_instructions = 256;
+        static constexpr size_t max_registers = 255;
+
+        explicit PixelProgram(const std::string& source) {
+            Parser parser(source, *this);
+            parser.parse();
+            spdlog::debug("PixelProgram {} instructions, {} registers", code_.size(), registers_);
+        }
+
+        size_t size() const { return code_.size(); }
+
+        /// @brief evaluate row y of a w x h frame at t seconds into dst
+        void run_row(LedColor* dst, int w, int h, int y, float t) {
+            const size_t n = static_cast<size_t>(w);
+            if (lanes_ != n) {
+                lanes_ = n;
+                file_.assign(registers_ * n, 0.0f);
+                for (size_t i = 0; i < n; ++i) {
+                    file_[i] = static_cast<float>(i);
+                }
+                for (const auto& [reg, value] : constants_) {
+                    std::fill_n(reg_ptr(reg), n, value);
+                }
+            }
+            std::fill_n(reg_ptr(reg_y), n, static_cast<float>(y));
+            std::fill_n(reg_ptr(reg_w), n, static_cast<float>(w));
+            std::fill_n(reg_ptr(reg_h), n, static_cast<float>(h));
+            std::fill_n(reg_ptr(reg_t), n, t);
+            for (const auto& ins : code_) {
+                execute(ins, n);
+            }
+            const float* r = reg_ptr(out_[0]);
+            const float* g = reg_ptr(out_[1]);
+            const float* b = reg_ptr(out_[2]);
+            if (hsv_) {
+                hsv_row_.resize(n);
+                for (size_t i = 0; i < n; ++i) {
+                    const float hue = r[i] - std::floor(r[i]);
+                    hsv_row_[i] = {static_cast<uint16_t>(unit(hue) * 65535), static_cast<uint8_t>(unit(g[i]) * 255),
+                        static_cast<uint8_t>(unit(b[i]) * 255)};
+                }
+                hsv_to_rgb(hsv_row_.data(), dst, n);
+                return;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                dst[i] = static_cast<uint32_t>(unit(r[i]) * 255) << 16 | static_cast<uint32_t>(unit(g[i]) * 255) << 8
+                    | static_cast<uint32_t>(unit(b[i]) * 255);
+            }
+        }
+    private:
+        enum class Op : uint8_t {
+            add, sub, mul, div, mod, pow, neg,
+            sin, cos, abs, floor, fract, sqrt,
+            min, max, step, hypot, clamp, mix,
+        };
+
+        struct Instruction {
+            Op op;
+            uint8_t dst;
+            uint8_t a;
+            uint8_t b;
+            uint8_t c;
+        };
+
+        // fixed input registers, x holds the column of every lane
+        static constexpr uint8_t reg_x = 0;
+        static constexpr uint8_t reg_y = 1;
+        static constexpr uint8_t reg_w = 2;
+        static constexpr uint8_t reg_h = 3;
+        static constexpr uint8_t reg_t = 4;
+
+        /// @brief clamp to [0, 1], NaN gives 0
+        static float unit(float v) { return v > 0 ? (v < 1 ? v : 1) : 0; }
+
+        float* reg_ptr(uint8_t reg) { return file_.data() + reg * lanes_; }
+
+        void execute(const Instruction& ins, size_t n) {
+            float* d = reg_ptr(ins.dst);
+            const float* a = reg_ptr(ins.a);
+            const float* b = reg_ptr(ins.b);
+            const float* c = reg_ptr(ins.c);
+            switch (ins.op) {
+                case Op::add: for (size_t i = 0; i < n; ++i) d[i] = a[i] + b[i]; break;
+                case Op::sub: for (size_t i = 0; i < n; ++i) d[i] = a[i] - b[i]; break;
+                case Op::mul: for (size_t i = 0; i < n; ++i) d[i] = a[i] * b[i]; break;
+                case Op::div: for (size_t i = 0; i < n; ++i) d[i] = b[i] != 0 ? a[i] / b[i] : 0; break;
+                case Op::mod: for (size_t i = 0; i < n; ++i) d[i] = b[i] != 0 ? a[i] - b[i] * std::floor(a[i] / b[i]) : 0; break;
+                case Op::pow: for (size_t i = 0; i < n; ++i) d[i] = std::pow(std::abs(a[i]), b[i]); break;
+                case Op::neg: for (size_t i = 0; i < n; ++i) d[i] = -a[i]; break;
+                case Op::sin: for (size_t i = 0; i < n; ++i) d[i] = std::sin(a[i]); break;
+                case Op::cos: for (size_t i = 0; i < n; ++i) d[i] = std::cos(a[i]); break;
+                case Op::abs: for (size_t i = 0; i < n; ++i) d[i] = std::abs(a[i]); break;
+                case Op::floor: for (size_t i = 0; i < n; ++i) d[i] = std::floor(a[i]); break;
+                case Op::fract: for (size_t i = 0; i < n; ++i) d[i] = a[i] - std::floor(a[i]); break;
+                case Op::sqrt: for (size_t i = 0; i < n; ++i) d[i] = std::sqrt(std::abs(a[i])); break;
+                case Op::min: for (size_t i = 0; i < n; ++i) d[i] = std::min(a[i], b[i]); break;
+                case Op::max: for (size_t i = 0; i < n; ++i) d[i] = std::max(a[i], b[i]); break;
+                case Op::step: for (size_t i = 0; i < n; ++i) d[i] = b[i] < a[i] ? 0.0f : 1.0f; break;
+                case Op::hypot: for (size_t i = 0; i < n; ++i) d[i] = std::sqrt(a[i] * a[i] + b[i] * b[i]); break;
+                case Op::clamp: for (size_t i = 0; i < n; ++i) d[i] = std::min(std::max(a[i], b[i]), c[i]); break;
+                case Op::mix: for (size_t i = 0; i < n; ++i) d[i] = a[i] + (b[i] - a[i]) * c[i]; break;
+            }
+        }
+
+        uint8_t allocate() {
+            if (registers_ >= max_registers) {
+                throw std::invalid_argument("PixelProgram needs too many registers");
+            }
+            return static_cast<uint8_t>(registers_++);
+        }
+
+        uint8_t constant(float value) {
+            for (const auto& [reg, existing] : constants_) {
+                if (existing == value) {
+                    return reg;
+                }
+            }
+            auto reg = allocate();
+            constants_.emplace_back(reg, value);
+            return reg;
+        }
+
+        uint8_t emit(Op op, uint8_t a, uint8_t b = 0, uint8_t c = 0) {
+            if (code_.size() >= max_instructions) {
+                throw std::invalid_argument("PixelProgram is too long");
+            }
+            auto dst = allocate();
+            code_.push_back({op, dst, a, b, c});
+            return dst;
+        }
+
+        /// @brief recursive descent straight into instructions, every subexpression gets a fresh register
+        class Parser {
+        public:
+            Parser(const std::string& source, PixelProgram& program) : source_(source), program_(program) {}
+
+            void parse() {
+                for (;;) {
+                    const size_t start = pos_;
+                    std::string name = identifier();
+                    if (!name.empty() && peek() == '=') {
+                        ++pos_;
+                        // pi is looked up before locals, an assignment would be silently ignored
+                        if (is_input(name) || name == "pi" || functions().count(name)) {
+                            fail("cannot assign to " + name);
+                        }
+                        locals_[name] = expression();
+                        expect(';');
+                        continue;
+                    }
+                    pos_ = start;
+                    break;
+                }
+                result();
+                if (peek() == ';') {
+                    ++pos_;
+                }
+                if (peek() != '\0') {
+                    fail("unexpected input");
+                }
+            }
+        private:
+            struct Function {
+                Op op;
+                size_t arity;
+            };
+
+            static const std::unordered_map<std::string, Function>& functions() {
+                static const std::unordered_map<std::string, Function> table = {
+                    {"sin", {Op::sin, 1}}, {"cos", {Op::cos, 1}}, {"abs", {Op::abs, 1}}, {"floor", {Op::floor, 1}},
+                    {"fract", {Op::fract, 1}}, {"sqrt", {Op::sqrt, 1}}, {"min", {Op::min, 2}}, {"max", {Op::max, 2}},
+                    {"step", {Op::step, 2}}, {"hypot", {Op::hypot, 2}}, {"pow", {Op::pow, 2}}, {"mod", {Op::mod, 2}},
+                    {"clamp", {Op::clamp, 3}}, {"mix", {Op::mix, 3}},
+                };
+                return table;
+            }
+
+            static bool is_input(const std::string& name) {
+                return name == "x" || name == "y" || name == "w" || name == "h" || name == "t";
+            }
+
+            /// @brief the last expression, a color constructor or one value for all channels
+            void result() {
+                const size_t start = pos_;
+                const std::string name = identifier();
+                if ((name == "rgb" || name == "hsv") && peek() == '(') {
+                    ++pos_;
+                    for (size_t i = 0; i < 3; ++i) {
+                        if (i > 0) {
+                            expect(',');
+                        }
+                        program_.out_[i] = expression();
+                    }
+                    expect(')');
+                    program_.hsv_ = name == "hsv";
+                    return;
+                }
+                pos_ = start;
+                const auto grey = expression();
+                program_.out_ = {grey, grey, grey};
+            }
+
+            uint8_t expression() {
+                // parentheses emit nothing, so their nesting is bounded apart from the instruction count
+                enter();
+                auto lhs = term();
+                for (char c = peek(); c == '+' || c == '-'; c = peek()) {
+                    ++pos_;
+                    lhs = program_.emit(c == '+' ? Op::add : Op::sub, lhs, term());
+                }
+                --depth_;
+                return lhs;
+            }
+
+            uint8_t term() {
+                auto lhs = unary();
+                for (char c = peek(); c == '*' || c == '/' || c == '%'; c = peek()) {
+                    ++pos_;
+                    lhs = program_.emit(c == '*' ? Op::mul : c == '/' ? Op::div : Op::mod, lhs, unary());
+                }
+                return lhs;
+            }
+
+            uint8_t unary() {
+                // minus and power chains recurse before emitting anything, so they count towards the nesting too
+                enter();
+                uint8_t result;
+                if (peek() == '-') {
+                    ++pos_;
+                    result = program_.emit(Op::neg, unary());
+                }
+                else {
+                    result = primary();
+                    if (peek() == '^') {
+                        ++pos_;
+                        result = program_.emit(Op::pow, result, unary());
+                    }
+                }
+                --depth_;
+                return result;
+            }
+
+            void enter() {
+                if (++depth_ > max_depth) {
+                    fail("nested too deep");
+                }
+            }
+
+            uint8_t primary() {
+                const char c = peek();
+                if (c == '(') {
+                    ++pos_;
+                    auto inner = expression();
+                    expect(')');
+                    return inner;
+                }
+                if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+                    const char* begin = source_.c_str() + pos_;
+                    char* end = nullptr;
+                    const float value = std::strtof(begin, &end);
+                    if (end == begin) {
+                        fail("bad number");
+                    }
+                    pos_ += static_cast<size_t>(end - begin);
+                    return program_.constant(value);
+                }
+                const std::string name = identifier();
+                if (name.empty()) {
+                    fail("expected a value");
+                }
+                if (peek() == '(') {
+                    ++pos_;
+                    auto it = functions().find(name);
+                    if (it == functions().end()) {
+                        fail("unknown function " + name);
+                    }
+                    uint8_t args[3] = {};
+                    for (size_t i = 0; i < it->second.arity; ++i) {
+                        if (i > 0) {
+                            expect(',');
+                        }
+                        args[i] = expression();
+                    }
+                    expect(')');
+                    return program_.emit(it->second.op, args[0], args[1], args[2]);
+                }
+                if (name == "x") return reg_x;
+                if (name == "y") return reg_y;
+                if (name == "w") return reg_w;
+                if (name == "h") return reg_h;
+                if (name == "t") return reg_t;
+                if (name == "pi") return program_.constant(3.14159265f);
+                auto local = locals_.find(name);
+                if (local == locals_.end()) {
+                    fail("unknown name " + name);
+                }
+                return local->second;
+            }
+
+            std::string identifier() {
+                peek();
+                const size_t start = pos_;
+                while (pos_ < source_.size() && (std::isalpha(static_cast<unsigned char>(source_[pos_]))
+                    || source_[pos_] == '_' || (pos_ > start && std::isdigit(static_cast<unsigned char>(source_[pos_]))))) {
+                    ++pos_;
+                }
+                return source_.substr(start, pos_ - start);
+            }
+
+            /// @brief next character after whitespace, '\0' at the end
+            char peek() {
+                while (pos_ < source_.size() && std::isspace(static_cast<unsigned char>(source_[pos_]))) {
+                    ++pos_;
+                }
+                return pos_ < source_.size() ? source_[pos_] : '\0';
+            }
+
+            void expect(char c) {
+                if (peek() != c) {
+                    fail(std::string("expected ") + c);
+                }
+                ++pos_;
+            }
+
+            [[noreturn]] void fail(const std::string& what) const {
+                throw std::invalid_argument(fmt::format("PixelProgram: {} at {}", what, pos_));
+            }
+
+            static constexpr int max_depth = 128;
+
+            const std::string& source_;
+            PixelProgram& program_;
+            size_t pos_ = 0;
+            int depth_ = 0;
+            std::unordered_map<std::string, uint8_t> locals_;
+        };
+
+        std::vector<Instruction> code_;
+        std::vector<std::pair<uint8_t, float>> constants_;
+        size_t registers_ = reg_t + 1;
+        std::array<uint8_t, 3> out_{};
+        bool hsv_ = false;
+        size_t lanes_ = 0;
+        std::vector<float> file_;
+        std::vector<Hsv> hsv_row_;
+    };
+
+    /// @brief PixelProgram as an effect, rows are rendered within a budget of lane operations per frame
+    ///
+    /// A frame costs instructions x width x height operations. When that exceeds the budget, the frame is refreshed
+    /// over several ticks, continuing from the row where the last one stopped, so a heavy program lowers its own
+    /// frame rate instead of the render thread's.
+    class ProgramEffect final : public Effect {
+    public:
+        ProgramEffect(int w, int h, const std::string& source) : Effect(w, h), program_(source) {}
+
+        /// @brief replace the program, the new one is compiled before the old one is dropped
+        void set_program(const std::string& source) {
+            PixelProgram program(source);
+            std::lock_guard<std::mutex> lock(mutex_);
+            program_ = std::move(program);
+        }
+
+        /// @brief a billion lane operations, far beyond a frame of any panel
+        static constexpr double max_budget = 1 << 30;
+    protected:
+        void apply_param(const std::string& key, double value) override {
+            if (key == "budget") {
+                budget_ = static_cast<size_t>(std::clamp(value, 1.0, max_budget));
+            }
+            else {
+                Effect::apply_param(key, value);
+            }
+        }
+
+        void render(uint32_t t) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const size_t row_cost = std::max<size_t>(program_.size(), 1) * static_cast<size_t>(width_);
+            const int rows = static_cast<int>(std::clamp<size_t>(budget_ / row_cost, 1, static_cast<size_t>(height_)));
+            for (int i = 0; i < rows; ++i) {
+                program_.run_row(row(cursor_), width_, height_, cursor_, t / 1000.0f);
+                cursor_ = (cursor_ + 1) % height_;
+            }
+        }
+    private:
+        std::mutex mutex_;
+        PixelProgram program_;
+        /// @brief lane operations per frame, the default fits a 64 instruction program on a 128x64 canvas
+        size_t budget_ = 64 * 128 * 64;
+        int cursor_ = 0;
+    };
+}
@@ -1,26 +1,20 @@
 #pragma once
 
+#include "color.hpp"
+#include "output.hpp"
 #include <ws2811.h>
+#include <atomic>
 #include <vector>
 #include <stdexcept>
 #include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <spdlog/spdlog.h>
 
 namespace ohtoai::rpi {
-    using LedColor = ws2811_led_t;
-
-    enum Led: LedColor {
-        White = 0xffffff,
-        Red = 0xff0000,
-        Green = 0x00ff00,
-        Blue = 0x0000ff,
-        Yellow = 0xffff00,
-        Cyan = 0x00ffff,
-        Magenta = 0xff00ff,
-        Black = 0x000000,
-    };
-
     class IPaintSource {
     public:
         IPaintSource() = default;
@@ -110,6 +104,9 @@ namespace ohtoai::rpi {
             back = color;
         }
 
+        bool transparent() const { return transparent_; }
+        LedColor background() const { return back; }
+
         virtual void clear() {
             for (int y = 0; y < height(); ++y) {
                 for (int x = 0; x < width(); ++x) {
@@ -125,12 +122,12 @@ namespace ohtoai::rpi {
         virtual void draw(const IPaintSource& src, int x, int y, bool flip_x, bool flip_y) {
             for (int sy = 0; sy < src.height(); ++sy) {
                 int dy = flip_y ? src.height() - sy - 1 : sy;
-                if (y + dy >= height()) {
+                if (y + dy < 0 || y + dy >= height()) {
                     continue;
                 }
                 for (int sx = 0; sx < src.width(); ++sx) {
                     int dx = flip_x ? src.width() - sx - 1 : sx;
-                    if (x + dx >= width()) {
+                    if (x + dx < 0 || x + dx >= width()) {
                         continue;
                     }
                     auto src_led = src.led(sx, sy);
@@ -142,6 +139,22 @@ namespace ohtoai::rpi {
             }
         }
         
+        /// @brief blend src over this device, alpha 0 keeps the device, 255 replaces it with src
+        virtual void blend(const IPaintSource& src, int x, int y, uint8_t alpha) {
+            for (int sy = 0; sy < src.height() && y + sy < height(); ++sy) {
+                if (y + sy < 0) {
+                    continue;
+                }
+                for (int sx = 0; sx < src.width() && x + sx < width(); ++sx) {
+                    if (x + sx < 0) {
+                        continue;
+                    }
+                    auto& dst_led = led_ref(x + sx, y + sy);
+                    dst_led = mix(dst_led, src.led(sx, sy), alpha);
+                }
+            }
+        }
+
         virtual void flip(bool flip_x, bool flip_y) {
             for (int y = 0; y < height(); ++y) {
                 for (int x = 0; x < width() / 2; ++x) {
@@ -163,120 +176,106 @@ namespace ohtoai::rpi {
     class IRotatablePaintDevice: public IPaintDevice {
     public:
         IRotatablePaintDevice(int w, int h, LedColor back = Led::Black)
-            : width_(w), height_(h),
-            IPaintDevice(back),
-            logic_width_(w), logic_height_(h),
-            rotate_helper_(std::make_shared<StripRotateHelper<StripIndexType, 0, false, false>>(width_, height_)) {};
+            : IPaintDevice(back),
+            width_(w), height_(h),
+            logic_width_(w), logic_height_(h) {}
+        IRotatablePaintDevice(const IRotatablePaintDevice&) = delete;
+        IRotatablePaintDevice& operator=(const IRotatablePaintDevice&) = delete;
         virtual ~IRotatablePaintDevice() = default;
         virtual int width() const override { return logic_width_; }
         virtual int height() const override { return logic_height_; }
         virtual void set_rotate(int degree, bool flip_x = false, bool flip_y = false) {
+            // same mapping as StripRotateHelper, kept as an affine transform so index() needs no virtual call
             switch (degree) {
                 case 0:
-                    if (flip_x) {
-                        if (flip_y) {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 0, true, true>>(width_, height_);
-                        }
-                        else {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 0, true, false>>(width_, height_);
-                        }
-                    }
-                    else {
-                        if (flip_y) {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 0, false, true>>(width_, height_);
-                        }
-                        else {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 0, false, false>>(width_, height_);
-                        }
-                    }
+                    set_transform(1, 0, 0, 0, 1, 0);
                     logic_width_ = width_;
                     logic_height_ = height_;
                     break;
                 case 90:
-                    if (flip_x) {
-                        if (flip_y) {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 90, true, true>>(width_, height_);
-                        }
-                        else {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 90, true, false>>(width_, height_);
-                        }
-                    }
-                    else {
-                        if (flip_y) {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 90, false, true>>(width_, height_);
-                        }
-                        else {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 90, false, false>>(width_, height_);
-                        }
-                    }
+                    set_transform(0, 1, 0, -1, 0, height_ - 1);
                     logic_width_ = height_;
                     logic_height_ = width_;
                     break;
                 case 180:
-                    if (flip_x) {
-                        if (flip_y) {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 180, true, true>>(width_, height_);
-                        }
-                        else {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 180, true, false>>(width_, height_);
-                        }
-                    }
-                    else {
-                        if (flip_y) {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 180, false, true>>(width_, height_);
-                        }
-                        else {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 180, false, false>>(width_, height_);
-                        }
-                    }
+                    set_transform(-1, 0, width_ - 1, 0, -1, height_ - 1);
                     logic_width_ = width_;
                     logic_height_ = height_;
                     break;
                 case 270:
-                    if (flip_x) {
-                        if (flip_y) {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 270, true, true>>(width_, height_);
-                        }
-                        else {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 270, true, false>>(width_, height_);
-                        }
-                    }
-                    else {
-                        if (flip_y) {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 270, false, true>>(width_, height_);
-                        }
-                        else {
-                            rotate_helper_ = std::make_shared<StripRotateHelper<StripIndexType, 270, false, false>>(width_, height_);
-                        }
-                    }
+                    set_transform(0, -1, width_ - 1, 1, 0, 0);
                     logic_width_ = height_;
                     logic_height_ = width_;
                     break;
                 default:
                     throw std::invalid_argument("IRotatablePaintDevice::set_rotate");
             }
+            if (flip_x) {
+                set_transform(-ax_, -bx_, width_ - 1 - cx_, ay_, by_, cy_);
+            }
+            if (flip_y) {
+                set_transform(ax_, bx_, cx_, -ay_, -by_, height_ - 1 - cy_);
+            }
+        }
+
+        /// @brief led index of physical coordinates, ignoring rotation and flips
+        int physical_index(int x, int y) const {
+            return strip_index_.StripIndexType::index(x, y);
+        }
+
+        /// @brief whether logical coordinates differ from physical ones
+        bool rotated() const {
+            return !(ax_ == 1 && bx_ == 0 && cx_ == 0 && ay_ == 0 && by_ == 1 && cy_ == 0);
         }
 
         virtual int index(int x, int y) const {
-            return rotate_helper_->index(x, y);
+            return strip_index_.StripIndexType::index(ax_ * x + bx_ * y + cx_, ay_ * x + by_ * y + cy_);
         }
     protected:
-        std::shared_ptr<IStripRotateHelper<StripIndexType>> rotate_helper_ = nullptr;
         int width_ = 0;
         int height_ = 0;
         int logic_width_ = 0;
         int logic_height_ = 0;
+    private:
+        void set_transform(int ax, int bx, int cx, int ay, int by, int cy) {
+            ax_ = ax;
+            bx_ = bx;
+            cx_ = cx;
+            ay_ = ay;
+            by_ = by;
+            cy_ = cy;
+        }
+
+        StripIndexType strip_index_{width_, height_};
+        // physical x = ax * x + bx * y + cx, physical y = ay * x + by * y + cy
+        int ax_ = 1;
+        int bx_ = 0;
+        int cx_ = 0;
+        int ay_ = 0;
+        int by_ = 1;
+        int cy_ = 0;
     };
 
-    class Pixmap : public IRotatablePaintDevice<IVectorStripIndex> {
+    class Pixmap final : public IRotatablePaintDevice<IVectorStripIndex> {
     public:
-        Pixmap(int w, int h, LedColor back = Led::Black)
+        Pixmap(int w, int h, LedColor back = Led::Black,
+            std::pmr::memory_resource* resource = std::pmr::get_default_resource())
             : IRotatablePaintDevice<IVectorStripIndex>(w, h, back),
-            leds_(w * h) {}
+            storage_(w * h, resource), leds_(storage_.data()) {}
+        /// @brief Pixmap over external storage of at least w * h leds, the storage must outlive the pixmap
+        Pixmap(int w, int h, LedColor* storage, LedColor back = Led::Black)
+            : IRotatablePaintDevice<IVectorStripIndex>(w, h, back),
+            leds_(storage) {}
+        Pixmap(const Pixmap&) = delete;
+        Pixmap& operator=(const Pixmap&) = delete;
         LedColor& led_ref(int x, int y) override { return leds_[index(x, y)]; }
         const LedColor& led(int x, int y) const override { return leds_[index(x, y)]; }
+        LedColor* data() { return leds_; }
+        const LedColor* data() const { return leds_; }
+        size_t size() const { return static_cast<size_t>(width_) * height_; }
     private:
-        std::vector<LedColor> leds_;
+        std::pmr::vector<LedColor> storage_;
+        LedColor* leds_ = nullptr;
     };
 
     class SimpleAlphaGroup : public IPaintSource {
@@ -295,7 +294,7 @@ namespace ohtoai::rpi {
         LedColor back;
     };
 
-    class Digit3x5 : public SimpleAlphaGroup {
+    class Digit3x5 final : public SimpleAlphaGroup {
         friend class DigitGroup3x5;
     public:
         Digit3x5(int digit, LedColor color = Led::White, LedColor back = Led::Black) : digit(digit), SimpleAlphaGroup(color, back) {}
@@ -324,7 +323,7 @@ namespace ohtoai::rpi {
         };
     };
 
-    class Ascii4x8 : public SimpleAlphaGroup {
+    class Ascii4x8 final : public SimpleAlphaGroup {
         friend class Text4x8;
     public:
         Ascii4x8(char c, LedColor color = Led::White, LedColor back = Led::Black) : c(c), SimpleAlphaGroup(color, back) {}
@@ -481,11 +480,12 @@ namespace ohtoai::rpi {
         };
     };
 
-    class WS2811Strip : public IRotatablePaintDevice<ISnakeStripIndex>, protected ws2811_t {
+    class WS2811Strip final : public IRotatablePaintDevice<ISnakeStripIndex>, protected ws2811_t {
         enum {DMA = 10, GPIO_PIN = 18};
     public:
         WS2811Strip(int w = 8, int h = 8, LedColor back = Led::Black)
-            : IRotatablePaintDevice<ISnakeStripIndex>(w, h, back), ws2811_t() {
+            : IRotatablePaintDevice<ISnakeStripIndex>(w, h, back), ws2811_t(),
+            frame_(static_cast<size_t>(w) * h, back) {
             freq = WS2811_TARGET_FREQ;
             dmanum = DMA;
             channel[0].gpionum = GPIO_PIN;
@@ -505,33 +505,107 @@ namespace ohtoai::rpi {
 
         ~WS2811Strip() {
             spdlog::debug("WS2811Strip::~WS2811Strip {}", (void*)this);
-            ws2811_fini(this);
+            uninit();
         }
 
-        auto init() {
+        /// @brief open the hardware, on failure the strip keeps drawing into its framebuffer without output
+        ws2811_return_t init() {
             auto ret = ws2811_init(this);
+            initialized_ = ret == WS2811_SUCCESS;
             spdlog::debug("WS2811Strip::init {} {}", (void*)this, ws2811_get_return_t_str(ret));
+            return ret;
+        }
+
+        /// @brief must be called before init(), rpi_ws281x sets up its byte order there
+        void set_pixel_format(PixelFormatId format) {
+            channel[0].strip_type = strip_type_of(format);
+            output_.set_pixel_format(format);
+        }
+
+        void set_gpio(int gpio) {
+            channel[0].gpionum = gpio;
+        }
+
+        void set_dma(int dma) {
+            dmanum = dma;
         }
 
         auto wait() {
-            return ws2811_wait(this);
+            return initialized_ ? ws2811_wait(this) : WS2811_SUCCESS;
         }
 
+        /// @brief run the output stage from the framebuffer into the DMA buffer, then send it
         auto render() {
+            if (!initialized_) {
+                return WS2811_SUCCESS;
+            }
+            if (channel[0].leds) {
+                output_.process(frame_.data(), channel[0].leds, frame_.size());
+            }
+            return ws2811_render(this);
+        }
+
+        /// @brief send a frame in strip order instead of the framebuffer, such as a LayerFrame loaded from it
+        auto render(const LedColor* frame) {
+            if (!initialized_) {
+                return WS2811_SUCCESS;
+            }
+            if (channel[0].leds) {
+                output_.process(frame, channel[0].leds, frame_.size());
+            }
+            return ws2811_render(this);
+        }
+
+        /// @brief send a 16 bit frame in strip order instead of the framebuffer, see HdrPixmap::present
+        auto render(const uint16_t* hdr) {
+            if (!initialized_) {
+                return WS2811_SUCCESS;
+            }
+            if (channel[0].leds) {
+                output_.process(hdr, channel[0].leds, frame_.size());
+            }
             return ws2811_render(this);
         }
 
-        auto uninit() {
+        void uninit() {
             spdlog::debug("WS2811Strip::uninit {}", (void*)this);
-            return ws2811_fini(this);
+            // rpi_ws281x cleans up after a failed init, finishing again would touch the freed device
+            if (std::exchange(initialized_, false)) {
+                ws2811_fini(this);
+            }
         }
     public:
         LedColor& led_ref(int x, int y) override {
-            return channel[0].leds[index(x, y)];
+            changes_.fetch_add(1, std::memory_order_relaxed);
+            return frame_[index(x, y)];
         }
         const LedColor& led(int x, int y) const override {
-            return channel[0].leds[index(x, y)];
+            return frame_[index(x, y)];
+        }
+
+        void set_rotate(int degree, bool flip_x = false, bool flip_y = false) override {
+            IRotatablePaintDevice<ISnakeStripIndex>::set_rotate(degree, flip_x, flip_y);
+            changes_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// @brief framebuffer in strip order, for whole frame operations that do not care about positions
+        LedColor* data() {
+            changes_.fetch_add(1, std::memory_order_relaxed);
+            return frame_.data();
         }
+        const LedColor* data() const { return frame_.data(); }
+        size_t size() const { return frame_.size(); }
+
+        /// @brief counts writable accesses to the framebuffer and rotations, equal counts mean the frame is unchanged
+        uint64_t changes() const { return changes_.load(std::memory_order_relaxed); }
+
+        OutputPipeline& output() { return output_; }
+    private:
+        // logical framebuffer in strip order, the DMA buffer only ever holds output stage results
+        std::vector<LedColor> frame_;
+        OutputPipeline output_;
+        bool initialized_ = false;
+        std::atomic<uint64_t> changes_{0};
     };
 
     /// @brief 3x5 digits group, contains variable number of digits
@@ -547,7 +621,7 @@ namespace ohtoai::rpi {
         int height() const override { return 5; }
         const LedColor& led(int x, int y) const override {
             if (x >= 0 && x < width() && y >= 0 && y < height()) {
-                auto digit = (digits_ / (int)std::pow(10, digits_width_ - x / 3 - 1)) % 10;
+                auto digit = (digits_ / pow10[digits_width_ - x / 3 - 1]) % 10;
                 return (Digit3x5::digit3x5font[digit] & (1 << (y * 3 + 2 - x % 3))) ? color : back;
             }
             throw std::out_of_range("DigitGroup3x5::led");
@@ -569,12 +643,15 @@ namespace ohtoai::rpi {
     protected:
         int digits_;
         mutable int digits_width_;
+    private:
+        static constexpr int pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
     };
 
-    class Text4x8 : public SimpleAlphaGroup {
+    class Text4x8 final : public SimpleAlphaGroup {
     public:
-        Text4x8(const std::string& text, LedColor color = Led::White, LedColor back = Led::Black)
-            : text(text), SimpleAlphaGroup(color, back) {}
+        Text4x8(std::string_view text, LedColor color = Led::White, LedColor back = Led::Black,
+            std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : SimpleAlphaGroup(color, back), text(text, resource) {}
         int width() const override { return text.size() * 4; }
         int height() const override { return 8; }
         const LedColor& led(int x, int y) const override {
@@ -584,7 +661,7 @@ namespace ohtoai::rpi {
             throw std::out_of_range("Text4x8::led");
         }
 
-        std::string text;
+        std::pmr::string text;
     private:
     };
 
@@ -592,9 +669,10 @@ namespace ohtoai::rpi {
     public:
         Window(int w, int h, Window* parent = nullptr)
             : Window(w, h, parent, 0, 0) {}
-        Window(int w, int h, Window* parent, int x, int y)
+        Window(int w, int h, Window* parent, int x, int y,
+            std::pmr::memory_resource* resource = std::pmr::get_default_resource())
             : IRotatablePaintDevice<IVectorStripIndex>(w, h),
-            leds_(w * h) {
+            leds_(w * h, resource) {
                 spdlog::debug("Window::Window {} {}x{} @ {}, {}", (void*)this, width(), height(), x, y);
                 if (parent) {
                     parent->add(this, x, y);
@@ -671,7 +749,7 @@ namespace ohtoai::rpi {
         }
     private:
         Window* parent_ = nullptr;
-        std::vector<LedColor> leds_;
+        std::pmr::vector<LedColor> leds_;
         using PaintSourcePos = struct {int x; int y;};
         std::unordered_map<const IPaintSource*, PaintSourcePos> children_;
     };
@@ -702,9 +780,39 @@ namespace ohtoai::rpi {
         }
     };
 
+    /// @brief Blit with the same rules as IPaintDevice::draw, dispatched statically when Dst and Src are final types
+    ///
+    /// Abstract types such as IPaintSource keep their virtual calls, so rpc handlers can still pass type-erased surfaces.
+    template <typename Dst, typename Src>
+    void draw(Dst& dst, const Src& src, int x, int y, bool flip_x = false, bool flip_y = false) {
+        const int src_w = src.width();
+        const int src_h = src.height();
+        const int dst_w = dst.width();
+        const int dst_h = dst.height();
+        const bool transparent = dst.transparent();
+        const LedColor back = dst.background();
+        for (int sy = 0; sy < src_h; ++sy) {
+            int dy = y + (flip_y ? src_h - sy - 1 : sy);
+            if (dy < 0 || dy >= dst_h) {
+                continue;
+            }
+            for (int sx = 0; sx < src_w; ++sx) {
+                int dx = x + (flip_x ? src_w - sx - 1 : sx);
+                if (dx < 0 || dx >= dst_w) {
+                    continue;
+                }
+                auto src_led = src.led(sx, sy);
+                if (transparent && src_led == back) {
+                    continue;
+                }
+                dst.led_ref(dx, dy) = src_led;
+            }
+        }
+    }
+
     namespace literal {
         inline Text4x8 operator""_d(const char* text, size_t size) {
-            return Text4x8(std::string(text, size));
+            return Text4x8(std::string_view(text, size));
         }
 
         inline DigitGroup3x5 operator""_d(unsigned long long digits) {
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace ohtoai::rpi {
+    /// @brief what a scheduled task did, the render thread presents a frame when any task changed it
+    enum class TaskResult {
+        idle,
+        changed,
+        /// @brief changed the frame for the last time, the task is removed
+        done,
+    };
+
+    /// @brief Fixed rate tasks run by the render thread before a frame is presented
+    ///
+    /// Ticks missed while the thread was busy are dropped
+    /// rather than run in a burst, tasks get the current time to advance by the real elapsed time.
+    class RenderScheduler {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Task = std::function<TaskResult(Clock::time_point)>;
+
+        int every(Clock::duration period, Task task) {
+            if (period <= Clock::duration::zero()) {
+                throw std::invalid_argument("RenderScheduler::every");
+            }
+            std::lock_guard<std::recursive_mutex> lock(mutex_);
+            auto id = next_id_++;
+            tasks_.emplace(id, Entry{period, Clock::now(), std::move(task)});
+            spdlog::debug("RenderScheduler::every {} {}us", id, std::chrono::duration_cast<std::chrono::microseconds>(period).count());
+            return id;
+        }
+
+        /// @brief safe to call from inside a task
+        bool cancel(int id) {
+            std::lock_guard<std::recursive_mutex> lock(mutex_);
+            auto it = tasks_.find(id);
+            if (it == tasks_.end()) {
+                return false;
+            }
+            it->second.cancelled = true;
+            return true;
+        }
+
+        /// @brief run every due task, returns how many changed the frame
+        size_t tick(Clock::time_point now = Clock::now()) {
+            std::lock_guard<std::recursive_mutex> lock(mutex_);
+            size_t ran = 0;
+            for (auto it = tasks_.begin(); it != tasks_.end();) {
+                auto& entry = it->second;
+                if (!entry.cancelled && now >= entry.next) {
+                    entry.next += entry.period;
+                    if (entry.next <= now) {
+                        entry.next = now + entry.period;
+                    }
+                    auto result = entry.task(now);
+                    if (result != TaskResult::idle) {
+                        ++ran;
+                    }
+                    if (result == TaskResult::done) {
+                        entry.cancelled = true;
+                    }
+                }
+                it = entry.cancelled ? tasks_.erase(it) : std::next(it);
+            }
+            return ran;
+        }
+
+        size_t size() const {
+            std::lock_guard<std::recursive_mutex> lock(mutex_);
+            return tasks_.size();
+        }
+    private:
+        struct Entry {
+            Clock::duration period;
+            Clock::time_point next;
+            Task task;
+            bool cancelled = false;
+        };
+
+        // recursive so tasks can schedule or cancel others
+        mutable std::recursive_mutex mutex_;
+        std::map<int, Entry> tasks_;
+        int next_id_ = 0;
+    };
+}
@@ -0,0 +1,258 @@
+#pragma once
+
+#include "transition.hpp"
+#include <spdlog/spdlog.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ohtoai::rpi {
+    /// @brief "HH:MM" or "HH:MM:SS" to seconds since midnight, -1 for an empty string
+    inline int parse_time_of_day(const std::string& text) {
+        if (text.empty()) {
+            return -1;
+        }
+        int h = 0, m = 0, s = 0;
+        char tail = 0;
+        const int fields = std::sscanf(text.c_str(), "%d:%d:%d%c", &h, &m, &s, &tail);
+        if (fields < 2 || fields > 3 || h < 0 || h > 23 || m < 0 || m > 59 || s < 0 || s > 59) {
+            throw std::invalid_argument("parse_time_of_day " + text);
+        }
+        return h * 3600 + m * 60 + s;
+    }
+
+    /// @brief One entry of a playlist, shown for duration_ms after its transition into it started
+    struct Scene {
+        std::string name;
+        /// @brief surface or effect the scene shows
+        std::string source;
+        /// @brief drawn over the source, or over the background alone when there is no source
+        std::string text;
+        LedColor color = Led::White;
+        LedColor background = Led::Black;
+        uint32_t duration_ms = 10000;
+        TransitionKind transition = TransitionKind::crossfade;
+        Direction direction = Direction::left;
+        Easing easing = Easing::linear;
+        uint32_t transition_ms = 0;
+        /// @brief second of the day the scene interrupts the rotation at, -1 for scenes taking turns
+        int at = -1;
+    };
+
+    /// @brief Playlist of scenes switched by duration or time of day
+    ///
+    /// The scene coming up is prepared on a worker thread while the current one is showing, scheduled scenes
+    /// from lead seconds before their time. A switch then only moves the prepared frame out of its slot;
+    /// when a scene is not ready yet the current one keeps showing.
+    class Sequencer {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Frame = std::shared_ptr<const Pixmap>;
+        /// @brief builds the frame of a scene off the render thread, nullptr for scenes read live every frame
+        using Prepare = std::function<Frame(const Scene&)>;
+
+        struct Cue {
+            Scene scene;
+            Frame frame;
+        };
+
+        explicit Sequencer(Prepare prepare, int lead_seconds = 30)
+            : prepare_(std::move(prepare)), lead_(lead_seconds), worker_([this] { work(); }) {}
+
+        ~Sequencer() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            cv_.notify_all();
+            worker_.join();
+        }
+
+        Sequencer(const Sequencer&) = delete;
+        Sequencer& operator=(const Sequencer&) = delete;
+
+        void add(Scene scene) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            spdlog::debug("Sequencer::add {} {}ms at {}", scene.name, scene.duration_ms, scene.at);
+            scenes_.push_back(std::move(scene));
+            armed_.push_back(true);
+            // the successor of the current scene may have changed
+            reset();
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            scenes_.clear();
+            armed_.clear();
+            current_.reset();
+            reset();
+        }
+
+        void start() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = true;
+        }
+
+        void stop() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+            current_.reset();
+        }
+
+        /// @brief end the current scene now, the next one shows as soon as it is prepared
+        void skip() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            end_ = Clock::time_point::min();
+        }
+
+        /// @brief called by the render thread, the scene to switch to once one is due and prepared
+        std::optional<Cue> advance(Clock::time_point now, int second_of_day) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_ || scenes_.empty()) {
+                return std::nullopt;
+            }
+            for (size_t i = 0; i < scenes_.size(); ++i) {
+                const int at = scenes_[i].at;
+                if (at < 0) {
+                    continue;
+                }
+                const int until = (at - second_of_day + 86400) % 86400;
+                if (until <= lead_) {
+                    request(i);
+                }
+                // fires once when its second comes, a missed tick within the window still catches it
+                const bool window = until == 0 || until > 86400 - 2;
+                if (window && armed_[i]) {
+                    armed_[i] = false;
+                    due_ = i;
+                }
+                else if (!window) {
+                    armed_[i] = true;
+                }
+            }
+            std::optional<size_t> candidate = due_;
+            if (!candidate && (!current_ || now >= end_)) {
+                candidate = following();
+            }
+            if (!candidate) {
+                return std::nullopt;
+            }
+            auto ready = ready_.find(*candidate);
+            if (ready == ready_.end()) {
+                request(*candidate);
+                return std::nullopt;
+            }
+            Cue cue{scenes_[*candidate], std::move(ready->second)};
+            ready_.erase(ready);
+            due_.reset();
+            current_ = *candidate;
+            end_ = now + std::chrono::milliseconds(cue.scene.duration_ms);
+            if (cue.scene.at < 0) {
+                rotation_ = *candidate;
+            }
+            if (auto next = following()) {
+                request(*next);
+            }
+            spdlog::debug("Sequencer::advance {} {}", *candidate, cue.scene.name);
+            return cue;
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return scenes_.size();
+        }
+    private:
+        /// @brief next scene of the rotation, the first one when nothing took a turn yet
+        std::optional<size_t> following() const {
+            const size_t n = scenes_.size();
+            const size_t from = rotation_ ? *rotation_ + 1 : 0;
+            for (size_t k = 0; k < n; ++k) {
+                const size_t i = (from + k) % n;
+                if (scenes_[i].at < 0) {
+                    return i;
+                }
+            }
+            return std::nullopt;
+        }
+
+        void request(size_t index) {
+            if (ready_.count(index) || requested_.count(index)) {
+                return;
+            }
+            requested_.insert(index);
+            queue_.push_back(index);
+            cv_.notify_one();
+        }
+
+        /// @brief drop prepared frames, indices and successors no longer match the playlist
+        void reset() {
+            ++generation_;
+            ready_.clear();
+            requested_.clear();
+            queue_.clear();
+            due_.reset();
+            if (current_ && *current_ >= scenes_.size()) {
+                current_.reset();
+            }
+            if (rotation_ && *rotation_ >= scenes_.size()) {
+                rotation_.reset();
+            }
+        }
+
+        void work() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (;;) {
+                cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+                if (stopping_) {
+                    return;
+                }
+                const auto index = queue_.front();
+                queue_.pop_front();
+                const auto generation = generation_;
+                auto scene = scenes_[index];
+                lock.unlock();
+                Frame frame;
+                try {
+                    frame = prepare_(scene);
+                }
+                catch (const std::exception& e) {
+                    // shown live instead, the render thread skips what it cannot find
+                    spdlog::warn("Sequencer prepare {} failed: {}", scene.name, e.what());
+                }
+                lock.lock();
+                if (generation == generation_) {
+                    requested_.erase(index);
+                    ready_[index] = std::move(frame);
+                }
+            }
+        }
+
+        Prepare prepare_;
+        int lead_;
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::vector<Scene> scenes_;
+        std::vector<bool> armed_;
+        std::map<size_t, Frame> ready_;
+        std::set<size_t> requested_;
+        std::deque<size_t> queue_;
+        std::optional<size_t> current_;
+        std::optional<size_t> rotation_;
+        std::optional<size_t> due_;
+        Clock::time_point end_;
+        uint64_t generation_ = 0;
+        bool running_ = false;
+        bool stopping_ = false;
+        std::thread worker_;
+    };
+}
@@ -0,0 +1,307 @@
+#pragma once
+
+#include "render.hpp"
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace ohtoai::rpi {
+    struct SpriteImage {
+        int x;
+        int y;
+        int w;
+        int h;
+    };
+
+    /// @brief Sprite bitmaps packed in shelves into a single contiguous buffer, uploaded once and referenced by id
+    class SpriteAtlas {
+    public:
+        SpriteAtlas(int w = 256, int h = 256)
+            : width_(w), height_(h), buffer_(static_cast<size_t>(w) * h) {}
+
+        int upload(int w, int h, const std::vector<LedColor>& pixels) {
+            if (w <= 0 || h <= 0 || pixels.size() != static_cast<size_t>(w) * h) {
+                throw std::invalid_argument(fmt::format("SpriteAtlas::upload {}x{} with {} pixels", w, h, pixels.size()));
+            }
+            if (w > width_) {
+                throw std::length_error(fmt::format("SpriteAtlas::upload {}x{}, wider than the atlas", w, h));
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            // a rejected upload leaves the current shelf open for smaller images
+            int x = shelf_x_, y = shelf_y_, shelf_h = shelf_h_;
+            if (x + w > width_) {
+                x = 0;
+                y += shelf_h;
+                shelf_h = 0;
+            }
+            if (y + h > height_) {
+                throw std::length_error(fmt::format("SpriteAtlas::upload {}x{}, atlas full", w, h));
+            }
+            SpriteImage image{x, y, w, h};
+            for (int row_y = 0; row_y < h; ++row_y) {
+                std::copy_n(pixels.data() + static_cast<size_t>(row_y) * w, w, row(image, row_y));
+            }
+            shelf_x_ = x + w;
+            shelf_y_ = y;
+            shelf_h_ = std::max(shelf_h, h);
+            images_.push_back(image);
+            spdlog::debug("SpriteAtlas::upload {} {}x{} @ {}, {}", images_.size() - 1, w, h, image.x, image.y);
+            return static_cast<int>(images_.size() - 1);
+        }
+
+        SpriteImage image(int id) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (id < 0 || id >= static_cast<int>(images_.size())) {
+                throw std::out_of_range(fmt::format("SpriteAtlas::image {}", id));
+            }
+            return images_[id];
+        }
+
+        const LedColor* row(const SpriteImage& image, int y) const {
+            return buffer_.data() + static_cast<size_t>(image.y + y) * width_ + image.x;
+        }
+
+        int width() const { return width_; }
+        int height() const { return height_; }
+    private:
+        LedColor* row(const SpriteImage& image, int y) {
+            return buffer_.data() + static_cast<size_t>(image.y + y) * width_ + image.x;
+        }
+
+        mutable std::mutex mutex_;
+        int width_;
+        int height_;
+        std::vector<LedColor> buffer_;
+        std::vector<SpriteImage> images_;
+        int shelf_x_ = 0;
+        int shelf_y_ = 0;
+        int shelf_h_ = 0;
+    };
+
+    struct Sprite {
+        int image = 0;
+        int x = 0;
+        int y = 0;
+        int z = 0;
+        bool flip_x = false;
+        bool flip_y = false;
+        bool visible = true;
+        bool transparent = false;
+        LedColor key = Led::Black;
+    };
+
+    /// @brief Sprites drawn over a frame holding the content beneath them, repainting only what changed
+    ///
+    /// Nothing beneath a sprite is saved: damaged areas are restored from the base passed to compose(),
+    /// so the base may change freely as long as the frame is then loaded from it again and drawn with draw_over().
+    class SpriteLayer {
+    public:
+        explicit SpriteLayer(const SpriteAtlas& atlas) : atlas_(atlas) {}
+
+        int create(int image, int x, int y, int z = 0) {
+            atlas_.image(image);
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto id = next_id_++;
+            auto& entry = entries_[id];
+            entry.sprite.image = image;
+            entry.sprite.x = x;
+            entry.sprite.y = y;
+            entry.sprite.z = z;
+            return id;
+        }
+
+        void destroy(int id) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& entry = find(id);
+            if (entry.shown) {
+                removed_.push_back(entry.drawn);
+            }
+            entries_.erase(id);
+        }
+
+        void move(int id, int x, int y) {
+            update(id, [&](Sprite& sprite) { sprite.x = x; sprite.y = y; });
+        }
+
+        void set_image(int id, int image) {
+            atlas_.image(image);
+            update(id, [&](Sprite& sprite) { sprite.image = image; });
+        }
+
+        void set_flip(int id, bool flip_x, bool flip_y) {
+            update(id, [&](Sprite& sprite) { sprite.flip_x = flip_x; sprite.flip_y = flip_y; });
+        }
+
+        void set_z(int id, int z) {
+            update(id, [&](Sprite& sprite) { sprite.z = z; });
+        }
+
+        void set_visible(int id, bool visible) {
+            update(id, [&](Sprite& sprite) { sprite.visible = visible; });
+        }
+
+        void set_key(int id, bool transparent, LedColor key) {
+            update(id, [&](Sprite& sprite) { sprite.transparent = transparent; sprite.key = key; });
+        }
+
+        Sprite sprite(int id) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(id);
+            if (it == entries_.end()) {
+                throw std::out_of_range(fmt::format("SpriteLayer::sprite {}", id));
+            }
+            return it->second.sprite;
+        }
+
+        /// @brief draw every visible sprite over dst in z order, for a frame freshly loaded from its base
+        void draw_over(IPaintDevice& dst) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            removed_.clear();
+            for (auto& [id, entry] : entries_) {
+                settle(entry);
+            }
+            sort_visible();
+            const Rect all{0, 0, dst.width(), dst.height()};
+            for (const auto& item : order_) {
+                paint(dst, item, all);
+            }
+        }
+
+        /// @brief repaint the areas of dst that sprites changed since the last draw_over() or compose()
+        ///
+        /// dst must hold base with the sprites as they were last drawn. Each damaged area is restored from base,
+        /// then every sprite is drawn over it clipped to the area. Returns the number of leds restored.
+        size_t compose(IPaintDevice& dst, const IPaintSource& base) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            damage_.assign(removed_.begin(), removed_.end());
+            removed_.clear();
+            for (auto& [id, entry] : entries_) {
+                if (!entry.dirty) {
+                    continue;
+                }
+                if (entry.shown) {
+                    damage_.push_back(entry.drawn);
+                }
+                settle(entry);
+                if (entry.shown) {
+                    damage_.push_back(entry.drawn);
+                }
+            }
+            if (damage_.empty()) {
+                return 0;
+            }
+            sort_visible();
+            size_t restored = 0;
+            for (const auto& d : damage_) {
+                const Rect r = clip(d, {0, 0, std::min(dst.width(), base.width()), std::min(dst.height(), base.height())});
+                for (int y = r.y; y < r.y + r.h; ++y) {
+                    for (int x = r.x; x < r.x + r.w; ++x) {
+                        dst.led_ref(x, y) = base.led(x, y);
+                    }
+                }
+                restored += static_cast<size_t>(std::max(r.w, 0)) * std::max(r.h, 0);
+                for (const auto& item : order_) {
+                    paint(dst, item, r);
+                }
+            }
+            return restored;
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return entries_.size();
+        }
+    private:
+        struct Rect {
+            int x;
+            int y;
+            int w;
+            int h;
+        };
+
+        struct Entry {
+            Sprite sprite;
+            /// @brief area covered when last drawn, valid while shown
+            Rect drawn{};
+            bool shown = false;
+            bool dirty = true;
+        };
+
+        /// @brief a visible sprite with its image looked up once per frame
+        struct Item {
+            int id;
+            const Sprite* sprite;
+            SpriteImage image;
+        };
+
+        template <typename Fn>
+        void update(int id, Fn&& fn) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& entry = find(id);
+            fn(entry.sprite);
+            entry.dirty = true;
+        }
+
+        Entry& find(int id) {
+            auto it = entries_.find(id);
+            if (it == entries_.end()) {
+                throw std::out_of_range(fmt::format("SpriteLayer::find {}", id));
+            }
+            return it->second;
+        }
+
+        /// @brief record where the sprite is drawn from now on
+        void settle(Entry& entry) {
+            auto image = atlas_.image(entry.sprite.image);
+            entry.drawn = {entry.sprite.x, entry.sprite.y, image.w, image.h};
+            entry.shown = entry.sprite.visible;
+            entry.dirty = false;
+        }
+
+        void sort_visible() {
+            order_.clear();
+            for (const auto& [id, entry] : entries_) {
+                if (entry.sprite.visible) {
+                    order_.push_back({id, &entry.sprite, atlas_.image(entry.sprite.image)});
+                }
+            }
+            // ties are broken by id, std::stable_sort would need a temporary buffer every frame
+            std::sort(order_.begin(), order_.end(), [](const Item& a, const Item& b) {
+                return a.sprite->z != b.sprite->z ? a.sprite->z < b.sprite->z : a.id < b.id;
+            });
+        }
+
+        static Rect clip(const Rect& r, const Rect& bounds) {
+            const int x0 = std::max(r.x, bounds.x), y0 = std::max(r.y, bounds.y);
+            const int x1 = std::min(r.x + r.w, bounds.x + bounds.w), y1 = std::min(r.y + r.h, bounds.y + bounds.h);
+            return {x0, y0, x1 - x0, y1 - y0};
+        }
+
+        /// @brief blit the sprite image into dst, limited to the area
+        void paint(IPaintDevice& dst, const Item& item, const Rect& area) const {
+            const Sprite& sprite = *item.sprite;
+            const auto& image = item.image;
+            const Rect r = clip(clip({sprite.x, sprite.y, image.w, image.h}, area), {0, 0, dst.width(), dst.height()});
+            for (int y = r.y; y < r.y + r.h; ++y) {
+                const int sy = y - sprite.y;
+                auto src = atlas_.row(image, sprite.flip_y ? image.h - sy - 1 : sy);
+                for (int x = r.x; x < r.x + r.w; ++x) {
+                    const int sx = x - sprite.x;
+                    auto color = src[sprite.flip_x ? image.w - sx - 1 : sx];
+                    if (!sprite.transparent || color != sprite.key) {
+                        dst.led_ref(x, y) = color;
+                    }
+                }
+            }
+        }
+
+        const SpriteAtlas& atlas_;
+        mutable std::mutex mutex_;
+        std::map<int, Entry> entries_;
+        // areas of destroyed sprites, restored by the next compose
+        std::vector<Rect> removed_;
+        std::vector<Rect> damage_;
+        std::vector<Item> order_;
+        int next_id_ = 0;
+    };
+}
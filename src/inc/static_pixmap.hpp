@@ -0,0 +1,93 @@
+#pragma once
+
+#include "render.hpp"
+#include <algorithm>
+#include <array>
+#include <type_traits>
+
+namespace ohtoai::rpi {
+    /// @brief Row major led order, compile time counterpart of IVectorStripIndex
+    struct LinearLayout {
+        template <int W, int H>
+        static constexpr int index(int x, int y) {
+            return y * W + x;
+        }
+    };
+
+    /// @brief Serpentine led order, compile time counterpart of ISnakeStripIndex
+    struct SnakeLayout {
+        template <int W, int H>
+        static constexpr int index(int x, int y) {
+            return y % 2 == 0 ? y * W + x : y * W + (W - x - 1);
+        }
+    };
+
+    /// @brief Fixed size pixmap with inline storage and non-virtual accessors
+    ///
+    /// Use StaticPixmapSource to hand it to the IPaintSource based api.
+    template <int W, int H, typename Layout = LinearLayout>
+    class StaticPixmap {
+        static_assert(W > 0 && H > 0, "StaticPixmap size must be positive");
+    public:
+        constexpr StaticPixmap(LedColor back = Led::Black) : back_(back) {
+            leds_.fill(back);
+        }
+
+        static constexpr int width() { return W; }
+        static constexpr int height() { return H; }
+        static constexpr int index(int x, int y) { return Layout::template index<W, H>(x, y); }
+
+        constexpr LedColor& led_ref(int x, int y) { return leds_[index(x, y)]; }
+        constexpr const LedColor& led(int x, int y) const { return leds_[index(x, y)]; }
+
+        void set_background(LedColor color) { back_ = color; }
+        void clear() { leds_.fill(back_); }
+
+        /// @brief draw any source with width(), height() and led(x, y), dispatched statically when its type is known
+        template <typename Source>
+        void draw(const Source& src, int x, int y) {
+            const int x0 = std::max(0, -x);
+            const int y0 = std::max(0, -y);
+            const int x1 = std::min(src.width(), W - x);
+            const int y1 = std::min(src.height(), H - y);
+            for (int sy = y0; sy < y1; ++sy) {
+                for (int sx = x0; sx < x1; ++sx) {
+                    led_ref(x + sx, y + sy) = src.led(sx, sy);
+                }
+            }
+        }
+
+        /// @brief row major copy of a same sized pixmap, a plain array copy for linear layouts
+        template <typename OtherLayout>
+        void draw(const StaticPixmap<W, H, OtherLayout>& src) {
+            if constexpr (std::is_same_v<Layout, OtherLayout>) {
+                leds_ = src.leds();
+            }
+            else {
+                draw(src, 0, 0);
+            }
+        }
+
+        constexpr const std::array<LedColor, W * H>& leds() const { return leds_; }
+        constexpr LedColor* data() { return leds_.data(); }
+        constexpr const LedColor* data() const { return leds_.data(); }
+    private:
+        std::array<LedColor, W * H> leds_{};
+        LedColor back_;
+    };
+
+    /// @brief IPaintSource view of a StaticPixmap
+    template <int W, int H, typename Layout>
+    class StaticPixmapSource : public IPaintSource {
+    public:
+        explicit StaticPixmapSource(const StaticPixmap<W, H, Layout>& pixmap) : pixmap_(pixmap) {}
+        int width() const override { return W; }
+        int height() const override { return H; }
+        const LedColor& led(int x, int y) const override { return pixmap_.led(x, y); }
+    private:
+        const StaticPixmap<W, H, Layout>& pixmap_;
+    };
+
+    template <int W, int H, typename Layout>
+    StaticPixmapSource(const StaticPixmap<W, H, Layout>&) -> StaticPixmapSource<W, H, Layout>;
+}
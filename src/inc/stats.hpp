@@ -0,0 +1,60 @@
+#pragma once
+
+#include "arena.hpp"
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace ohtoai::rpi {
+    /// @brief Per-frame render counters, output stages add their own values with set()
+    class RenderStats {
+    public:
+        void frame_begin() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            frame_start_ = std::chrono::steady_clock::now();
+            allocations_start_ = AllocationCounter::count();
+        }
+
+        void frame_end() {
+            auto now = std::chrono::steady_clock::now();
+            auto allocations_end = AllocationCounter::count();
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto elapsed = now - frame_start_;
+            auto allocations = allocations_end - allocations_start_;
+            ++frames_;
+            assign("frames", static_cast<double>(frames_));
+            assign("frame_time_us", std::chrono::duration<double, std::micro>(elapsed).count());
+            assign("heap_allocations", static_cast<double>(allocations));
+            assign("arena_overflows", static_cast<double>(FrameArena::total_overflows()));
+        }
+
+        void set(std::string_view key, double value) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            assign(key, value);
+        }
+
+        std::map<std::string, double> snapshot() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return {values_.begin(), values_.end()};
+        }
+    private:
+        // transparent lookup, keys are only allocated the first time they are set
+        void assign(std::string_view key, double value) {
+            auto it = values_.find(key);
+            if (it != values_.end()) {
+                it->second = value;
+            }
+            else {
+                values_.emplace(key, value);
+            }
+        }
+
+        mutable std::mutex mutex_;
+        std::map<std::string, double, std::less<>> values_;
+        std::chrono::steady_clock::time_point frame_start_{};
+        uint64_t allocations_start_ = 0;
+        uint64_t frames_ = 0;
+    };
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ohtoai::rpi {
+    /// @brief Byte stream from a file, a FIFO or stdin, read with timeouts so reader threads can be stopped
+    ///
+    /// Opening does not wait for the writer of a FIFO, reads do.
+    class InputStream {
+    public:
+        /// @brief "-" reads stdin, anything else is opened as a file or FIFO
+        explicit InputStream(const std::string& path) {
+            fd_ = path == "-" ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY | O_NONBLOCK);
+            if (fd_ < 0) {
+                throw std::runtime_error(fmt::format("InputStream {}: {}", path, std::strerror(errno)));
+            }
+            struct stat info{};
+            regular_ = ::fstat(fd_, &info) == 0 && S_ISREG(info.st_mode);
+        }
+
+        ~InputStream() {
+            if (fd_ != STDIN_FILENO) {
+                ::close(fd_);
+            }
+        }
+
+        InputStream(const InputStream&) = delete;
+        InputStream& operator=(const InputStream&) = delete;
+
+        /// @brief a regular file can be read faster than real time, the caller paces it
+        bool regular_file() const { return regular_; }
+        bool eof() const { return eof_; }
+
+        /// @brief whatever arrives within timeout_ms, up to size bytes, 0 on timeout or at the end
+        size_t read_some(void* dst, size_t size, int timeout_ms) {
+            if (eof_ || size == 0) {
+                return 0;
+            }
+            pollfd poll_fd{fd_, POLLIN, 0};
+            if (::poll(&poll_fd, 1, timeout_ms) <= 0) {
+                return 0;
+            }
+            const auto n = ::read(fd_, dst, size);
+            if (n > 0) {
+                return static_cast<size_t>(n);
+            }
+            if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                eof_ = true;
+            }
+            return 0;
+        }
+
+        /// @brief exactly size bytes, false when the stream ended or stop was set first
+        bool read_exact(void* dst, size_t size, const std::atomic_bool& stop) {
+            auto bytes = static_cast<uint8_t*>(dst);
+            size_t have = 0;
+            while (have < size && !eof_ && !stop) {
+                have += read_some(bytes + have, size - have, 100);
+            }
+            return have == size;
+        }
+    private:
+        int fd_ = -1;
+        bool regular_ = false;
+        bool eof_ = false;
+    };
+}
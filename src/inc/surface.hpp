@@ -0,0 +1,152 @@
+#pragma once
+
+#include "render.hpp"
+#include "arena.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace ohtoai::rpi {
+    /// @brief Named offscreen pixmaps backed by a LedArena and an ObjectPool, created once and reused across frames
+    ///
+    /// Surfaces are handed out as shared_ptr, so a surface destroyed or replaced while another thread draws it
+    /// stays alive until that thread lets go; its arena block is released with the last reference. Handed out
+    /// surfaces must not outlive the registry.
+    class SurfaceRegistry {
+    public:
+        explicit SurfaceRegistry(size_t capacity = 64 * 1024, size_t max_surfaces = 64)
+            : arena_(capacity), pixmaps_(max_surfaces) {}
+
+        std::shared_ptr<Pixmap> create(const std::string& name, int w, int h, LedColor back = Led::Black) {
+            if (w <= 0 || h <= 0) {
+                throw std::invalid_argument(fmt::format("SurfaceRegistry::create {} {}x{}", name, w, h));
+            }
+            // built before the registry is touched, a failed allocation leaves the existing surface in place
+            Pixmap* raw = nullptr;
+            {
+                std::lock_guard<std::mutex> storage_lock(storage_mutex_);
+                auto storage = arena_.allocate(static_cast<size_t>(w) * h);
+                try {
+                    raw = pixmaps_.create(w, h, storage, back);
+                }
+                catch (...) {
+                    arena_.deallocate(storage, static_cast<size_t>(w) * h);
+                    throw;
+                }
+            }
+            // outside the storage lock, the deleter takes it when the control block cannot be allocated
+            std::shared_ptr<Pixmap> pixmap(raw, [this](Pixmap* released) { release(released); });
+            pixmap->clear();
+            // the replaced surface goes back to the arena once nobody draws it anymore, outside the lock
+            std::shared_ptr<Pixmap> replaced;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto [it, inserted] = surfaces_.try_emplace(name, pixmap);
+                if (!inserted) {
+                    replaced = std::exchange(it->second, pixmap);
+                }
+            }
+            spdlog::debug("SurfaceRegistry::create {} {}x{}, arena {}/{}", name, w, h, arena_.used(), arena_.capacity());
+            return pixmap;
+        }
+
+        bool destroy(const std::string& name) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (surfaces_.erase(name) == 0) {
+                return false;
+            }
+            spdlog::debug("SurfaceRegistry::destroy {}, arena {}/{}", name, arena_.used(), arena_.capacity());
+            return true;
+        }
+
+        std::shared_ptr<Pixmap> get(const std::string& name) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = surfaces_.find(name);
+            if (it == surfaces_.end()) {
+                throw std::out_of_range(fmt::format("SurfaceRegistry::get {}", name));
+            }
+            return it->second;
+        }
+
+        bool contains(const std::string& name) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return surfaces_.count(name) != 0;
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return surfaces_.size();
+        }
+
+        const LedArena& arena() const { return arena_; }
+    private:
+        /// @brief deleter of the handed out pointers, runs on whichever thread drops the last reference
+        void release(Pixmap* pixmap) {
+            std::lock_guard<std::mutex> lock(storage_mutex_);
+            arena_.deallocate(pixmap->data(), pixmap->size());
+            pixmaps_.destroy(pixmap);
+        }
+
+        mutable std::mutex mutex_;
+        // arena and pool, apart from mutex_ since the last reference may drop under it
+        std::mutex storage_mutex_;
+        LedArena arena_;
+        ObjectPool<Pixmap> pixmaps_;
+        // declared last, so remaining surfaces are released while the arena and pool still exist
+        std::unordered_map<std::string, std::shared_ptr<Pixmap>> surfaces_;
+    };
+
+    /// @brief Named surfaces of a type outside the IPaintDevice family, constructed from width, height and extra arguments
+    ///
+    /// Shared like SurfaceRegistry, so a surface replaced or destroyed while it is drawn lives until the draw ends.
+    template <typename Surface>
+    class NamedSurfaceRegistry {
+    public:
+        template <typename... Args>
+        std::shared_ptr<Surface> create(const std::string& name, int w, int h, Args&&... args) {
+            if (w <= 0 || h <= 0) {
+                throw std::invalid_argument(fmt::format("NamedSurfaceRegistry::create {} {}x{}", name, w, h));
+            }
+            // built before the lock, so a throwing constructor leaves the registry untouched
+            auto surface = std::make_shared<Surface>(w, h, std::forward<Args>(args)...);
+            std::shared_ptr<Surface> replaced;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto [it, inserted] = surfaces_.try_emplace(name, surface);
+                if (!inserted) {
+                    replaced = std::exchange(it->second, surface);
+                }
+            }
+            spdlog::debug("NamedSurfaceRegistry::create {} {}x{}", name, w, h);
+            return surface;
+        }
+
+        bool destroy(const std::string& name) {
+            std::shared_ptr<Surface> surface;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = surfaces_.find(name);
+                if (it == surfaces_.end()) {
+                    return false;
+                }
+                surface = std::move(it->second);
+                surfaces_.erase(it);
+            }
+            return true;
+        }
+
+        std::shared_ptr<Surface> get(const std::string& name) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = surfaces_.find(name);
+            if (it == surfaces_.end()) {
+                throw std::out_of_range(fmt::format("NamedSurfaceRegistry::get {}", name));
+            }
+            return it->second;
+        }
+    private:
+        mutable std::mutex mutex_;
+        std::unordered_map<std::string, std::shared_ptr<Surface>> surfaces_;
+    };
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "render.hpp"
+#include "animation.hpp"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ohtoai::rpi {
+    enum class TransitionKind {
+        crossfade,
+        wipe,
+        slide,
+        dissolve,
+    };
+
+    inline TransitionKind transition_from_string(const std::string& name) {
+        if (name.empty() || name == "crossfade") return TransitionKind::crossfade;
+        if (name == "wipe") return TransitionKind::wipe;
+        if (name == "slide") return TransitionKind::slide;
+        if (name == "dissolve") return TransitionKind::dissolve;
+        throw std::invalid_argument("transition_from_string " + name);
+    }
+
+    /// @brief where the edge of a wipe or the content of a slide moves to
+    enum class Direction {
+        left,
+        right,
+        up,
+        down,
+    };
+
+    inline Direction direction_from_string(const std::string& name) {
+        if (name.empty() || name == "left") return Direction::left;
+        if (name == "right") return Direction::right;
+        if (name == "up") return Direction::up;
+        if (name == "down") return Direction::down;
+        throw std::invalid_argument("direction_from_string " + name);
+    }
+
+    /// @brief mix two spans with one weight, the weights are set up once instead of per led
+    inline void mix(const LedColor* a, const LedColor* b, LedColor* dst, size_t n, uint8_t t) {
+        const uint32_t ta = 256 - t - (t == 255);
+        const uint32_t tb = t + (t == 255);
+        for (size_t i = 0; i < n; ++i) {
+            const uint32_t rb = ((a[i] & 0x00ff00ff) * ta + (b[i] & 0x00ff00ff) * tb) >> 8;
+            const uint32_t wg = ((a[i] >> 8) & 0x00ff00ff) * ta + ((b[i] >> 8) & 0x00ff00ff) * tb;
+            dst[i] = (rb & 0x00ff00ff) | (wg & 0xff00ff00);
+        }
+    }
+
+    /// @brief b where rank is below threshold, a elsewhere, without branches
+    inline void select(const LedColor* a, const LedColor* b, const uint32_t* ranks, uint32_t threshold, LedColor* dst, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            const uint32_t mask = 0u - static_cast<uint32_t>(ranks[i] < threshold);
+            dst[i] = (b[i] & mask) | (a[i] & ~mask);
+        }
+    }
+
+    /// @brief Blended frames from a snapshot of the current content to a live source over a duration
+    ///
+    /// The snapshot is taken when the transition is created, the next source is read every frame so effects keep moving.
+    /// Work happens on whole rows: sources are fetched into row buffers, blended by the span kernels and written back.
+    class Transition {
+    public:
+        Transition(TransitionKind kind, const IPaintSource& from, uint32_t duration_ms,
+            Direction direction = Direction::left, Easing easing = Easing::linear, uint32_t seed = 0x2545f491)
+            : kind_(kind), direction_(direction), easing_(easing), duration_(duration_ms),
+            width_(from.width()), height_(from.height()), from_(width_, height_),
+            next_(width_), out_(width_) {
+            if (width_ <= 0 || height_ <= 0) {
+                throw std::invalid_argument(fmt::format("Transition {}x{}", width_, height_));
+            }
+            for (int y = 0; y < height_; ++y) {
+                for (int x = 0; x < width_; ++x) {
+                    from_.led_ref(x, y) = from.led(x, y);
+                }
+            }
+            if (kind_ == TransitionKind::dissolve) {
+                // every led gets its own moment to switch, a shuffled permutation keeps the count exact
+                ranks_.resize(from_.size());
+                std::iota(ranks_.begin(), ranks_.end(), 0u);
+                uint32_t state = seed ? seed : 1;
+                for (size_t i = ranks_.size(); i > 1; --i) {
+                    state ^= state << 13;
+                    state ^= state >> 17;
+                    state ^= state << 5;
+                    std::swap(ranks_[i - 1], ranks_[static_cast<uint64_t>(state) * i >> 32]);
+                }
+            }
+        }
+
+        /// @brief eased progress in [0, 1] at ms after the start
+        float progress(uint32_t ms) const {
+            return duration_ == 0 ? 1.0f : ease(easing_, std::min(1.0f, static_cast<float>(ms) / duration_));
+        }
+
+        /// @brief paint the frame at ms after the start, false once the final frame has been painted
+        bool render(IPaintDevice& dst, const IPaintSource& to, uint32_t ms) {
+            render_at(dst, to, progress(ms));
+            return ms < duration_;
+        }
+
+        void render_at(IPaintDevice& dst, const IPaintSource& to, float progress) {
+            const float p = std::clamp(progress, 0.0f, 1.0f);
+            const int w = std::min(width_, dst.width());
+            const int h = std::min(height_, dst.height());
+            const LedColor back = dst.background();
+            for (int y = 0; y < h; ++y) {
+                const LedColor* row = nullptr;
+                switch (kind_) {
+                    case TransitionKind::crossfade:
+                        fetch(to, y, back);
+                        mix(from_row(y), next_.data(), out_.data(), w, static_cast<uint8_t>(p * 255));
+                        row = out_.data();
+                        break;
+                    case TransitionKind::wipe:
+                        row = wipe(to, y, p, back);
+                        break;
+                    case TransitionKind::slide:
+                        row = slide(to, y, p, back);
+                        break;
+                    case TransitionKind::dissolve:
+                        fetch(to, y, back);
+                        select(from_row(y), next_.data(), ranks_.data() + static_cast<size_t>(y) * width_,
+                            static_cast<uint32_t>(p * ranks_.size()), out_.data(), w);
+                        row = out_.data();
+                        break;
+                }
+                for (int x = 0; x < w; ++x) {
+                    dst.led_ref(x, y) = row[x];
+                }
+            }
+        }
+
+        uint32_t duration() const { return duration_; }
+    private:
+        const LedColor* from_row(int y) const { return from_.data() + static_cast<size_t>(y) * width_; }
+
+        /// @brief row y of the next source into next_, back outside of it
+        void fetch(const IPaintSource& to, int y, LedColor back) {
+            const int w = y >= 0 && y < to.height() ? std::min(width_, to.width()) : 0;
+            for (int x = 0; x < w; ++x) {
+                next_[x] = to.led(x, y);
+            }
+            std::fill(next_.begin() + w, next_.end(), back);
+        }
+
+        const LedColor* wipe(const IPaintSource& to, int y, float p, LedColor back) {
+            const bool horizontal = direction_ == Direction::left || direction_ == Direction::right;
+            const int extent = horizontal ? width_ : height_;
+            const int covered = static_cast<int>(p * extent + 0.5f);
+            // the edge enters from the side opposite to where it moves
+            const int begin = direction_ == Direction::left || direction_ == Direction::up ? extent - covered : 0;
+            const int end = begin + covered;
+            if (!horizontal) {
+                if (y < begin || y >= end) {
+                    return from_row(y);
+                }
+                fetch(to, y, back);
+                return next_.data();
+            }
+            fetch(to, y, back);
+            std::copy(from_row(y), from_row(y) + width_, out_.begin());
+            std::copy(next_.begin() + begin, next_.begin() + end, out_.begin() + begin);
+            return out_.data();
+        }
+
+        const LedColor* slide(const IPaintSource& to, int y, float p, LedColor back) {
+            const bool horizontal = direction_ == Direction::left || direction_ == Direction::right;
+            const int extent = horizontal ? width_ : height_;
+            const int offset = static_cast<int>(p * extent + 0.5f);
+            if (!horizontal) {
+                // pick the source row that lands on y
+                const int shifted = direction_ == Direction::up ? y + offset : y - offset;
+                if (shifted >= 0 && shifted < height_) {
+                    return from_row(shifted);
+                }
+                fetch(to, direction_ == Direction::up ? shifted - height_ : shifted + height_, back);
+                return next_.data();
+            }
+            fetch(to, y, back);
+            const LedColor* from = from_row(y);
+            if (direction_ == Direction::left) {
+                std::copy(from + offset, from + width_, out_.begin());
+                std::copy(next_.begin(), next_.begin() + offset, out_.begin() + (width_ - offset));
+            }
+            else {
+                std::copy(next_.begin() + (width_ - offset), next_.end(), out_.begin());
+                std::copy(from, from + (width_ - offset), out_.begin() + offset);
+            }
+            return out_.data();
+        }
+
+        TransitionKind kind_;
+        Direction direction_;
+        Easing easing_;
+        uint32_t duration_;
+        int width_;
+        int height_;
+        Pixmap from_;
+        std::vector<LedColor> next_;
+        std::vector<LedColor> out_;
+        std::vector<uint32_t> ranks_;
+    };
+}
@@ -0,0 +1,317 @@
+#pragma once
+
+#include "effect.hpp"
+#include "stream.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ohtoai::rpi {
+    enum class VideoPixelFormat {
+        rgb24,
+        /// @brief planar Y, then U and V at half resolution in both directions
+        yuv420p,
+    };
+
+    inline VideoPixelFormat video_pixel_format_from_string(const std::string& name) {
+        if (name.empty() || name == "rgb24") return VideoPixelFormat::rgb24;
+        if (name == "yuv420p") return VideoPixelFormat::yuv420p;
+        throw std::invalid_argument("video_pixel_format_from_string " + name);
+    }
+
+    /// @brief raw frames carry no header, the sender states what it sends
+    struct VideoFormat {
+        int width = 0;
+        int height = 0;
+        VideoPixelFormat pixel = VideoPixelFormat::rgb24;
+        double fps = 25;
+
+        size_t frame_bytes() const {
+            const size_t luma = static_cast<size_t>(width) * height;
+            if (pixel == VideoPixelFormat::rgb24) {
+                return luma * 3;
+            }
+            return luma + 2 * static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+        }
+    };
+
+    /// @brief one row of planar yuv420p to packed y, u, v bytes, u and v hold half as many samples as y
+    inline void interleave_yuv(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* yuv, size_t w) {
+        for (size_t i = 0; i < w; ++i) {
+            yuv[i * 3 + 0] = y[i];
+            yuv[i * 3 + 1] = u[i >> 1];
+            yuv[i * 3 + 2] = v[i >> 1];
+        }
+    }
+
+    /// @brief BT.601 limited range, yuv packed like rgb in a LedColor with y in the red byte
+    inline void yuv_to_rgb(const LedColor* yuv, LedColor* rgb, size_t n) {
+        auto clamp8 = [](int x) { return static_cast<uint32_t>(x < 0 ? 0 : x > 255 ? 255 : x); };
+        for (size_t i = 0; i < n; ++i) {
+            // 8 bit fixed point coefficients, with the 16 luma offset and the rounding folded in
+            const int c = 298 * static_cast<int>(yuv[i] >> 16 & 0xff) - 298 * 16 + 128;
+            const int d = static_cast<int>(yuv[i] >> 8 & 0xff) - 128;
+            const int e = static_cast<int>(yuv[i] & 0xff) - 128;
+            rgb[i] = clamp8((c + 409 * e) >> 8) << 16 | clamp8((c - 100 * d - 208 * e) >> 8) << 8 | clamp8((c + 516 * d) >> 8);
+        }
+    }
+
+    /// @brief Area averaging resampler from packed 3 byte rows to a LedColor frame, exact in integers
+    ///
+    /// Source pixel i covers [i * dst, (i + 1) * dst) and output pixel j covers [j * src, (j + 1) * src) on a common
+    /// grid, so every overlap is a whole number and the weights of an output pixel add up to src exactly.
+    /// Rows are first summed vertically into a few open accumulator rows, a straight multiply add over bytes,
+    /// then reduced horizontally once per finished output row.
+    class AreaScaler {
+    public:
+        /// @brief largest source frame whose weighted sums, 255 per channel times the area, fit in 32 bits
+        static constexpr uint64_t max_source_pixels = 0xffffffffu / 255;
+
+        AreaScaler(int src_w, int src_h, int dst_w, int dst_h)
+            : src_w_(src_w), src_h_(src_h), dst_w_(dst_w), dst_h_(dst_h) {
+            if (src_w <= 0 || src_h <= 0 || dst_w <= 0 || dst_h <= 0
+                || static_cast<uint64_t>(src_w) * static_cast<uint64_t>(src_h) > max_source_pixels) {
+                throw std::invalid_argument(fmt::format("AreaScaler {}x{} to {}x{}", src_w, src_h, dst_w, dst_h));
+            }
+            for (int j = 0; j < dst_w; ++j) {
+                starts_.push_back(taps_.size());
+                const int64_t lo = static_cast<int64_t>(j) * src_w, hi = lo + src_w;
+                for (int64_t i = lo / dst_w; i * dst_w < hi; ++i) {
+                    const int64_t overlap = std::min(hi, (i + 1) * dst_w) - std::max(lo, i * dst_w);
+                    taps_.push_back({static_cast<uint32_t>(i), static_cast<uint32_t>(overlap)});
+                }
+            }
+            starts_.push_back(taps_.size());
+            // output rows open at the same time: two when shrinking, more when enlarging
+            slots_ = static_cast<size_t>(std::min(dst_h, dst_h / src_h + 2));
+            rows_.assign(slots_ * src_w * 3, 0);
+            // 0.32 fixed point reciprocal of the total weight
+            inverse_ = ((uint64_t{1} << 32) + static_cast<uint64_t>(src_w) * src_h - 1) / (static_cast<uint64_t>(src_w) * src_h);
+        }
+
+        /// @brief start a frame written to dst, dst_w x dst_h row major
+        void begin(LedColor* dst) {
+            dst_ = dst;
+            row_ = 0;
+            std::fill(rows_.begin(), rows_.end(), 0);
+        }
+
+        /// @brief add the next source row, output rows are written as soon as they are complete
+        void push_row(const uint8_t* rgb) {
+            const int64_t lo = static_cast<int64_t>(row_) * dst_h_, hi = lo + dst_h_;
+            const size_t n = static_cast<size_t>(src_w_) * 3;
+            for (int64_t dy = lo / src_h_; dy < dst_h_ && dy * src_h_ < hi; ++dy) {
+                const int64_t top = dy * src_h_, bottom = top + src_h_;
+                const auto weight = static_cast<uint32_t>(std::min(hi, bottom) - std::max(lo, top));
+                uint32_t* acc = rows_.data() + static_cast<size_t>(dy) % slots_ * n;
+                for (size_t i = 0; i < n; ++i) {
+                    acc[i] += rgb[i] * weight;
+                }
+                if (bottom <= hi) {
+                    finish(static_cast<int>(dy), acc);
+                }
+            }
+            ++row_;
+        }
+
+        int width() const { return dst_w_; }
+        int height() const { return dst_h_; }
+    private:
+        struct Tap {
+            uint32_t src;
+            uint32_t weight;
+        };
+
+        void finish(int dy, uint32_t* acc) {
+            LedColor* out = dst_ + static_cast<size_t>(dy) * dst_w_;
+            for (int j = 0; j < dst_w_; ++j) {
+                uint32_t r = 0, g = 0, b = 0;
+                for (size_t k = starts_[j]; k < starts_[j + 1]; ++k) {
+                    const uint32_t* p = acc + taps_[k].src * 3;
+                    r += p[0] * taps_[k].weight;
+                    g += p[1] * taps_[k].weight;
+                    b += p[2] * taps_[k].weight;
+                }
+                out[j] = static_cast<uint32_t>((r * inverse_) >> 32) << 16 | static_cast<uint32_t>((g * inverse_) >> 32) << 8
+                    | static_cast<uint32_t>((b * inverse_) >> 32);
+            }
+            std::fill_n(acc, static_cast<size_t>(src_w_) * 3, 0);
+        }
+
+        int src_w_;
+        int src_h_;
+        int dst_w_;
+        int dst_h_;
+        std::vector<Tap> taps_;
+        std::vector<size_t> starts_;
+        std::vector<uint32_t> rows_;
+        size_t slots_ = 1;
+        uint64_t inverse_ = 0;
+        LedColor* dst_ = nullptr;
+        int row_ = 0;
+    };
+
+    /// @brief Raw video decoded and scaled on a reader thread into a bounded ring of panel sized frames
+    ///
+    /// The ring is single producer, single consumer and lock free. A full ring makes the reader wait, which paces
+    /// files and pipes alike; the render thread takes the newest frame that is due and drops the older ones, so
+    /// a slow consumer skips frames instead of falling behind. Timestamps are frame index / fps.
+    class VideoStream {
+    public:
+        /// fps is clamped into this range so frame index * 1000 / fps stays well inside uint64
+        static constexpr double min_fps = 0.01;
+        static constexpr double max_fps = 1000;
+
+        VideoStream(const std::string& path, VideoFormat format, int width, int height, size_t capacity = 4)
+            : stream_(path), format_(format), scaler_(format.width, format.height, width, height),
+            slots_(std::max<size_t>(capacity, 2)), raw_(format.frame_bytes()), row_(static_cast<size_t>(format.width) * 3) {
+            if (!(format.fps > 0)) {
+                throw std::invalid_argument(fmt::format("VideoStream {} fps", format.fps));
+            }
+            format_.fps = std::clamp(format.fps, min_fps, max_fps);
+            for (auto& slot : slots_) {
+                slot.leds.resize(static_cast<size_t>(width) * height);
+            }
+            thread_ = std::thread([this] { run(); });
+        }
+
+        ~VideoStream() {
+            stop_ = true;
+            thread_.join();
+        }
+
+        VideoStream(const VideoStream&) = delete;
+        VideoStream& operator=(const VideoStream&) = delete;
+
+        /// @brief copy the newest frame due at t ms of stream time into dst, false when no new frame is due
+        bool frame_at(uint32_t t, LedColor* dst) {
+            const size_t head = head_.load(std::memory_order_relaxed);
+            const size_t tail = tail_.load(std::memory_order_acquire);
+            size_t pick = head;
+            while (pick < tail && slot(pick).pts_ms <= t) {
+                ++pick;
+            }
+            if (pick == head) {
+                return false;
+            }
+            dropped_ += pick - 1 - head;
+            const auto& frame = slot(pick - 1);
+            std::copy(frame.leds.begin(), frame.leds.end(), dst);
+            head_.store(pick, std::memory_order_release);
+            return true;
+        }
+
+        /// @brief frames decoded but never shown because a newer one was due
+        uint64_t dropped() const { return dropped_; }
+        uint64_t decoded() const { return decoded_; }
+        /// @brief the input ended and every frame was taken
+        bool finished() const { return done_ && head_.load() == tail_.load(); }
+    private:
+        struct Frame {
+            uint32_t pts_ms = 0;
+            std::vector<LedColor> leds;
+        };
+
+        Frame& slot(size_t index) { return slots_[index % slots_.size()]; }
+
+        void run() {
+            try {
+                for (uint64_t index = 0; !stop_; ++index) {
+                    const size_t tail = tail_.load(std::memory_order_relaxed);
+                    while (!stop_ && tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                    }
+                    if (stop_ || !stream_.read_exact(raw_.data(), raw_.size(), stop_)) {
+                        break;
+                    }
+                    auto& frame = slot(tail);
+                    // wraps with the uint32 effect clock
+                    frame.pts_ms = static_cast<uint32_t>(static_cast<uint64_t>(index * 1000 / format_.fps));
+                    decode(frame.leds.data());
+                    ++decoded_;
+                    tail_.store(tail + 1, std::memory_order_release);
+                }
+            }
+            catch (const std::exception& e) {
+                spdlog::warn("VideoStream stopped: {}", e.what());
+            }
+            spdlog::debug("VideoStream finished after {} frames", decoded_.load());
+            done_ = true;
+        }
+
+        void decode(LedColor* dst) {
+            const int w = format_.width, h = format_.height;
+            scaler_.begin(dst);
+            if (format_.pixel == VideoPixelFormat::rgb24) {
+                for (int y = 0; y < h; ++y) {
+                    scaler_.push_row(raw_.data() + static_cast<size_t>(y) * w * 3);
+                }
+                return;
+            }
+            // averaging is linear, so yuv is scaled first and only the panel sized result is converted
+            const size_t chroma_w = static_cast<size_t>((w + 1) / 2);
+            const uint8_t* luma = raw_.data();
+            const uint8_t* u = luma + static_cast<size_t>(w) * h;
+            const uint8_t* v = u + chroma_w * ((h + 1) / 2);
+            for (int y = 0; y < h; ++y) {
+                const size_t chroma = (y / 2) * chroma_w;
+                interleave_yuv(luma + static_cast<size_t>(y) * w, u + chroma, v + chroma, row_.data(), w);
+                scaler_.push_row(row_.data());
+            }
+            yuv_to_rgb(dst, dst, static_cast<size_t>(scaler_.width()) * scaler_.height());
+        }
+
+        InputStream stream_;
+        VideoFormat format_;
+        AreaScaler scaler_;
+        std::vector<Frame> slots_;
+        std::vector<uint8_t> raw_;
+        std::vector<uint8_t> row_;
+        // monotonic indices, the slot is index % capacity
+        std::atomic<size_t> head_ = 0;
+        std::atomic<size_t> tail_ = 0;
+        std::atomic<uint64_t> decoded_ = 0;
+        uint64_t dropped_ = 0;
+        std::atomic_bool done_ = false;
+        std::atomic_bool stop_ = false;
+        std::thread thread_;
+    };
+
+    /// @brief VideoStream as an effect, played on the effect clock so speed changes the playback rate
+    ///
+    /// offset is added to the stream time in ms, positive values show frames earlier to line video up with audio.
+    class VideoEffect final : public Effect {
+    public:
+        /// @brief one day either way
+        static constexpr double max_offset = 86400000;
+
+        VideoEffect(int w, int h, const std::string& path, VideoFormat format, size_t capacity = 4)
+            : Effect(w, h), stream_(path, format, w, h, capacity) {}
+
+        const VideoStream& stream() const { return stream_; }
+    protected:
+        void apply_param(const std::string& key, double value) override {
+            if (key == "offset") {
+                offset_ = static_cast<int32_t>(std::clamp(value, -max_offset, max_offset));
+            }
+            else {
+                Effect::apply_param(key, value);
+            }
+        }
+
+        void render(uint32_t t) override {
+            const int64_t at = static_cast<int64_t>(t) + offset_;
+            if (at >= 0) {
+                stream_.frame_at(static_cast<uint32_t>(at), frame_.data());
+            }
+        }
+    private:
+        VideoStream stream_;
+        int32_t offset_ = 0;
+    };
+}
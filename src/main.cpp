@@ -1,7 +1,30 @@
 #include "render.hpp"
+#include "surface.hpp"
+#include "sprite.hpp"
+#include "stats.hpp"
+#include "hdr.hpp"
+#include "config.hpp"
+#include "palette.hpp"
+#include "color_space.hpp"
+#include "packed.hpp"
+#include "fade.hpp"
+#include "filter.hpp"
+#include "scheduler.hpp"
+#include "animation.hpp"
+#include "layer.hpp"
+#include "effects.hpp"
+#include "transition.hpp"
+#include "sequencer.hpp"
+#include "audio.hpp"
+#include "video.hpp"
+#include <argparse/argparse.hpp>
 #include <rest_rpc.hpp>
 
-int main() {
+#ifdef COUNT_ALLOCATIONS
+#include "counting_new.hpp"
+#endif
+
+int main(int argc, char** argv) {
 #ifndef RASPBERRY_PI
 	spdlog::critical("This program is only for Raspberry Pi.");
 	return 0;
@@ -13,25 +36,385 @@ int main() {
 	using ohtoai::rpi::Window;
 	using ohtoai::rpi::WS2811Strip;
 	using ohtoai::rpi::Pixmap;
+	using ohtoai::rpi::IPaintDevice;
+	using ohtoai::rpi::SurfaceRegistry;
+	using ohtoai::rpi::SpriteAtlas;
+	using ohtoai::rpi::SpriteLayer;
+	using ohtoai::rpi::FrameArena;
+	using ohtoai::rpi::RenderStats;
+	using ohtoai::rpi::HdrPixmap;
+	using ohtoai::rpi::StripConfig;
+	using ohtoai::rpi::IndexedSurfaceRegistry;
+	using ohtoai::rpi::PackedSurfaceRegistry;
+	using ohtoai::rpi::RenderScheduler;
+	using ohtoai::rpi::Trail;
+	using ohtoai::rpi::AnimationEngine;
+	using ohtoai::rpi::TaskResult;
+	using ohtoai::rpi::EffectRegistry;
 	std::atomic_bool auto_render = false;
 
-	WS2811Strip strip(16, 32);
-	strip.init();
-	rest_rpc::rpc_service::rpc_server server(9000, std::thread::hardware_concurrency());
+	argparse::ArgumentParser program("ws2812strip");
+	program.add_argument("-c", "--config")
+		.help("yaml configuration file")
+		.default_value(std::string(""));
+	program.parse_args(argc, argv);
+	auto config_path = program.get<std::string>("--config");
+	auto config = config_path.empty() ? StripConfig{} : StripConfig::load(config_path);
+
+	WS2811Strip strip(config.width, config.height);
+	strip.set_gpio(config.gpio);
+	strip.set_dma(config.dma);
+	strip.set_pixel_format(ohtoai::rpi::pixel_format_from_string(config.pixel_format));
+	strip.output().set_brightness(static_cast<uint8_t>(std::clamp(config.brightness, 0, 255)));
+	strip.output().set_gamma(config.gamma);
+	strip.output().set_power_model(config.led_milliamps, config.led_milliamps, config.led_milliamps,
+		config.led_milliamps, config.led_idle_milliamps, config.voltage);
+	strip.output().set_power_budget(static_cast<uint32_t>(std::max(config.power_budget_ma, 0)));
+	if (auto ret = strip.init(); ret != WS2811_SUCCESS)
+		spdlog::error("strip output unavailable: {}", ws2811_get_return_t_str(ret));
+	// calibration is rebuilt from the panel list whenever a matrix changes
+	std::mutex panels_mutex;
+	auto panels = config.panels;
+	auto apply_calibration = [&]{
+		ohtoai::rpi::PanelCalibration calibration;
+		for (const auto& panel : panels) {
+			std::vector<int> leds;
+			for (int y = std::max(panel.y, 0); y < std::min(panel.y + panel.height, config.height); ++y)
+				for (int x = std::max(panel.x, 0); x < std::min(panel.x + panel.width, config.width); ++x)
+					leds.push_back(strip.physical_index(x, y));
+			calibration.add(ohtoai::rpi::ColorCorrection(panel.matrix, panel.offset), std::move(leds));
+		}
+		strip.output().set_calibration(std::move(calibration));
+	};
+	apply_calibration();
+	SurfaceRegistry surfaces;
+	IndexedSurfaceRegistry indexed;
+	PackedSurfaceRegistry packed;
+	SpriteAtlas atlas;
+	SpriteLayer sprites(atlas);
+	RenderStats stats;
+	// while enabled, frames are presented from the 16 bit layer instead of the strip framebuffer
+	std::mutex hdr_mutex;
+	std::unique_ptr<HdrPixmap> hdr;
+	auto with_hdr = [&](auto&& fn) {
+		std::lock_guard<std::mutex> lock(hdr_mutex);
+		if (!hdr)
+			throw std::logic_error("hdr layer is not enabled");
+		return fn(*hdr);
+	};
+	// empty surface name refers to the strip itself, surfaces stay alive while the pointer is held
+	auto target = [&](const std::string& name) -> std::shared_ptr<IPaintDevice> {
+		if (name.empty())
+			return std::shared_ptr<IPaintDevice>(std::shared_ptr<IPaintDevice>(), &strip);
+		return surfaces.get(name);
+	};
+	EffectRegistry effects;
+	// analysed on its own thread, spectrum effects read the latest block without locking
+	ohtoai::rpi::AudioInput audio;
+	// effects are read only sources, read under the registry lock; everything else falls back to the surfaces
+	auto with_source = [&](const std::string& name, auto&& fn) {
+		if (!name.empty() && effects.contains(name))
+			return effects.with(name, [&](const ohtoai::rpi::Effect& effect) { return fn(effect); });
+		return fn(static_cast<const ohtoai::rpi::IPaintSource&>(*target(name)));
+	};
+	// surfaces composed onto their target every frame, positions usually driven by animations
+	std::mutex layers_mutex;
+	std::map<std::string, ohtoai::rpi::Layer> layers;
+	// layers and sprites go into copies of their targets, so the strip and surfaces keep only what clients drew
+	ohtoai::rpi::LayerFrame<ohtoai::rpi::WS2811Strip> strip_frame;
+	struct SurfaceFrame {
+		std::shared_ptr<ohtoai::rpi::Pixmap> surface;
+		ohtoai::rpi::LayerFrame<ohtoai::rpi::Pixmap> frame;
+	};
+	std::map<std::string, SurfaceFrame> surface_frames;
+	// returns whether strip_frame holds layers and should be shown instead of the framebuffer
+	auto compose_layers = [&]{
+		std::lock_guard<std::mutex> lock(layers_mutex);
+		bool on_strip = false;
+		auto frame_of = [&](const std::string& name) -> IPaintDevice& {
+			if (name.empty()) {
+				if (!on_strip)
+					strip_frame.load(strip);
+				on_strip = true;
+				return strip_frame;
+			}
+			auto& entry = surface_frames[name];
+			if (!entry.surface) {
+				entry.surface = surfaces.get(name);
+				entry.frame.load(*entry.surface);
+			}
+			return entry.frame;
+		};
+		for (const auto& [id, layer] : layers) {
+			try {
+				auto& dst = frame_of(layer.dst);
+				// a surface that layers were composed onto this frame is read with them
+				auto composed = surface_frames.find(layer.src);
+				if (composed != surface_frames.end() && composed->second.surface)
+					ohtoai::rpi::compose(dst, composed->second.frame, layer);
+				else
+					with_source(layer.src, [&](const ohtoai::rpi::IPaintSource& src) { ohtoai::rpi::compose(dst, src, layer); });
+			}
+			catch (const std::out_of_range& e) {
+				spdlog::debug("layer {} skipped: {}", id, e.what());
+			}
+		}
+		for (auto it = surface_frames.begin(); it != surface_frames.end();) {
+			if (it->second.surface) {
+				it->second.surface.reset();
+				++it;
+			}
+			else
+				it = surface_frames.erase(it);
+		}
+		return on_strip;
+	};
+	std::mutex present_mutex;
+	// strip changes counted at the last two presents, while they agree strip_frame still holds the framebuffer
+	// and only sprite damage is repainted; one more full reload after the last change catches a write that
+	// landed after its led_ref was counted
+	std::array<uint64_t, 2> sprite_base_changes = {1, 0};
+	bool sprite_frame_loaded = false;
+	auto present = [&]{
+		std::lock_guard<std::mutex> lock(present_mutex);
+		stats.frame_begin();
+		bool composed = compose_layers();
+		// sprites are never drawn into the framebuffer, the areas they leave are restored from it
+		if (sprites.size() != 0) {
+			const auto changes = strip.changes();
+			const bool settled = changes == sprite_base_changes[0] && changes == sprite_base_changes[1];
+			sprite_base_changes = {changes, sprite_base_changes[0]};
+			if (composed)
+				sprites.draw_over(strip_frame);
+			else if (sprite_frame_loaded && settled)
+				stats.set("sprite_leds_restored", static_cast<double>(sprites.compose(strip_frame, strip)));
+			else {
+				strip_frame.load(strip);
+				sprites.draw_over(strip_frame);
+			}
+			// a frame with layers is rebuilt from scratch next time anyway
+			sprite_frame_loaded = !composed;
+			composed = true;
+		}
+		else
+			sprite_frame_loaded = false;
+		{
+			std::lock_guard<std::mutex> lock(hdr_mutex);
+			// a layer left at another size is skipped rather than thrown out of the render loop
+			if (hdr && hdr->width() == strip.width() && hdr->height() == strip.height())
+				hdr->present(strip);
+			else if (composed)
+				strip.render(strip_frame.data());
+			else
+				strip.render();
+		}
+		stats.frame_end();
+		stats.set("power_watts", strip.output().watts());
+		stats.set("power_scale", strip.output().power_scale() / 256.0);
+	};
+	// strip or offscreen surface with direct access to its led buffer
+	auto with_buffer = [&](const std::string& name, auto&& fn) {
+		if (name.empty())
+			fn(strip);
+		else
+			fn(*surfaces.get(name));
+	};
+	RenderScheduler scheduler;
+	std::mutex trails_mutex;
+	std::unordered_map<std::string, std::shared_ptr<Trail>> trails;
+	auto trail_of = [&](const std::string& name) {
+		std::size_t size = 0;
+		with_buffer(name, [&](auto& device) { size = device.size(); });
+		std::lock_guard<std::mutex> lock(trails_mutex);
+		auto& trail = trails[name];
+		if (!trail || trail->size() != size) {
+			// a resized buffer gets a new map, the decay of the old one would run on
+			if (trail && trail->task >= 0)
+				scheduler.cancel(trail->task);
+			trail = std::make_shared<Trail>(size);
+		}
+		return trail;
+	};
+	AnimationEngine animations;
+	scheduler.every(std::chrono::microseconds(1000000 / 60), [&](auto now) {
+		return animations.evaluate(now) ? TaskResult::changed : TaskResult::idle;
+	});
+	scheduler.every(std::chrono::microseconds(1000000 / 60), [&](auto now) {
+		return effects.advance(now) ? TaskResult::changed : TaskResult::idle;
+	});
+	// setter of an animatable property and whether it holds a color
+	auto bind_property = [&](const std::string& kind, const std::string& name,
+		const std::string& property) -> std::pair<ohtoai::rpi::Animation::Setter, bool> {
+		if (kind == "sprite") {
+			int id = std::stoi(name);
+			sprites.sprite(id);
+			if (property == "x")
+				return {[&, id](double v) { sprites.move(id, static_cast<int>(std::lround(v)), sprites.sprite(id).y); }, false};
+			if (property == "y")
+				return {[&, id](double v) { sprites.move(id, sprites.sprite(id).x, static_cast<int>(std::lround(v))); }, false};
+			if (property == "z")
+				return {[&, id](double v) { sprites.set_z(id, static_cast<int>(std::lround(v))); }, false};
+			if (property == "visible")
+				return {[&, id](double v) { sprites.set_visible(id, v >= 0.5); }, false};
+		}
+		else if (kind == "layer") {
+			auto field = [&, name](auto member) -> ohtoai::rpi::Animation::Setter {
+				return [&, name, member](double v) {
+					std::lock_guard<std::mutex> lock(layers_mutex);
+					member(layers.at(name), v);
+				};
+			};
+			{
+				std::lock_guard<std::mutex> lock(layers_mutex);
+				layers.at(name);
+			}
+			if (property == "x")
+				return {field([](auto& layer, double v) { layer.x = static_cast<float>(v); }), false};
+			if (property == "y")
+				return {field([](auto& layer, double v) { layer.y = static_cast<float>(v); }), false};
+			if (property == "scroll_x")
+				return {field([](auto& layer, double v) { layer.scroll_x = static_cast<float>(v); }), false};
+			if (property == "scroll_y")
+				return {field([](auto& layer, double v) { layer.scroll_y = static_cast<float>(v); }), false};
+			if (property == "opacity")
+				return {field([](auto& layer, double v) { layer.opacity = static_cast<int>(std::lround(v)); }), false};
+			if (property == "visible")
+				return {field([](auto& layer, double v) { layer.visible = v >= 0.5; }), false};
+		}
+		else if (kind == "surface") {
+			target(name);
+			if (property == "background")
+				return {[&, name](double v) { target(name)->set_background(static_cast<ohtoai::rpi::LedColor>(v)); }, true};
+		}
+		else if (kind == "effect") {
+			effects.with(name, [](const ohtoai::rpi::Effect&) {});
+			return {[&, name, property](double v) {
+				effects.with(name, [&](ohtoai::rpi::Effect& effect) { effect.set_param(property, v); });
+			}, false};
+		}
+		else if (kind == "output") {
+			if (property == "brightness")
+				return {[&](double v) { strip.output().set_brightness(static_cast<uint8_t>(std::clamp(v, 0.0, 255.0))); }, false};
+		}
+		throw std::invalid_argument(fmt::format("no animatable property {} of {} {}", property, kind, name));
+	};
+	rest_rpc::rpc_service::rpc_server server(config.port, std::thread::hardware_concurrency());
+	// latest transition task per target, a new transition on the same target replaces it
+	std::mutex transitions_mutex;
+	std::unordered_map<std::string, int> transitions;
+	// next is looked up every frame unless a prepared frame is given, "transition_done" is published with dst when finished
+	auto start_transition = [&](const std::string& dst, const std::string& next, ohtoai::rpi::Sequencer::Frame frame,
+		std::shared_ptr<ohtoai::rpi::Transition> transition) {
+		auto start = RenderScheduler::Clock::now();
+		auto id = scheduler.every(std::chrono::microseconds(1000000 / 60), [&, dst, next, frame, transition, start](auto now) {
+			auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
+			bool running = false;
+			try {
+				auto render = [&](const ohtoai::rpi::IPaintSource& src) {
+					return transition->render(*target(dst), src, static_cast<uint32_t>(std::max<int64_t>(ms, 0)));
+				};
+				running = frame ? render(*frame) : with_source(next, render);
+			}
+			catch (const std::out_of_range& e) {
+				spdlog::warn("transition on {} stopped: {}", dst, e.what());
+			}
+			if (running)
+				return TaskResult::changed;
+			server.publish("transition_done", dst);
+			return TaskResult::done;
+		});
+		// the scheduler lock is never taken under transitions_mutex, tasks start transitions while holding it
+		std::optional<int> replaced;
+		{
+			std::lock_guard<std::mutex> lock(transitions_mutex);
+			auto [it, inserted] = transitions.try_emplace(dst, id);
+			if (!inserted)
+				replaced = std::exchange(it->second, id);
+		}
+		if (replaced)
+			scheduler.cancel(*replaced);
+		return id;
+	};
+	// playlist shown on sequence_dst, scenes are prepared on the sequencer worker thread
+	std::mutex sequence_mutex;
+	std::string sequence_dst;
+	std::optional<ohtoai::rpi::Sequencer::Cue> showing;
+	bool scene_painted = false;
+	RenderScheduler::Clock::time_point scene_settled;
+	ohtoai::rpi::Sequencer sequencer([&](const ohtoai::rpi::Scene& scene) -> ohtoai::rpi::Sequencer::Frame {
+		// effects keep moving, they are read every frame
+		if (scene.text.empty() && effects.contains(scene.source))
+			return nullptr;
+		std::string dst;
+		{
+			std::lock_guard<std::mutex> lock(sequence_mutex);
+			dst = sequence_dst;
+		}
+		const auto base = target(dst);
+		auto frame = std::make_shared<Pixmap>(base->width(), base->height(), scene.background);
+		frame->clear();
+		if (!scene.source.empty()) {
+			with_source(scene.source, [&](const ohtoai::rpi::IPaintSource& src) { ohtoai::rpi::draw(*frame, src, 0, 0); });
+			frame->set_transparent(true);
+		}
+		if (!scene.text.empty())
+			ohtoai::rpi::draw(*frame, ohtoai::rpi::Text4x8(scene.text, scene.color, scene.background), 0, (frame->height() - 8) / 2);
+		return frame;
+	});
+	scheduler.every(std::chrono::microseconds(1000000 / 60), [&](auto now) {
+		auto wall = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+		std::tm local{};
+		localtime_r(&wall, &local);
+		auto cue = sequencer.advance(now, local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec);
+		std::lock_guard<std::mutex> lock(sequence_mutex);
+		try {
+			if (cue) {
+				showing = std::move(cue);
+				scene_painted = false;
+				scene_settled = now;
+				server.publish("scene_changed", showing->scene.name);
+				const auto& scene = showing->scene;
+				if (scene.transition_ms > 0) {
+					start_transition(sequence_dst, scene.source, showing->frame,
+						std::make_shared<ohtoai::rpi::Transition>(scene.transition, *target(sequence_dst), scene.transition_ms,
+						scene.direction, scene.easing));
+					scene_settled = now + std::chrono::milliseconds(scene.transition_ms);
+				}
+			}
+			// prepared frames are painted once, live scenes every frame once their transition is over
+			if (!showing || now < scene_settled || (scene_painted && showing->frame))
+				return TaskResult::idle;
+			auto dst = target(sequence_dst);
+			if (showing->frame)
+				ohtoai::rpi::draw(*dst, *showing->frame, 0, 0);
+			else
+				with_source(showing->scene.source, [&](const ohtoai::rpi::IPaintSource& src) { ohtoai::rpi::draw(*dst, src, 0, 0); });
+		}
+		catch (const std::exception& e) {
+			spdlog::warn("scene {} skipped: {}", showing ? showing->scene.name : "", e.what());
+			showing.reset();
+			return TaskResult::idle;
+		}
+		scene_painted = true;
+		return TaskResult::changed;
+	});
 
 	server.register_handler("render", [&](rest_rpc::rpc_service::rpc_conn conn){
-		strip.render();
+		present();
 	});
 	server.register_handler("draw_pixel", [&](rest_rpc::rpc_service::rpc_conn conn, int x, int y, ohtoai::rpi::LedColor color){
+		if (x < 0 || x >= strip.width() || y < 0 || y >= strip.height())
+			throw std::invalid_argument(fmt::format("draw_pixel {}, {}", x, y));
 		strip.led_ref(x, y) = color;
 	});
 	server.register_handler("draw_text", [&](rest_rpc::rpc_service::rpc_conn conn, int x, int y,
 		std::string text, ohtoai::rpi::LedColor color, ohtoai::rpi::LedColor background){
-		strip.draw(ohtoai::rpi::Text4x8(text).set_color(color).set_background(background), x, y);
+		FrameArena::Scope scope(FrameArena::local());
+		ohtoai::rpi::draw(strip, ohtoai::rpi::Text4x8(text, color, background, &scope.arena()), x, y);
 	});
 	server.register_handler("draw_number", [&](rest_rpc::rpc_service::rpc_conn conn, int x, int y,
 		int number, ohtoai::rpi::LedColor color, ohtoai::rpi::LedColor background){
-		strip.draw(ohtoai::rpi::DigitGroup3x5(number).set_color(color), x, y);
+		ohtoai::rpi::draw(strip, ohtoai::rpi::DigitGroup3x5(number).set_color(color), x, y);
 	});
 	server.register_handler("clear", [&](rest_rpc::rpc_service::rpc_conn conn){
 		strip.clear();
@@ -43,10 +426,16 @@ int main() {
 		return strip.height();
 	});
 	server.register_handler("pixel", [&](rest_rpc::rpc_service::rpc_conn conn, int x, int y){
+		if (x < 0 || x >= strip.width() || y < 0 || y >= strip.height())
+			throw std::invalid_argument(fmt::format("pixel {}, {}", x, y));
 		return strip.led(x, y);
 	});
 	server.register_handler("set_rotate", [&](rest_rpc::rpc_service::rpc_conn conn, int degree, bool flip_x, bool flip_y){
-		return strip.set_rotate(degree, flip_x, flip_y);
+		strip.set_rotate(degree, flip_x, flip_y);
+		// quarter turns swap the sides, the hdr layer starts over blank at the new size
+		std::lock_guard<std::mutex> lock(hdr_mutex);
+		if (hdr && (hdr->width() != strip.width() || hdr->height() != strip.height()))
+			hdr = std::make_unique<HdrPixmap>(strip.width(), strip.height());
 	});
 	server.register_handler("set_transparent", [&](rest_rpc::rpc_service::rpc_conn conn, bool transparent){
 		return strip.set_transparent(transparent);
@@ -54,14 +443,470 @@ int main() {
 	server.register_handler("set_background", [&](rest_rpc::rpc_service::rpc_conn conn, ohtoai::rpi::LedColor color){
 		return strip.set_background(color);
 	});
+	server.register_handler("set_brightness", [&](rest_rpc::rpc_service::rpc_conn conn, int brightness){
+		strip.output().set_brightness(static_cast<uint8_t>(std::clamp(brightness, 0, 255)));
+	});
+	server.register_handler("set_gamma", [&](rest_rpc::rpc_service::rpc_conn conn, float gamma){
+		strip.output().set_gamma(gamma);
+	});
+	server.register_handler("set_white_balance", [&](rest_rpc::rpc_service::rpc_conn conn, int r, int g, int b){
+		strip.output().set_white_balance(static_cast<uint8_t>(std::clamp(r, 0, 255)),
+			static_cast<uint8_t>(std::clamp(g, 0, 255)), static_cast<uint8_t>(std::clamp(b, 0, 255)));
+	});
+	server.register_handler("set_power_budget", [&](rest_rpc::rpc_service::rpc_conn conn, int milliamps){
+		strip.output().set_power_budget(static_cast<uint32_t>(std::max(milliamps, 0)));
+	});
+	server.register_handler("set_panel_calibration", [&](rest_rpc::rpc_service::rpc_conn conn, int panel,
+		std::vector<float> matrix, std::vector<float> offset){
+		std::lock_guard<std::mutex> lock(panels_mutex);
+		if (panel < 0 || panel >= static_cast<int>(panels.size()))
+			throw std::out_of_range("set_panel_calibration");
+		if (matrix.size() != 9 || offset.size() != 3)
+			throw std::invalid_argument("set_panel_calibration needs 9 matrix and 3 offset values");
+		std::array<float, 9> checked_matrix;
+		std::array<float, 3> checked_offset;
+		std::copy(matrix.begin(), matrix.end(), checked_matrix.begin());
+		std::copy(offset.begin(), offset.end(), checked_offset.begin());
+		// rejected before it is stored, a bad panel would fail every later apply_calibration
+		ohtoai::rpi::ColorCorrection(checked_matrix, checked_offset);
+		panels[panel].matrix = checked_matrix;
+		panels[panel].offset = checked_offset;
+		apply_calibration();
+	});
+	server.register_handler("set_dither", [&](rest_rpc::rpc_service::rpc_conn conn, bool dither){
+		strip.output().set_dither(dither);
+	});
+	server.register_handler("fade", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, int factor){
+		with_buffer(name, [&](auto& device) {
+			ohtoai::rpi::fade(device.data(), device.size(), static_cast<uint8_t>(std::clamp(factor, 0, 255)));
+		});
+	});
+	// in place filters on the strip or a surface, in logical coordinates
+	auto with_filter = [&](const std::string& name, auto&& fn) {
+		ohtoai::rpi::Filter filter;
+		with_buffer(name, [&](auto& device) {
+			filter.apply(device, [&](ohtoai::rpi::LedColor* leds, int w, int h) { fn(filter, leds, w, h); });
+		});
+	};
+	server.register_handler("blur", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, double sigma){
+		with_filter(name, [&](ohtoai::rpi::Filter& filter, ohtoai::rpi::LedColor* leds, int w, int h) {
+			filter.gaussian_blur(leds, w, h, sigma);
+		});
+	});
+	server.register_handler("box_blur", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, int radius, int passes){
+		with_filter(name, [&](ohtoai::rpi::Filter& filter, ohtoai::rpi::LedColor* leds, int w, int h) {
+			filter.box_blur(leds, w, h, radius, std::clamp(passes, 1, 8));
+		});
+	});
+	// gain 1.0 adds the blurred highlights once
+	server.register_handler("bloom", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, int threshold, int radius, double gain){
+		with_filter(name, [&](ohtoai::rpi::Filter& filter, ohtoai::rpi::LedColor* leds, int w, int h) {
+			filter.bloom(leds, w, h, static_cast<uint8_t>(std::clamp(threshold, 0, 255)), radius,
+				static_cast<int>(std::clamp(gain, 0.0, 16.0) * 256));
+		});
+	});
+	// 3x3 kernel in row order, taps and bias clamped to +-1024, a divisor of 0 divides by the kernel sum
+	server.register_handler("convolve", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, std::vector<int> kernel,
+		int divisor, int bias){
+		if (kernel.size() != 9)
+			throw std::invalid_argument("convolve needs a 3x3 kernel of 9 values");
+		std::array<int, 9> taps{};
+		std::copy(kernel.begin(), kernel.end(), taps.begin());
+		with_filter(name, [&](ohtoai::rpi::Filter& filter, ohtoai::rpi::LedColor* leds, int w, int h) {
+			filter.convolve(leds, w, h, taps, divisor, bias);
+		});
+	});
+	// decay applied by the render thread rate times per second, 0 stops it
+	server.register_handler("set_decay", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, int factor, int rate){
+		auto trail = trail_of(name);
+		trail->fill(static_cast<uint8_t>(std::clamp(factor, 0, 255)));
+		// cancel and replace as one step, so concurrent calls cannot leave a task running unreferenced
+		std::lock_guard<std::mutex> lock(trails_mutex);
+		if (trail->task >= 0)
+			scheduler.cancel(trail->task);
+		trail->task = -1;
+		if (rate <= 0)
+			return;
+		trail->task = scheduler.every(std::chrono::microseconds(1000000 / rate), [&, name, trail](auto) {
+			try {
+				with_buffer(name, [&](auto& device) { trail->apply(device.data(), device.size()); });
+				return TaskResult::changed;
+			}
+			catch (const std::exception& e) {
+				spdlog::warn("decay of {} stopped: {}", name, e.what());
+				return TaskResult::done;
+			}
+		});
+	});
+	server.register_handler("set_decay_region", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name,
+		int x, int y, int w, int h, int factor){
+		auto trail = trail_of(name);
+		with_buffer(name, [&](auto& device) {
+			trail->set_region(device, x, y, w, h, static_cast<uint8_t>(std::clamp(factor, 0, 255)));
+		});
+	});
+	server.register_handler("hdr_enable", [&](rest_rpc::rpc_service::rpc_conn conn, bool enable){
+		std::lock_guard<std::mutex> lock(hdr_mutex);
+		if (!enable)
+			hdr.reset();
+		else if (!hdr || hdr->width() != strip.width() || hdr->height() != strip.height())
+			hdr = std::make_unique<HdrPixmap>(strip.width(), strip.height());
+	});
+	server.register_handler("hdr_clear", [&](rest_rpc::rpc_service::rpc_conn conn){
+		with_hdr([&](HdrPixmap& layer) { layer.clear(); });
+	});
+	server.register_handler("hdr_draw_surface", [&](rest_rpc::rpc_service::rpc_conn conn, std::string src, int x, int y){
+		with_hdr([&](HdrPixmap& layer) { layer.draw(*target(src), x, y); });
+	});
+	server.register_handler("hdr_add_surface", [&](rest_rpc::rpc_service::rpc_conn conn, std::string src, int x, int y, int gain){
+		with_hdr([&](HdrPixmap& layer) { layer.add(*target(src), x, y, static_cast<uint32_t>(std::clamp(gain, 0, 65536))); });
+	});
+	server.register_handler("hdr_add_pixel", [&](rest_rpc::rpc_service::rpc_conn conn, int x, int y,
+		ohtoai::rpi::LedColor color, int gain){
+		with_hdr([&](HdrPixmap& layer) {
+			if (x < 0 || x >= layer.width() || y < 0 || y >= layer.height())
+				throw std::out_of_range("hdr_add_pixel");
+			layer.add(x, y, color, static_cast<uint32_t>(std::clamp(gain, 0, 65536)));
+		});
+	});
+	server.register_handler("hdr_scale", [&](rest_rpc::rpc_service::rpc_conn conn, int factor){
+		with_hdr([&](HdrPixmap& layer) { layer.scale(static_cast<uint32_t>(std::clamp(factor, 0, 65536))); });
+	});
 	server.register_handler("set_auto_render", [&](rest_rpc::rpc_service::rpc_conn conn, bool auto_render_){
 		return auto_render = auto_render_;
 	});
 
+	server.register_handler("create_surface", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name,
+		int width, int height, ohtoai::rpi::LedColor background){
+		surfaces.create(name, width, height, background);
+	});
+	server.register_handler("destroy_surface", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name){
+		return surfaces.destroy(name);
+	});
+	server.register_handler("surface_draw_pixel", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name,
+		int x, int y, ohtoai::rpi::LedColor color){
+		auto device = target(name);
+		if (x < 0 || x >= device->width() || y < 0 || y >= device->height())
+			throw std::invalid_argument(fmt::format("surface_draw_pixel {} {}, {}", name, x, y));
+		device->led_ref(x, y) = color;
+	});
+	server.register_handler("surface_draw_text", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, int x, int y,
+		std::string text, ohtoai::rpi::LedColor color, ohtoai::rpi::LedColor background){
+		FrameArena::Scope scope(FrameArena::local());
+		ohtoai::rpi::draw(*target(name), ohtoai::rpi::Text4x8(text, color, background, &scope.arena()), x, y);
+	});
+	server.register_handler("surface_draw_number", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, int x, int y,
+		int number, ohtoai::rpi::LedColor color, ohtoai::rpi::LedColor background){
+		ohtoai::rpi::draw(*target(name), ohtoai::rpi::DigitGroup3x5(number).set_color(color).set_background(background), x, y);
+	});
+	server.register_handler("surface_clear", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name){
+		target(name)->clear();
+	});
+	server.register_handler("surface_set_rotate", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name,
+		int degree, bool flip_x, bool flip_y){
+		return surfaces.get(name)->set_rotate(degree, flip_x, flip_y);
+	});
+	server.register_handler("surface_set_transparent", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, bool transparent){
+		return target(name)->set_transparent(transparent);
+	});
+	server.register_handler("surface_set_background", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name,
+		ohtoai::rpi::LedColor color){
+		return target(name)->set_background(color);
+	});
+	server.register_handler("draw_surface", [&](rest_rpc::rpc_service::rpc_conn conn, std::string dst, std::string src,
+		int x, int y, bool flip_x, bool flip_y){
+		ohtoai::rpi::draw(*target(dst), *surfaces.get(src), x, y, flip_x, flip_y);
+	});
+	server.register_handler("blend_surface", [&](rest_rpc::rpc_service::rpc_conn conn, std::string dst, std::string src,
+		int x, int y, int alpha){
+		target(dst)->blend(*surfaces.get(src), x, y, static_cast<uint8_t>(std::clamp(alpha, 0, 255)));
+	});
+	server.register_handler("create_packed", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name,
+		int width, int height, ohtoai::rpi::LedColor background){
+		packed.create(name, width, height, background);
+	});
+	server.register_handler("destroy_packed", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name){
+		return packed.destroy(name);
+	});
+	server.register_handler("packed_draw_surface", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name,
+		std::string src, int x, int y){
+		packed.get(name)->draw(*target(src), x, y);
+	});
+	server.register_handler("draw_packed", [&](rest_rpc::rpc_service::rpc_conn conn, std::string dst, std::string src, int x, int y){
+		auto source = packed.get(src);
+		if (dst.empty())
+			ohtoai::rpi::draw(strip, *source, x, y);
+		else
+			source->unpack(*surfaces.get(dst), x, y);
+	});
+	// packed 0xHHHHSSVV values, w per row, drawn with the surface rules of led_ref
+	server.register_handler("draw_pixels_hsv", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name,
+		int x, int y, int w, std::vector<uint32_t> pixels){
+		if (w <= 0)
+			throw std::invalid_argument("draw_pixels_hsv");
+		auto dst = target(name);
+		FrameArena::Scope scope(FrameArena::local());
+		std::pmr::vector<ohtoai::rpi::Hsv> hsv(pixels.size(), &scope.arena());
+		std::pmr::vector<ohtoai::rpi::LedColor> rgb(pixels.size(), &scope.arena());
+		std::transform(pixels.begin(), pixels.end(), hsv.begin(), ohtoai::rpi::Hsv::unpack);
+		ohtoai::rpi::hsv_to_rgb(hsv.data(), rgb.data(), rgb.size());
+		for (size_t i = 0; i < rgb.size(); ++i) {
+			int px = x + static_cast<int>(i % w), py = y + static_cast<int>(i / w);
+			if (px >= 0 && px < dst->width() && py >= 0 && py < dst->height())
+				dst->led_ref(px, py) = rgb[i];
+		}
+	});
+	// hue runs from start over span (65536 is one turn) along x, or along y when vertical
+	server.register_handler("fill_hue_gradient", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name,
+		int x, int y, int w, int h, int start, int span, int saturation, int value, bool vertical){
+		if (w <= 0 || h <= 0)
+			throw std::invalid_argument("fill_hue_gradient");
+		auto dst = target(name);
+		const int length = vertical ? h : w;
+		FrameArena::Scope scope(FrameArena::local());
+		std::pmr::vector<ohtoai::rpi::Hsv> hsv(length, &scope.arena());
+		std::pmr::vector<ohtoai::rpi::LedColor> rgb(length, &scope.arena());
+		ohtoai::rpi::hue_gradient(hsv.data(), hsv.size(), static_cast<uint32_t>(start), span,
+			static_cast<uint8_t>(std::clamp(saturation, 0, 255)), static_cast<uint8_t>(std::clamp(value, 0, 255)));
+		ohtoai::rpi::hsv_to_rgb(hsv.data(), rgb.data(), rgb.size());
+		for (int py = std::max(y, 0); py < std::min(y + h, dst->height()); ++py)
+			for (int px = std::max(x, 0); px < std::min(x + w, dst->width()); ++px)
+				dst->led_ref(px, py) = rgb[vertical ? py - y : px - x];
+	});
+	server.register_handler("create_indexed", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, int width, int height){
+		indexed.create(name, width, height);
+	});
+	server.register_handler("destroy_indexed", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name){
+		return indexed.destroy(name);
+	});
+	server.register_handler("indexed_set_palette", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name,
+		int first, std::vector<ohtoai::rpi::LedColor> colors){
+		indexed.get(name)->set_palette(colors, first);
+	});
+	server.register_handler("indexed_cycle_palette", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name,
+		int first, int last, int steps){
+		indexed.get(name)->cycle_palette(first, last, steps);
+	});
+	server.register_handler("indexed_set_pixels", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name,
+		std::vector<uint8_t> indices){
+		indexed.get(name)->set_indices(indices);
+	});
+	server.register_handler("indexed_import", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name,
+		std::vector<ohtoai::rpi::LedColor> pixels, bool dither){
+		indexed.get(name)->quantize(pixels, dither);
+	});
+	server.register_handler("draw_indexed", [&](rest_rpc::rpc_service::rpc_conn conn, std::string dst, std::string src, int x, int y){
+		auto source = indexed.get(src);
+		if (dst.empty()) {
+			ohtoai::rpi::draw(strip, *source, x, y);
+			return;
+		}
+		auto surface = surfaces.get(dst);
+		if (x == 0 && y == 0 && surface->width() >= source->width() && surface->height() >= source->height())
+			source->expand(*surface);
+		else
+			ohtoai::rpi::draw(*surface, *source, x, y);
+	});
+
+	// rainbow, plasma, fire, twinkle, noise or life, advanced by the render thread and drawn through layers or draw_effect
+	server.register_handler("create_effect", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, std::string kind,
+		int width, int height){
+		effects.add(name, ohtoai::rpi::make_effect(kind, width, height));
+	});
+	server.register_handler("destroy_effect", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name){
+		return effects.destroy(name);
+	});
+	server.register_handler("life_set_rule", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, std::string rule){
+		effects.with(name, [&](ohtoai::rpi::Effect& effect) {
+			auto life = dynamic_cast<ohtoai::rpi::LifeEffect*>(&effect);
+			if (!life)
+				throw std::invalid_argument(fmt::format("{} is not a life effect", name));
+			life->grid().set_rule(rule);
+		});
+	});
+	// 16 bit PCM from a wav or raw file, a FIFO or "-" for stdin; rate and channels only apply to raw input
+	server.register_handler("audio_open", [&](rest_rpc::rpc_service::rpc_conn conn, std::string path,
+		int sample_rate, int channels, int bands){
+		audio.open(path, {sample_rate, channels}, static_cast<size_t>(std::max(bands, 0)));
+	});
+	server.register_handler("audio_close", [&](rest_rpc::rpc_service::rpc_conn conn){
+		audio.close();
+	});
+	server.register_handler("create_spectrum", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, int width, int height){
+		if (width <= 0 || height <= 0)
+			throw std::invalid_argument(fmt::format("create_spectrum {} {}x{}", name, width, height));
+		effects.add(name, std::make_unique<ohtoai::rpi::SpectrumEffect>(width, height, audio.output()));
+	});
+	// raw rgb24 or yuv420p frames of src_w x src_h from a file, a FIFO or "-" for stdin, scaled down to width x height
+	server.register_handler("create_video", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, std::string path,
+		int src_w, int src_h, std::string format, double fps, int width, int height){
+		if (src_w <= 0 || src_h <= 0 || width <= 0 || height <= 0
+			|| static_cast<uint64_t>(src_w) * static_cast<uint64_t>(src_h) > ohtoai::rpi::AreaScaler::max_source_pixels)
+			throw std::invalid_argument(fmt::format("create_video {} {}x{} to {}x{}", name, src_w, src_h, width, height));
+		const ohtoai::rpi::VideoFormat video{src_w, src_h, ohtoai::rpi::video_pixel_format_from_string(format), fps};
+		effects.add(name, std::make_unique<ohtoai::rpi::VideoEffect>(width, height, path, video));
+	});
+	// per pixel program of x, y, w, h and t, compile errors are returned with their position
+	server.register_handler("create_program", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, std::string program,
+		int width, int height){
+		if (width <= 0 || height <= 0)
+			throw std::invalid_argument(fmt::format("create_program {} {}x{}", name, width, height));
+		effects.add(name, std::make_unique<ohtoai::rpi::ProgramEffect>(width, height, program));
+	});
+	server.register_handler("set_program", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, std::string program){
+		effects.with(name, [&](ohtoai::rpi::Effect& effect) {
+			auto programmed = dynamic_cast<ohtoai::rpi::ProgramEffect*>(&effect);
+			if (!programmed)
+				throw std::invalid_argument(fmt::format("{} is not a program effect", name));
+			programmed->set_program(program);
+		});
+	});
+	server.register_handler("set_effect_param", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name,
+		std::string key, double value){
+		effects.with(name, [&](ohtoai::rpi::Effect& effect) { effect.set_param(key, value); });
+	});
+	server.register_handler("draw_effect", [&](rest_rpc::rpc_service::rpc_conn conn, std::string dst, std::string name, int x, int y){
+		auto device = target(dst);
+		effects.with(name, [&](const ohtoai::rpi::Effect& effect) { ohtoai::rpi::draw(*device, effect, x, y); });
+	});
+	server.register_handler("set_layer", [&](rest_rpc::rpc_service::rpc_conn conn, std::string id, std::string dst,
+		std::string src, int x, int y){
+		std::lock_guard<std::mutex> lock(layers_mutex);
+		auto& layer = layers[id];
+		layer = {};
+		layer.dst = dst;
+		layer.src = src;
+		layer.x = static_cast<float>(x);
+		layer.y = static_cast<float>(y);
+	});
+	server.register_handler("remove_layer", [&](rest_rpc::rpc_service::rpc_conn conn, std::string id){
+		std::lock_guard<std::mutex> lock(layers_mutex);
+		return layers.erase(id) != 0;
+	});
+	// one keyframed track, times in ms from the start, easing per segment ("linear", "ease_in_out", "step", ...)
+	server.register_handler("animate", [&](rest_rpc::rpc_service::rpc_conn conn, std::string kind, std::string name,
+		std::string property, std::vector<int> times, std::vector<double> values, std::vector<std::string> easings, bool loop){
+		if (times.size() != values.size() || (!easings.empty() && easings.size() != times.size()))
+			throw std::invalid_argument("animate needs as many values and easings as times");
+		auto [setter, color] = bind_property(kind, name, property);
+		std::vector<ohtoai::rpi::Keyframe> keys;
+		for (size_t i = 0; i < times.size(); ++i) {
+			if (!std::isfinite(values[i]))
+				throw std::invalid_argument(fmt::format("animate {} {} {} value {}", kind, name, property, values[i]));
+			// colors are cast to LedColor, numbers to int or float by the setters
+			const double value = color ? std::clamp(values[i], 0.0, 4294967295.0) : std::clamp(values[i], -1e9, 1e9);
+			keys.push_back({static_cast<uint32_t>(std::max(times[i], 0)), value,
+				ohtoai::rpi::easing_from_string(easings.empty() ? "" : easings[i])});
+		}
+		ohtoai::rpi::Animation animation(loop);
+		animation.add(ohtoai::rpi::Track(std::move(keys), color), std::move(setter));
+		return animations.start(std::move(animation));
+	});
+	server.register_handler("stop_animation", [&](rest_rpc::rpc_service::rpc_conn conn, int id){
+		return animations.stop(id);
+	});
+	// from the current content of dst to the surface or effect next
+	server.register_handler("transition", [&](rest_rpc::rpc_service::rpc_conn conn, std::string dst, std::string next,
+		std::string kind, int duration_ms, std::string direction, std::string easing){
+		with_source(next, [](const ohtoai::rpi::IPaintSource&) {});
+		return start_transition(dst, next, nullptr,
+			std::make_shared<ohtoai::rpi::Transition>(ohtoai::rpi::transition_from_string(kind), *target(dst),
+				static_cast<uint32_t>(std::max(duration_ms, 0)), ohtoai::rpi::direction_from_string(direction),
+				ohtoai::rpi::easing_from_string(easing)));
+	});
+	server.register_handler("cancel_transition", [&](rest_rpc::rpc_service::rpc_conn conn, std::string dst){
+		int id = 0;
+		{
+			std::lock_guard<std::mutex> lock(transitions_mutex);
+			auto it = transitions.find(dst);
+			if (it == transitions.end())
+				return false;
+			id = it->second;
+			transitions.erase(it);
+		}
+		return scheduler.cancel(id);
+	});
+	// scene: surface or effect, text drawn over it; at: "HH:MM[:SS]" to cut in at that time of day instead of taking turns
+	server.register_handler("sequence_add", [&](rest_rpc::rpc_service::rpc_conn conn, std::string name, std::string scene_source,
+		std::string text, ohtoai::rpi::LedColor color, ohtoai::rpi::LedColor background, int duration_ms,
+		std::string transition, int transition_ms, std::string direction, std::string at){
+		ohtoai::rpi::Scene scene;
+		scene.name = name;
+		scene.source = scene_source;
+		scene.text = text;
+		scene.color = color;
+		scene.background = background;
+		scene.duration_ms = static_cast<uint32_t>(std::max(duration_ms, 0));
+		scene.transition = ohtoai::rpi::transition_from_string(transition);
+		scene.transition_ms = static_cast<uint32_t>(std::max(transition_ms, 0));
+		scene.direction = ohtoai::rpi::direction_from_string(direction);
+		scene.at = ohtoai::rpi::parse_time_of_day(at);
+		sequencer.add(std::move(scene));
+		return sequencer.size();
+	});
+	server.register_handler("sequence_clear", [&](rest_rpc::rpc_service::rpc_conn conn){
+		sequencer.clear();
+	});
+	server.register_handler("sequence_start", [&](rest_rpc::rpc_service::rpc_conn conn, std::string dst){
+		target(dst);
+		{
+			std::lock_guard<std::mutex> lock(sequence_mutex);
+			sequence_dst = dst;
+		}
+		sequencer.start();
+	});
+	server.register_handler("sequence_stop", [&](rest_rpc::rpc_service::rpc_conn conn){
+		sequencer.stop();
+		std::lock_guard<std::mutex> lock(sequence_mutex);
+		showing.reset();
+	});
+	server.register_handler("sequence_skip", [&](rest_rpc::rpc_service::rpc_conn conn){
+		sequencer.skip();
+	});
+	server.register_handler("stats", [&](rest_rpc::rpc_service::rpc_conn conn){
+		return stats.snapshot();
+	});
+	server.register_handler("sprite_upload", [&](rest_rpc::rpc_service::rpc_conn conn, int width, int height,
+		std::vector<ohtoai::rpi::LedColor> pixels){
+		return atlas.upload(width, height, pixels);
+	});
+	server.register_handler("sprite_create", [&](rest_rpc::rpc_service::rpc_conn conn, int image, int x, int y, int z){
+		return sprites.create(image, x, y, z);
+	});
+	server.register_handler("sprite_destroy", [&](rest_rpc::rpc_service::rpc_conn conn, int id){
+		sprites.destroy(id);
+	});
+	server.register_handler("sprite_move", [&](rest_rpc::rpc_service::rpc_conn conn, int id, int x, int y){
+		sprites.move(id, x, y);
+	});
+	server.register_handler("sprite_set_image", [&](rest_rpc::rpc_service::rpc_conn conn, int id, int image){
+		sprites.set_image(id, image);
+	});
+	server.register_handler("sprite_set_flip", [&](rest_rpc::rpc_service::rpc_conn conn, int id, bool flip_x, bool flip_y){
+		sprites.set_flip(id, flip_x, flip_y);
+	});
+	server.register_handler("sprite_set_z", [&](rest_rpc::rpc_service::rpc_conn conn, int id, int z){
+		sprites.set_z(id, z);
+	});
+	server.register_handler("sprite_set_visible", [&](rest_rpc::rpc_service::rpc_conn conn, int id, bool visible){
+		sprites.set_visible(id, visible);
+	});
+	server.register_handler("sprite_set_key", [&](rest_rpc::rpc_service::rpc_conn conn, int id, bool transparent,
+		ohtoai::rpi::LedColor key){
+		sprites.set_key(id, transparent, key);
+	});
+
 	std::thread render_thread = std::thread([&]{
 		while (true) {
-			if (auto_render)
-				strip.render();
+			try {
+				// scheduled tasks changed the frame, show it even without auto render
+				auto ran = scheduler.tick();
+				if (auto_render || ran)
+					present();
+			}
+			catch (const std::exception& e) {
+				spdlog::error("render: {}", e.what());
+			}
 			std::this_thread::sleep_for(std::chrono::milliseconds(10));
 		}
 	});
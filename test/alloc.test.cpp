@@ -0,0 +1,137 @@
+#include "render.hpp"
+#include "arena.hpp"
+#include "layer.hpp"
+#include "output.hpp"
+#include "sprite.hpp"
+#include "surface.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+// counting allocator, every heap allocation of the test process goes through here
+#include "counting_new.hpp"
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("Render path reaches zero allocations per frame", "[alloc]") {
+    WS2811Strip strip(16, 32);
+    SurfaceRegistry surfaces;
+    auto banner = surfaces.create("banner", 32, 8);
+    auto badge = surfaces.create("badge", 4, 4);
+    SpriteAtlas atlas(16, 16);
+    SpriteLayer sprites(atlas);
+    auto sprite = sprites.create(atlas.upload(2, 2, {Led::Red, Led::Green, Led::Blue, Led::White}), 0, 0);
+    const std::string text = "a text longer than the small string buffer";
+
+    // as present() does: layers and sprites go into copies of their targets, then through the output stage
+    Layer marquee{"", "banner"};
+    marquee.opacity = 192;
+    Layer overlay{"banner", "badge"};
+    LayerFrame<WS2811Strip> strip_frame;
+    LayerFrame<Pixmap> banner_frame;
+    // the damage path presents take while the strip and layers are unchanged, only its allocations matter here
+    LayerFrame<WS2811Strip> sprite_frame;
+    sprite_frame.load(strip);
+    sprites.draw_over(sprite_frame);
+    PanelCalibration calibration;
+    calibration.add(ColorCorrection({1, 0, 0, 0, 0.5f, 0, 0, 0, 1}, {0, 0, 0}), {0, 1, 2, 3});
+    strip.output().set_calibration(std::move(calibration));
+    strip.output().set_gamma(2.2f);
+    strip.output().set_dither(true);
+    strip.output().set_pixel_format(PixelFormatId::rgbw);
+    strip.output().set_power_budget(1000);
+    std::vector<LedColor> dma(strip.size());
+
+    auto frame = [&](int i) {
+        FrameArena::Scope scope(FrameArena::local());
+        banner->draw(Text4x8(text, Led::Blue, Led::Black, &scope.arena()), i % 8, 0);
+        badge->draw(DigitGroup3x5(i % 10).set_color(Led::Red), 0, 0);
+        strip.draw(DigitGroup3x5(i).set_color(Led::Red), 0, 8);
+
+        overlay.x = static_cast<float>(i % 28);
+        banner_frame.load(*banner);
+        compose(banner_frame, *badge, overlay);
+        marquee.scroll_x = static_cast<float>(i);
+        strip_frame.load(strip);
+        compose(strip_frame, banner_frame, marquee);
+
+        sprites.move(sprite, i % 8, i % 16);
+        sprites.draw_over(strip_frame);
+        strip.output().process(strip_frame.data(), dma.data(), strip_frame.size());
+
+        sprites.move(sprite, i % 16, i % 8);
+        sprites.compose(sprite_frame, strip);
+        strip.output().process(sprite_frame.data(), dma.data(), sprite_frame.size());
+    };
+
+    for (int i = 0; i < 8; ++i) {
+        frame(i);
+    }
+    auto before = AllocationCounter::count();
+    for (int i = 8; i < 64; ++i) {
+        frame(i);
+    }
+    REQUIRE(AllocationCounter::count() - before == 0);
+}
+
+TEST_CASE("Destroyed surfaces live on while they are referenced", "[alloc]") {
+    SurfaceRegistry surfaces(256);
+    auto held = surfaces.create("held", 8, 8);
+    const auto used = surfaces.arena().used();
+    REQUIRE(surfaces.destroy("held"));
+    REQUIRE_FALSE(surfaces.contains("held"));
+    held->led_ref(7, 7) = Led::Red;
+    REQUIRE(surfaces.arena().used() == used);
+    held.reset();
+    REQUIRE(surfaces.arena().used() < used);
+    // replacing a name keeps the old surface for whoever still draws it
+    auto old = surfaces.create("banner", 4, 4);
+    auto fresh = surfaces.create("banner", 4, 4);
+    REQUIRE(old != fresh);
+    REQUIRE(surfaces.get("banner") == fresh);
+    // a replacement that does not fit leaves the existing surface in place
+    old.reset();
+    REQUIRE_THROWS_AS(surfaces.create("banner", 16, 16), std::bad_alloc);
+    REQUIRE(surfaces.get("banner") == fresh);
+}
+
+TEST_CASE("Draws at negative offsets stay inside their surface", "[alloc]") {
+    // neighbours in the shared led arena, a write before the second surface would land in the first
+    SurfaceRegistry surfaces(256);
+    auto first = surfaces.create("first", 4, 4);
+    auto second = surfaces.create("second", 4, 4);
+    first->clear();
+    second->clear();
+    Pixmap red(4, 4, Led::Red);
+    red.clear();
+    IPaintDevice& device = *second;
+    device.draw(red, -2, -2);
+    device.draw(red, -2, 3, true, true);
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            REQUIRE(first->led(x, y) == Led::Black);
+            REQUIRE(second->led(x, y) == ((x < 2 && y < 2) || (x < 2 && y == 3) ? Led::Red : Led::Black));
+        }
+    }
+}
+
+TEST_CASE("Frame arena falls back to the heap when full", "[alloc]") {
+    FrameArena arena(64);
+    {
+        FrameArena::Scope scope(arena);
+        std::pmr::vector<LedColor> small(8, &scope.arena());
+        REQUIRE(arena.used() >= 32);
+        std::pmr::vector<LedColor> large(64, &scope.arena());
+        REQUIRE(arena.overflows() == 1);
+    }
+    REQUIRE(arena.used() == 0);
+}
+
+TEST_CASE("Led arena coalesces freed blocks", "[alloc]") {
+    LedArena arena(100);
+    auto a = arena.allocate(40);
+    auto b = arena.allocate(40);
+    REQUIRE_THROWS_AS(arena.allocate(40), std::bad_alloc);
+    arena.deallocate(a, 40);
+    arena.deallocate(b, 40);
+    REQUIRE(arena.used() == 0);
+    REQUIRE(arena.allocate(100) == a);
+}
@@ -0,0 +1,148 @@
+#include "audio.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <filesystem>
+
+using namespace ohtoai::rpi;
+
+namespace {
+    /// @brief 16 bit stereo wav with the same signal on both channels
+    std::string write_wav(const std::vector<float>& samples, int rate) {
+        auto path = (std::filesystem::temp_directory_path() / "ws2812_audio_test.wav").string();
+        auto file = std::fopen(path.c_str(), "wb");
+        auto u32 = [&](uint32_t v) { for (int i = 0; i < 4; ++i) std::fputc(v >> (i * 8) & 0xff, file); };
+        auto u16 = [&](uint16_t v) { std::fputc(v & 0xff, file); std::fputc(v >> 8, file); };
+        const uint32_t data = static_cast<uint32_t>(samples.size() * 4);
+        std::fputs("RIFF", file);
+        u32(36 + data);
+        std::fputs("WAVEfmt ", file);
+        u32(16); u16(1); u16(2); u32(rate); u32(rate * 4); u16(4); u16(16);
+        std::fputs("data", file);
+        u32(data);
+        for (float s : samples) {
+            const auto v = static_cast<uint16_t>(static_cast<int16_t>(s * 32767));
+            u16(v);
+            u16(v);
+        }
+        std::fclose(file);
+        return path;
+    }
+}
+
+TEST_CASE("Fft matches a direct DFT", "[audio]") {
+    constexpr size_t n = 16;
+    std::vector<std::complex<float>> data(n), expected(n);
+    for (size_t i = 0; i < n; ++i) {
+        data[i] = {std::sin(i * 1.3f) + 0.25f * static_cast<float>(i % 3), std::cos(i * 0.7f)};
+    }
+    for (size_t k = 0; k < n; ++k) {
+        for (size_t i = 0; i < n; ++i) {
+            expected[k] += data[i] * std::polar(1.0f, static_cast<float>(-2 * 3.14159265358979 * k * i / n));
+        }
+    }
+    Fft(n).transform(data.data());
+    for (size_t k = 0; k < n; ++k) {
+        REQUIRE(std::abs(data[k] - expected[k]) < 1e-3f);
+    }
+}
+
+TEST_CASE("TripleBuffer hands over the newest value", "[audio]") {
+    TripleBuffer<int> buffer;
+    REQUIRE(buffer.read() == 0);
+    buffer.back() = 1;
+    buffer.publish();
+    buffer.back() = 2;
+    buffer.publish();
+    REQUIRE(buffer.read() == 2);
+    REQUIRE(buffer.read() == 2);
+    buffer.back() = 3;
+    buffer.publish();
+    REQUIRE(buffer.read() == 3);
+}
+
+TEST_CASE("Spectrum and beats of a wav file", "[audio]") {
+    constexpr int rate = 44100;
+    std::vector<float> samples(rate * 3);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const float t = static_cast<float>(i) / rate;
+        samples[i] = 0.3f * std::sin(2 * 3.14159265f * 1000 * t);
+        // 100 ms kick drum every half second from 0.25 s
+        if (std::fmod(t + 0.25f, 0.5f) < 0.1f) {
+            samples[i] += 0.6f * std::sin(2 * 3.14159265f * 60 * t);
+        }
+    }
+    auto path = write_wav(samples, rate);
+
+    PcmReader reader(path);
+    std::atomic_bool stop = false;
+    REQUIRE(reader.read_header(stop));
+    REQUIRE(reader.format().sample_rate == rate);
+    REQUIRE(reader.format().channels == 2);
+
+    SpectrumAnalyzer analyzer(rate, 32);
+    std::vector<float> block(1000);
+    size_t total = 0;
+    Spectrum last;
+    for (size_t n; (n = reader.read(block.data(), block.size())) > 0; total += n) {
+        analyzer.push(block.data(), n, [&](const Spectrum& spectrum) { last = spectrum; });
+    }
+    REQUIRE(total == samples.size());
+    REQUIRE(reader.eof());
+    // the last block is kick free, the loudest band holds 1 kHz
+    const auto loudest = std::max_element(last.bands.begin(), last.bands.begin() + last.count) - last.bands.begin();
+    const float low = 40 * std::pow(16000.0f / 40, static_cast<float>(loudest) / 32);
+    const float high = 40 * std::pow(16000.0f / 40, static_cast<float>(loudest + 1) / 32);
+    REQUIRE(low <= 1050);
+    REQUIRE(high >= 950);
+    // a second of history first, then kicks at 1.25, 1.75, 2.25 and 2.75 s
+    REQUIRE(last.beats == 4);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("PcmReader skips odd, long and oversized chunks", "[audio]") {
+    auto path = (std::filesystem::temp_directory_path() / "ws2812_audio_chunks.wav").string();
+    auto write = [&](bool huge) {
+        auto file = std::fopen(path.c_str(), "wb");
+        auto u32 = [&](uint32_t v) { for (int i = 0; i < 4; ++i) std::fputc(v >> (i * 8) & 0xff, file); };
+        auto u16 = [&](uint16_t v) { std::fputc(v & 0xff, file); std::fputc(v >> 8, file); };
+        std::fputs("RIFFxxxxWAVE", file);
+        // odd sized, padded to 4 bytes
+        std::fputs("LIST", file);
+        u32(3);
+        std::fputs("abc_", file);
+        // longer than the 64 bytes kept of it
+        std::fputs("fmt ", file);
+        u32(100);
+        u16(1); u16(1); u32(8000); u32(16000); u16(2); u16(16);
+        for (int i = 16; i < 100; ++i) {
+            std::fputc(0, file);
+        }
+        if (huge) {
+            std::fputs("junk", file);
+            u32(0xffffffff);
+            std::fputs("only a few bytes follow", file);
+        }
+        std::fputs("data", file);
+        u32(2);
+        u16(0x1234);
+        std::fclose(file);
+    };
+    std::atomic_bool stop = false;
+    write(false);
+    {
+        PcmReader reader(path);
+        REQUIRE(reader.read_header(stop));
+        REQUIRE(reader.format().sample_rate == 8000);
+        REQUIRE(reader.format().channels == 1);
+        float sample = 0;
+        REQUIRE(reader.read(&sample, 1) == 1);
+        REQUIRE(sample == 0x1234 / 32768.0f);
+    }
+    // a chunk claiming 4 GB is read up to the end of the file, not allocated
+    write(true);
+    {
+        PcmReader reader(path);
+        REQUIRE_FALSE(reader.read_header(stop));
+    }
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,49 @@
+#include "color_space.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdlib>
+#include <vector>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("Hsv conversion hits the primaries", "[color]") {
+    REQUIRE(hsv_to_rgb({0, 255, 255}) == Led::Red);
+    REQUIRE(hsv_to_rgb({65536 / 3, 255, 255}) == Led::Green);
+    REQUIRE(hsv_to_rgb({65536 * 2 / 3, 255, 255}) == Led::Blue);
+    REQUIRE(hsv_to_rgb({12345, 0, 200}) == 0xc8c8c8);
+    REQUIRE(hsv_to_rgb({40000, 255, 0}) == Led::Black);
+
+    const Hsl hsl[3] = {{0, 255, 127}, {0, 255, 255}, {20000, 0, 100}};
+    LedColor colors[3];
+    hsl_to_rgb(hsl, colors, 3);
+    REQUIRE(colors[0] == 0xfe0000);
+    REQUIRE(colors[1] == Led::White);
+    REQUIRE(colors[2] == 0x646464);
+}
+
+TEST_CASE("Rgb to hsv round trips", "[color]") {
+    std::vector<LedColor> colors;
+    for (LedColor c = 0; c < 0x1000000; c += 0x010305) {
+        colors.push_back(c);
+    }
+    std::vector<Hsv> hsv(colors.size());
+    std::vector<LedColor> back(colors.size());
+    rgb_to_hsv(colors.data(), hsv.data(), colors.size());
+    hsv_to_rgb(hsv.data(), back.data(), back.size());
+    for (size_t i = 0; i < colors.size(); ++i) {
+        for (int shift : {0, 8, 16}) {
+            REQUIRE(std::abs(static_cast<int>((colors[i] >> shift) & 0xff) - static_cast<int>((back[i] >> shift) & 0xff)) <= 3);
+        }
+    }
+}
+
+TEST_CASE("Kelvin table spans warm to cool", "[color]") {
+    auto warm = kelvin_to_rgb(2000);
+    auto daylight = kelvin_to_rgb(6600);
+    auto cool = kelvin_to_rgb(20000);
+    REQUIRE((warm >> 16) == 0xff);
+    REQUIRE((warm & 0xff) < 0x40);
+    REQUIRE((daylight >> 16) >= 0xf0);
+    REQUIRE((daylight & 0xff) >= 0xf0);
+    REQUIRE((cool & 0xff) == 0xff);
+    REQUIRE((cool >> 16) < 0xc0);
+}
@@ -0,0 +1,85 @@
+#include "render.hpp"
+#include "static_pixmap.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+using namespace ohtoai::rpi;
+
+// virtual: the IPaintDevice::draw member, static: the ohtoai::rpi::draw template on concrete types
+
+TEST_CASE("Text4x8 onto WS2811Strip", "[benchmark]") {
+    WS2811Strip strip(16, 32);
+    if (strip.init() != WS2811_SUCCESS) {
+        WARN("no strip hardware, drawing into the framebuffer only");
+    }
+    strip.set_rotate(270);
+    Text4x8 text("Hello", Led::Blue);
+
+    BENCHMARK("virtual") {
+        strip.draw(text, 0, 4);
+        return strip.led(0, 4);
+    };
+    BENCHMARK("static") {
+        draw(strip, text, 0, 4);
+        return strip.led(0, 4);
+    };
+}
+
+TEST_CASE("Pixmap onto Window", "[benchmark]") {
+    Window window(16, 32);
+    Pixmap pixmap(8, 8, Led::Red);
+    pixmap.clear();
+
+    BENCHMARK("virtual") {
+        window.draw(pixmap, 4, 4);
+        return window.led(4, 4);
+    };
+    BENCHMARK("static") {
+        draw(window, pixmap, 4, 4);
+        return window.led(4, 4);
+    };
+}
+
+TEST_CASE("DigitGroup3x5 onto Pixmap", "[benchmark]") {
+    Pixmap pixmap(16, 32);
+    DigitGroup3x5 digits(12345, Led::Green);
+
+    BENCHMARK("virtual") {
+        pixmap.draw(digits, 0, 0);
+        return pixmap.led(0, 0);
+    };
+    BENCHMARK("static") {
+        draw(pixmap, digits, 0, 0);
+        return pixmap.led(0, 0);
+    };
+}
+
+TEST_CASE("Pixmap onto Pixmap", "[benchmark]") {
+    Pixmap dst(16, 32);
+    Pixmap src(16, 32, Led::Yellow);
+    src.clear();
+
+    BENCHMARK("virtual") {
+        dst.draw(src, 0, 0);
+        return dst.led(0, 0);
+    };
+    BENCHMARK("static") {
+        draw(dst, src, 0, 0);
+        return dst.led(0, 0);
+    };
+}
+
+TEST_CASE("StaticPixmap onto Pixmap", "[benchmark]") {
+    Pixmap dst(16, 32);
+    StaticPixmap<8, 8> src(Led::Cyan);
+    StaticPixmapSource erased(src);
+
+    BENCHMARK("virtual") {
+        dst.draw(erased, 4, 4);
+        return dst.led(4, 4);
+    };
+    BENCHMARK("static") {
+        draw(dst, src, 4, 4);
+        return dst.led(4, 4);
+    };
+}
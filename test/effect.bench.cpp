@@ -0,0 +1,47 @@
+#include "effects.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <chrono>
+#include <cstdio>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("Effects on a 64x64 canvas", "[benchmark]") {
+    constexpr int w = 64, h = 64;
+    for (auto kind : {"rainbow", "plasma", "fire", "twinkle", "noise", "life"}) {
+        auto effect = make_effect(kind, w, h);
+        uint32_t t = 0;
+        BENCHMARK(std::string(kind) + " frame") {
+            effect->advance(t += 16);
+            return effect->led(0, 0);
+        };
+
+        constexpr int frames = 200;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; ++i) {
+            effect->advance(t += 16);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        std::printf("%-8s %.2f ns/pixel\n", kind, elapsed.count() / frames / (w * h));
+    }
+}
+
+TEST_CASE("Pixel program on a 64x64 canvas", "[benchmark]") {
+    constexpr int w = 64, h = 64;
+    ProgramEffect effect(w, h, "d = hypot(x - w / 2, y - h / 2); hsv(fract(d / 16 - t), 1, 0.5 + 0.5 * sin(d - t * 4))");
+    effect.set_param("budget", 1e9);
+    uint32_t t = 0;
+    BENCHMARK("program frame") {
+        effect.advance(t += 16);
+        return effect.led(0, 0);
+    };
+}
+
+TEST_CASE("Life generations on a 256x256 grid", "[benchmark]") {
+    CellGrid grid(256, 256);
+    grid.randomize(80);
+    BENCHMARK("generation") {
+        grid.step();
+        return grid.get(0, 0);
+    };
+}
@@ -0,0 +1,83 @@
+#include "effect.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <limits>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("Stepper runs whole periods and caps a stall at a second", "[effect]") {
+    detail::Stepper stepper(16);
+    REQUIRE(stepper.steps(100) == 1);
+    REQUIRE(stepper.steps(110) == 0);
+    // the remainder carries over
+    REQUIRE(stepper.steps(100 + 16 * 5) == 5);
+    REQUIRE(stepper.steps(100 + 16 * 5 + 60000) == 1000 / 16);
+    // time going backwards restarts
+    REQUIRE(stepper.steps(5) == 1);
+}
+
+TEST_CASE("GradientNoise is mid grey on the lattice and spans the range between", "[effect]") {
+    GradientNoise noise(7);
+    int low = 255, high = 0;
+    for (uint32_t y = 0; y < 16 * 256; y += 37) {
+        for (uint32_t x = 0; x < 16 * 256; x += 41) {
+            const int v = noise(x, y, 300);
+            low = std::min(low, v);
+            high = std::max(high, v);
+        }
+    }
+    REQUIRE(low < 64);
+    REQUIRE(high > 192);
+    for (uint32_t i = 0; i < 8; ++i) {
+        REQUIRE(noise(i * 256, i * 512, 256) == 128);
+    }
+    REQUIRE(GradientNoise(7)(1000, 2000, 3000) == noise(1000, 2000, 3000));
+}
+
+TEST_CASE("FireEffect runs from black to white", "[effect]") {
+    constexpr int w = 4, h = 8;
+    FireEffect fire(w, h);
+    fire.set_param("cooling", 0);
+    fire.set_param("sparking", 255);
+    for (uint32_t t = 0; t < 1000; t += 16) {
+        fire.advance(t);
+    }
+    // the hottest end of the palette, red and green saturated first
+    for (int x = 0; x < w; ++x) {
+        REQUIRE(fire.led(x, h - 1) == 0xfffffd);
+    }
+    fire.set_param("cooling", 255);
+    fire.set_param("sparking", 0);
+    for (uint32_t t = 1000; t < 5000; t += 16) {
+        fire.advance(t);
+    }
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            REQUIRE(fire.led(x, y) == 0);
+        }
+    }
+    REQUIRE_THROWS_AS(fire.set_param("heat", 1), std::invalid_argument);
+}
+
+TEST_CASE("EffectRegistry hands effects out only under its lock", "[effect]") {
+    EffectRegistry effects;
+    effects.add("plasma", std::make_unique<PlasmaEffect>(8, 4));
+    REQUIRE(effects.contains("plasma"));
+    REQUIRE(effects.with("plasma", [](Effect& effect) { return effect.width() * effect.height(); }) == 32);
+    effects.with("plasma", [](Effect& effect) { effect.set_param("speed", 2); });
+    REQUIRE(effects.advance(EffectRegistry::Clock::now()) == 1);
+    REQUIRE(effects.destroy("plasma"));
+    REQUIRE_FALSE(effects.destroy("plasma"));
+    REQUIRE_THROWS_AS(effects.with("plasma", [](Effect&) {}), std::out_of_range);
+}
+
+TEST_CASE("Effect params reject values that are not finite and clamp the rest", "[effect]") {
+    RainbowEffect rainbow(4, 70000);
+    REQUIRE_THROWS_AS(rainbow.set_param("speed", std::numeric_limits<double>::quiet_NaN()), std::invalid_argument);
+    REQUIRE_THROWS_AS(rainbow.set_param("spread", std::numeric_limits<double>::infinity()), std::invalid_argument);
+    rainbow.set_param("speed", 1e300);
+    rainbow.set_param("spread", -1e300);
+    rainbow.advance(0xffffffff);
+    // clamped to -65536, a full turn per led: every column shows the hue of the first
+    REQUIRE(rainbow.led(3, 69999) == rainbow.led(0, 69999));
+}
@@ -0,0 +1,34 @@
+#include "filter.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <vector>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("Filters on a 128x64 canvas", "[benchmark]") {
+    constexpr int w = 128, h = 64;
+    std::vector<LedColor> frame(static_cast<size_t>(w) * h);
+    for (size_t i = 0; i < frame.size(); ++i) {
+        frame[i] = static_cast<LedColor>(i * 0x01030507);
+    }
+    Filter filter;
+
+    for (int radius : {1, 4, 16}) {
+        BENCHMARK("box blur radius " + std::to_string(radius)) {
+            filter.box_blur(frame.data(), w, h, radius);
+            return frame[0];
+        };
+    }
+    BENCHMARK("gaussian blur sigma 3") {
+        filter.gaussian_blur(frame.data(), w, h, 3.0);
+        return frame[0];
+    };
+    BENCHMARK("bloom") {
+        filter.bloom(frame.data(), w, h, 160, 2, 256);
+        return frame[0];
+    };
+    BENCHMARK("3x3 convolution") {
+        filter.convolve(frame.data(), w, h, {1, 2, 1, 2, 4, 2, 1, 2, 1});
+        return frame[0];
+    };
+}
@@ -0,0 +1,141 @@
+#include "effect.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <limits>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("box_blur_row averages with repeated edges", "[filter]") {
+    const LedColor row[] = {0, 0, 90, 0, 0, 0xff000000};
+    LedColor out[6];
+    box_blur_row(row, out, 6, 1);
+    REQUIRE(out[0] == 0);
+    REQUIRE(out[1] == 30);
+    REQUIRE(out[2] == 30);
+    REQUIRE(out[3] == 30);
+    REQUIRE(out[4] == 0x55000000);
+    // the border led counts twice
+    REQUIRE(out[5] == 0xaa000000);
+}
+
+TEST_CASE("Filter blurs keep flat frames flat and spread impulses symmetrically", "[filter]") {
+    constexpr int w = 9, h = 7;
+    Filter filter;
+    std::vector<LedColor> flat(w * h, 0x40808080);
+    filter.box_blur(flat.data(), w, h, 3, 3);
+    filter.gaussian_blur(flat.data(), w, h, 2.0);
+    for (auto c : flat) {
+        REQUIRE(c == 0x40808080);
+    }
+
+    std::vector<LedColor> dot(w * h, 0);
+    dot[3 * w + 4] = 0xff;
+    filter.box_blur(dot.data(), w, h, 1);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            const bool inside = std::abs(x - 4) <= 1 && std::abs(y - 3) <= 1;
+            REQUIRE(dot[y * w + x] == (inside ? 28u : 0u));
+        }
+    }
+}
+
+TEST_CASE("gaussian_boxes matches the variance of sigma", "[filter]") {
+    for (double sigma : {0.8, 1.5, 3.0, 7.0}) {
+        double variance = 0;
+        for (int r : Filter::gaussian_boxes(sigma)) {
+            variance += ((2.0 * r + 1) * (2.0 * r + 1) - 1) / 12;
+        }
+        REQUIRE(std::abs(std::sqrt(variance) - sigma) < 0.5);
+    }
+    // out of range sigmas are capped, not undefined
+    for (int r : Filter::gaussian_boxes(std::numeric_limits<double>::infinity())) {
+        REQUIRE(r >= Filter::max_radius / 2);
+    }
+    REQUIRE(Filter::gaussian_boxes(std::nan("")) == std::array<int, 3>{});
+}
+
+TEST_CASE("Filter convolve and bloom", "[filter]") {
+    constexpr int w = 5, h = 4;
+    Filter filter;
+    std::vector<LedColor> frame(w * h);
+    for (int i = 0; i < w * h; ++i) {
+        frame[i] = static_cast<LedColor>(i * 0x0a0b0c);
+    }
+    auto copy = frame;
+    filter.convolve(copy.data(), w, h, {0, 0, 0, 0, 1, 0, 0, 0, 0});
+    REQUIRE(copy == frame);
+    // a zero sum kernel divides by 1, flat areas go to the bias
+    std::vector<LedColor> flat(w * h, 0x00202020);
+    filter.convolve(flat.data(), w, h, {-1, -1, -1, -1, 8, -1, -1, -1, -1}, 0, 5);
+    REQUIRE(flat[7] == 0x05050505);
+    // shift right by one, reading the left neighbour
+    filter.convolve(copy.data(), w, h, {0, 0, 0, 1, 0, 0, 0, 0, 0});
+    REQUIRE(copy[1] == frame[0]);
+    REQUIRE(copy[w + 3] == frame[w + 2]);
+    REQUIRE(copy[w] == frame[w]);
+    // huge taps are clamped instead of overflowing: 1024 * 0x20 / 1 saturates, the bias cannot pull it down
+    std::vector<LedColor> extreme(w * h, 0x00202020);
+    filter.convolve(extreme.data(), w, h, {0, 0, 0, 0, 1 << 30, 0, 0, 0, 0}, 1, -(1 << 30));
+    REQUIRE(extreme[7] == 0x00ffffff);
+
+    // three box passes of radius 1 reach 3 leds from the highlight
+    std::vector<LedColor> glow(9 * 9, 0x00000010);
+    glow[4 * 9 + 4] = 0x00ff0010;
+    filter.bloom(glow.data(), 9, 9, 128, 1, 256);
+    REQUIRE((glow[4 * 9 + 4] >> 16) == 0xff);
+    REQUIRE((glow[4 * 9 + 3] >> 16 & 0xff) > 0);
+    // channels under the threshold are left alone
+    REQUIRE((glow[4 * 9 + 4] & 0xff) == 0x10);
+    REQUIRE((glow[0] >> 16 & 0xff) == 0);
+}
+
+TEST_CASE("Filter apply works in logical coordinates of rotated devices", "[filter]") {
+    Pixmap pixmap(4, 3);
+    pixmap.set_rotate(90);
+    REQUIRE(pixmap.width() == 3);
+    pixmap.led_ref(0, 0) = 1;
+    pixmap.led_ref(2, 0) = 2;
+    pixmap.led_ref(0, 3) = 3;
+    Filter filter;
+    filter.apply(pixmap, [](LedColor* leds, int w, int h) {
+        REQUIRE(w == 3);
+        REQUIRE(h == 4);
+        REQUIRE(leds[0] == 1);
+        REQUIRE(leds[2] == 2);
+        REQUIRE(leds[9] == 3);
+        leds[1] = 7;
+    });
+    REQUIRE(pixmap.led(1, 0) == 7);
+}
+
+namespace {
+    class DotEffect final : public Effect {
+    public:
+        DotEffect() : Effect(5, 5) {}
+    protected:
+        void render(uint32_t) override {
+            std::fill(frame_.begin(), frame_.end(), 0);
+            row(2)[2] = 0x00ffffff;
+        }
+    };
+}
+
+TEST_CASE("Effect blur and bloom params filter a copy of the frame", "[filter]") {
+    DotEffect effect;
+    effect.advance(0);
+    REQUIRE(effect.led(1, 2) == 0);
+    effect.set_param("blur", 1.0);
+    effect.advance(0);
+    effect.advance(0);
+    const auto once = effect.led(1, 2);
+    REQUIRE(once != 0);
+    // rendered afresh each time, the blur does not accumulate
+    effect.advance(0);
+    REQUIRE(effect.led(1, 2) == once);
+    effect.set_param("blur", 0);
+    effect.set_param("bloom", 1.0);
+    effect.advance(0);
+    REQUIRE(effect.led(2, 2) == 0x00ffffff);
+    REQUIRE(effect.led(1, 2) != 0);
+    REQUIRE_THROWS(effect.set_param("glow", 1));
+}
@@ -0,0 +1,153 @@
+#include "layer.hpp"
+#include "sprite.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <utility>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("compose wraps the scroll offset and blends translucent layers over the target", "[layer]") {
+    Pixmap src(2, 1);
+    src.led_ref(0, 0) = Led::Red;
+    src.led_ref(1, 0) = Led::Blue;
+    Pixmap dst(3, 1, Led::Black);
+    dst.clear();
+    Layer layer;
+    layer.x = 1;
+    layer.scroll_x = 3;
+    compose(dst, src, layer);
+    REQUIRE(dst.led(0, 0) == Led::Black);
+    REQUIRE(dst.led(1, 0) == Led::Blue);
+    REQUIRE(dst.led(2, 0) == Led::Red);
+
+    // the existing pixel shows through, not the background color
+    dst.led_ref(1, 0) = Led::Green;
+    layer.scroll_x = 0;
+    layer.opacity = 128;
+    compose(dst, src, layer);
+    REQUIRE(dst.led(1, 0) == mix(Led::Green, Led::Red, 128));
+    REQUIRE(dst.led(2, 0) == mix(Led::Red, Led::Blue, 128));
+}
+
+TEST_CASE("LayerFrame keeps translucency stable and moved layers leave no trail", "[layer]") {
+    Pixmap src(1, 1);
+    src.led_ref(0, 0) = Led::Red;
+    Pixmap target(4, 2, Led::Black);
+    target.set_rotate(90);
+    target.clear();
+    target.led_ref(1, 0) = Led::Green;
+    LayerFrame<Pixmap> frame;
+    Layer layer;
+    layer.opacity = 128;
+    for (int i = 0; i < 4; ++i) {
+        layer.x = static_cast<float>(i % 2);
+        frame.load(target);
+        compose(frame, src, layer);
+        REQUIRE(frame.led(i % 2, 0) == mix(i % 2 ? Led::Green : Led::Black, Led::Red, 128));
+        // the other position shows the target again
+        REQUIRE(frame.led(1 - i % 2, 0) == target.led(1 - i % 2, 0));
+    }
+    REQUIRE(target.led(0, 0) == Led::Black);
+    REQUIRE(target.led(1, 0) == Led::Green);
+    // strip order, as the frame is sent
+    REQUIRE(frame.data()[target.index(1, 0)] == mix(Led::Green, Led::Red, 128));
+}
+
+TEST_CASE("Sprites drawn over a LayerFrame never touch the target", "[layer]") {
+    SpriteAtlas atlas(4, 4);
+    SpriteLayer sprites(atlas);
+    const int image = atlas.upload(1, 1, {Led::Red});
+    const int sprite = sprites.create(image, 0, 0);
+    Pixmap target(2, 1, Led::Black);
+    target.clear();
+    LayerFrame<Pixmap> frame;
+    frame.load(target);
+    sprites.draw_over(frame);
+    REQUIRE(frame.led(0, 0) == Led::Red);
+    // the client draws beneath and the sprite moves, nothing stale comes back
+    target.led_ref(0, 0) = Led::Green;
+    sprites.move(sprite, 1, 0);
+    frame.load(target);
+    sprites.draw_over(frame);
+    REQUIRE(frame.led(0, 0) == Led::Green);
+    REQUIRE(frame.led(1, 0) == Led::Red);
+    REQUIRE(target.led(1, 0) == Led::Black);
+    sprites.destroy(sprite);
+    frame.load(target);
+    sprites.draw_over(frame);
+    REQUIRE(frame.led(1, 0) == Led::Black);
+    REQUIRE(sprites.size() == 0);
+}
+
+TEST_CASE("Rejected sprite uploads keep the current atlas shelf", "[layer]") {
+    SpriteAtlas atlas(4, 4);
+    atlas.upload(3, 2, std::vector<LedColor>(6, Led::Red));
+    REQUIRE_THROWS_AS(atlas.upload(5, 1, std::vector<LedColor>(5, Led::Red)), std::length_error);
+    // needs a new shelf that does not fit
+    REQUIRE_THROWS_AS(atlas.upload(2, 3, std::vector<LedColor>(6, Led::Red)), std::length_error);
+    const auto image = atlas.image(atlas.upload(1, 1, {Led::Blue}));
+    REQUIRE(image.x == 3);
+    REQUIRE(image.y == 0);
+    REQUIRE(*std::as_const(atlas).row(image, 0) == Led::Blue);
+}
+
+TEST_CASE("Sprite damage repaint matches a full redraw", "[layer]") {
+    SpriteAtlas atlas(8, 8);
+    SpriteLayer sprites(atlas);
+    const int square = atlas.upload(2, 2, {Led::Red, Led::Green, Led::Blue, Led::White});
+    const int bar = atlas.upload(3, 1, {Led::Blue, Led::Black, Led::Blue});
+    const int a = sprites.create(square, 0, 0, 1);
+    const int b = sprites.create(bar, 1, 1, 2);
+    const int c = sprites.create(square, 4, 2);
+    sprites.set_key(b, true, Led::Black);
+
+    Pixmap base(6, 4, Led::Black);
+    for (int i = 0; i < 24; ++i) {
+        base.led_ref(i % 6, i / 6) = static_cast<LedColor>(0x010203 * i);
+    }
+    LayerFrame<Pixmap> damaged;
+    damaged.load(base);
+    sprites.draw_over(damaged);
+    REQUIRE(sprites.compose(damaged, base) == 0);
+
+    auto expect_full = [&] {
+        // a separate layer with the same sprites, drawn from scratch
+        SpriteLayer reference(atlas);
+        LayerFrame<Pixmap> full;
+        full.load(base);
+        for (int id : {a, b, c}) {
+            try {
+                const auto s = sprites.sprite(id);
+                const int copy = reference.create(s.image, s.x, s.y, s.z);
+                reference.set_key(copy, s.transparent, s.key);
+                reference.set_flip(copy, s.flip_x, s.flip_y);
+                reference.set_visible(copy, s.visible);
+            }
+            catch (const std::out_of_range&) {
+            }
+        }
+        reference.draw_over(full);
+        for (int y = 0; y < 4; ++y) {
+            for (int x = 0; x < 6; ++x) {
+                REQUIRE(damaged.led(x, y) == full.led(x, y));
+            }
+        }
+    };
+
+    sprites.move(a, 1, 1);
+    // the old and the new area, each restored in full
+    REQUIRE(sprites.compose(damaged, base) == 8);
+    expect_full();
+    sprites.set_z(b, 0);
+    sprites.set_flip(c, true, false);
+    sprites.compose(damaged, base);
+    expect_full();
+    sprites.move(c, 5, 3);
+    sprites.set_visible(a, false);
+    sprites.compose(damaged, base);
+    expect_full();
+    sprites.destroy(b);
+    sprites.set_image(c, bar);
+    sprites.move(c, -1, 0);
+    sprites.compose(damaged, base);
+    expect_full();
+}
@@ -0,0 +1,47 @@
+#include "life.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("Blinker oscillates across a word boundary", "[life]") {
+    CellGrid grid(100, 5);
+    grid.set(63, 2, true);
+    grid.set(64, 2, true);
+    grid.set(65, 2, true);
+    grid.step();
+    REQUIRE(grid.population() == 3);
+    REQUIRE(grid.get(64, 1));
+    REQUIRE(grid.get(64, 2));
+    REQUIRE(grid.get(64, 3));
+    grid.step();
+    REQUIRE(grid.get(63, 2));
+    REQUIRE(grid.get(65, 2));
+}
+
+TEST_CASE("Glider wraps around the edges", "[life]") {
+    for (int width : {10, 64, 70}) {
+        CellGrid grid(width, 10);
+        // heading down and right
+        grid.set(1, 0, true);
+        grid.set(2, 1, true);
+        grid.set(0, 2, true);
+        grid.set(1, 2, true);
+        grid.set(2, 2, true);
+        // every 4 generations it moves one cell diagonally, width * 4 brings it back on x
+        for (int i = 0; i < 4 * width * 10; ++i) {
+            grid.step();
+        }
+        REQUIRE(grid.population() == 5);
+        REQUIRE(grid.get(1, 0));
+        REQUIRE(grid.get(2, 2));
+    }
+
+    CellGrid walled(10, 10);
+    walled.set_wrap(false);
+    walled.set_rule("B3/S23");
+    walled.set(0, 0, true);
+    walled.set(9, 0, true);
+    walled.set(0, 9, true);
+    walled.step();
+    REQUIRE(walled.population() == 0);
+}
@@ -0,0 +1,36 @@
+#include "output.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <vector>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("Output stage on a 2048 led canvas", "[benchmark]") {
+    constexpr size_t leds = 2048;
+    std::vector<LedColor> frame(leds);
+    for (size_t i = 0; i < leds; ++i) {
+        frame[i] = static_cast<LedColor>(i * 0x010203);
+    }
+    std::vector<LedColor> dma(leds);
+    OutputPipeline output;
+
+    BENCHMARK("identity") {
+        output.process(frame.data(), dma.data(), leds);
+        return dma[0];
+    };
+    output.set_brightness(100);
+    BENCHMARK("brightness") {
+        output.process(frame.data(), dma.data(), leds);
+        return dma[0];
+    };
+    output.set_gamma(2.2f);
+    BENCHMARK("gamma lut") {
+        output.process(frame.data(), dma.data(), leds);
+        return dma[0];
+    };
+    output.set_dither(true);
+    BENCHMARK("gamma lut with temporal dither") {
+        output.process(frame.data(), dma.data(), leds);
+        return dma[0];
+    };
+}
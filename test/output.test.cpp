@@ -0,0 +1,225 @@
+#include "output.hpp"
+#include "hdr.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace ohtoai::rpi;
+
+namespace {
+    LedColor lookup(const ColorLut& lut, LedColor c) {
+        return (static_cast<LedColor>(lut.table(0)[c >> 24]) << 24)
+            | (static_cast<LedColor>(lut.table(1)[(c >> 16) & 0xff]) << 16)
+            | (static_cast<LedColor>(lut.table(2)[(c >> 8) & 0xff]) << 8)
+            | lut.table(3)[c & 0xff];
+    }
+
+    std::vector<LedColor> ramp() {
+        std::vector<LedColor> colors;
+        for (LedColor i = 0; i < 256; ++i) {
+            colors.push_back(i << 24 | (255 - i) << 16 | i << 8 | (i * 7 & 0xff));
+        }
+        return colors;
+    }
+}
+
+TEST_CASE("Color lut defaults to identity", "[output]") {
+    ColorLut lut;
+    REQUIRE(lut.identity());
+    auto src = ramp();
+    std::vector<LedColor> dst(src.size());
+    lut.apply(src.data(), dst.data(), src.size());
+    REQUIRE(dst == src);
+}
+
+TEST_CASE("Color lut linear path matches its tables", "[output]") {
+    ColorLut lut;
+    lut.set_brightness(128);
+    lut.set_white_balance(255, 200, 100);
+    REQUIRE_FALSE(lut.identity());
+    auto src = ramp();
+    std::vector<LedColor> dst(src.size());
+    lut.apply(src.data(), dst.data(), src.size());
+    for (size_t i = 0; i < src.size(); ++i) {
+        REQUIRE(dst[i] == lookup(lut, src[i]));
+    }
+    REQUIRE(lut.table(1)[255] == 128);
+}
+
+TEST_CASE("Color lut gamma keeps the end points", "[output]") {
+    ColorLut lut;
+    lut.set_gamma(2.2f);
+    REQUIRE(lut.table(1)[0] == 0);
+    REQUIRE(lut.table(1)[255] == 255);
+    REQUIRE(lut.table(1)[128] < 64);
+    REQUIRE_THROWS_AS(lut.set_gamma(0), std::invalid_argument);
+}
+
+TEST_CASE("Temporal dither averages to the wide value", "[output]") {
+    ColorLut lut;
+    lut.set_brightness(40);
+    TemporalDither dither;
+    std::vector<LedColor> src = {0x00030303, 0x00ff8001};
+    std::vector<uint16_t> wide(4 * src.size());
+    std::vector<LedColor> dst(src.size());
+    lut.expand(src.data(), wide.data(), src.size());
+
+    std::vector<uint32_t> sums(4 * src.size());
+    for (int frame = 0; frame < 256; ++frame) {
+        dither.quantize(wide.data(), dst.data(), src.size());
+        for (size_t i = 0; i < src.size(); ++i) {
+            for (int k = 0; k < 4; ++k) {
+                sums[4 * i + k] += (dst[i] >> (8 * k)) & 0xff;
+            }
+        }
+    }
+    for (size_t i = 0; i < sums.size(); ++i) {
+        REQUIRE(sums[i] == wide[i]);
+    }
+}
+
+TEST_CASE("Tone mapper is linear up to unity and rolls off towards white above", "[output]") {
+    std::vector<uint16_t> src, dst;
+    for (uint32_t v = 0; v <= 0xffff; v += 64) {
+        // red only, white channel alongside
+        src.insert(src.end(), {0, 0, static_cast<uint16_t>(v), static_cast<uint16_t>(std::min<uint32_t>(v, 0xffff))});
+    }
+    dst.resize(src.size());
+    ToneMapper::map(src.data(), dst.data(), src.size() / 4);
+    for (size_t i = 0; i < src.size(); i += 4) {
+        const uint32_t red = src[i + 2];
+        if (red <= ToneMapper::unity) {
+            REQUIRE(dst[i + 2] == red * 255 / 32);
+            REQUIRE(dst[i] == 0);
+        }
+        else {
+            REQUIRE(dst[i + 2] == 0xff00);
+            // the excess bleeds into the other channels, monotonically and never all the way to white
+            REQUIRE(dst[i] >= dst[i - 4]);
+            REQUIRE(dst[i] < 0xff00);
+        }
+        REQUIRE(dst[i] == dst[i + 1]);
+        REQUIRE(dst[i + 3] <= 0xff00);
+    }
+    REQUIRE(dst[dst.size() - 4] > 0x7000);
+}
+
+TEST_CASE("Promoted 8 bit white presents as 255 through the hdr path", "[output]") {
+    HdrPixmap hdr(1, 1);
+    hdr.set(0, 0, 0xffffffff);
+    std::vector<uint16_t> wide(4);
+    ToneMapper::map(hdr.data().data(), wide.data(), 1);
+    for (auto v : wide) {
+        REQUIRE(v == 0xff00);
+    }
+    hdr.set(0, 0, 0x00804020);
+    ToneMapper::map(hdr.data().data(), wide.data(), 1);
+    REQUIRE((wide[2] + 0x80) >> 8 == 0x80);
+    REQUIRE((wide[1] + 0x80) >> 8 == 0x40);
+    REQUIRE((wide[0] + 0x80) >> 8 == 0x20);
+}
+
+TEST_CASE("Large hdr gains saturate instead of wrapping", "[output]") {
+    HdrPixmap hdr(1, 1);
+    for (uint32_t gain : {65536u, 600000u, 0xffffffffu}) {
+        hdr.clear();
+        hdr.add(0, 0, 0x00ff00ff, gain);
+        const auto p = hdr.pixel(0, 0);
+        REQUIRE(p[0] == 0xffff);
+        REQUIRE(p[1] == 0);
+        REQUIRE(p[2] == 0xffff);
+        REQUIRE(p[3] == 0);
+    }
+}
+
+TEST_CASE("Pixel formats pack and extract white", "[output]") {
+    STATIC_REQUIRE(PixelGrb::pack(0x11, 0x22, 0x33) == 0x221133);
+    STATIC_REQUIRE(PixelGrbw::pack(0x11, 0x22, 0x33, 0x44) == 0x22113344);
+    STATIC_REQUIRE(PixelBrg::unpack(0x331122)[2] == 0x33);
+    STATIC_REQUIRE(PixelRgbw::convert(0x00ff8040) == 0x40bf4000);
+    STATIC_REQUIRE(PixelGrb::convert(0x00ff8040) == 0x00ff8040);
+    STATIC_REQUIRE(PixelWwa::convert(0x00ffffff) == 0x0000ff00);
+
+    std::vector<LedColor> colors = {0x00ffffff, 0x00102030, 0x10000000};
+    convert_pixels(PixelFormatId::rgbw, colors.data(), colors.data(), colors.size());
+    REQUIRE(colors == std::vector<LedColor>{0xff000000, 0x10001020, 0x10000000});
+}
+
+TEST_CASE("Power limiter scales down at once and recovers gradually", "[output]") {
+    PowerLimiter limiter;
+    limiter.set_model(20, 20, 20, 20, 1);
+    std::vector<LedColor> white(512, 0x00ffffff);
+    // 512 leds * (60 mA + 1 mA idle)
+    REQUIRE(std::abs(limiter.estimate(white.data(), white.size()) - 512 * 61.0f) < 1);
+
+    limiter.set_budget(10000);
+    auto frame = white;
+    limiter.limit(frame.data(), frame.size());
+    REQUIRE(limiter.scale() < 256);
+    REQUIRE(limiter.milliamps() <= 10000);
+    REQUIRE(limiter.estimate(frame.data(), frame.size()) <= 10000);
+
+    // a dark frame lets it ramp back, one step per frame
+    std::vector<LedColor> dark(512, 0x00101010);
+    auto scale = limiter.scale();
+    frame = dark;
+    limiter.limit(frame.data(), frame.size());
+    REQUIRE(limiter.scale() == scale + PowerLimiter::recover_step);
+    for (int i = 0; i < 256; ++i) {
+        frame = dark;
+        limiter.limit(frame.data(), frame.size());
+    }
+    REQUIRE(limiter.scale() == 256);
+    REQUIRE(frame == dark);
+}
+
+TEST_CASE("Power limiter blanks frames when the budget is below the idle current", "[output]") {
+    PowerLimiter limiter;
+    limiter.set_model(20, 20, 20, 20, 1);
+    // 2048 leds idle at 2048 mA
+    limiter.set_budget(1000);
+
+    std::vector<LedColor> black(2048, 0);
+    auto frame = black;
+    limiter.limit(frame.data(), frame.size());
+    REQUIRE(limiter.scale() == 0);
+    REQUIRE(frame == black);
+
+    std::vector<LedColor> white(2048, 0x00ffffff);
+    frame = white;
+    limiter.limit(frame.data(), frame.size());
+    REQUIRE(limiter.scale() == 0);
+    REQUIRE(frame == black);
+}
+
+TEST_CASE("Panel calibration corrects only its own leds", "[output]") {
+    ColorCorrection dim_green({1, 0, 0, 0, 0.5f, 0, 0, 0, 1}, {0, 0, 0});
+    ColorCorrection swap({0, 1, 0, 1, 0, 0, 0, 0, 1}, {0, 0, 10});
+    REQUIRE(dim_green.diagonal());
+    REQUIRE(!swap.diagonal());
+
+    PanelCalibration calibration;
+    calibration.add(dim_green, {0, 1, 2, 3});
+    calibration.add(swap, {6, 7});
+    REQUIRE(calibration.runs() == 2);
+
+    std::vector<LedColor> leds(8, 0x11806040);
+    calibration.apply(leds.data(), leds.size());
+    REQUIRE(leds[0] == 0x11803040);
+    REQUIRE(leds[5] == 0x11806040);
+    REQUIRE(leds[7] == 0x1160804a);
+}
+
+TEST_CASE("Color correction rejects non-finite values and clamps huge ones", "[output]") {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float inf = std::numeric_limits<float>::infinity();
+    REQUIRE_THROWS_AS(ColorCorrection({nan, 0, 0, 0, 1, 0, 0, 0, 1}, {0, 0, 0}), std::invalid_argument);
+    REQUIRE_THROWS_AS(ColorCorrection({1, 0, 0, 0, 1, 0, 0, 0, 1}, {0, inf, 0}), std::invalid_argument);
+
+    ColorCorrection huge({1e30f, 1e30f, 1e30f, -1e30f, -1e30f, -1e30f, 0, 0, 1}, {0, 0, 1e30f});
+    std::vector<LedColor> leds = {0x00ffffff, 0x00010101};
+    huge.apply(leds.data(), leds.size());
+    REQUIRE(leds[0] == 0x00ff00ff);
+    REQUIRE(leds[1] == 0x003000ff);
+}
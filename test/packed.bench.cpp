@@ -0,0 +1,34 @@
+#include "packed.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <vector>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("Packed 24 bit storage on a 128x64 canvas", "[benchmark]") {
+    constexpr int w = 128, h = 64;
+    Pixmap wide(w, h);
+    PackedPixmap packed(w, h);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            wide.led_ref(x, y) = static_cast<LedColor>((y * w + x) * 0x010203 & 0xffffff);
+        }
+    }
+    packed.draw(wide, 0, 0);
+    Pixmap out(w, h);
+    // 32 KiB against 24 KiB of surface memory
+    REQUIRE(packed.bytes() * 4 == wide.size() * sizeof(LedColor) * 3);
+
+    BENCHMARK("copy 32 bit surface, 32 KiB") {
+        std::copy_n(wide.data(), wide.size(), out.data());
+        return out.data()[0];
+    };
+    BENCHMARK("unpack 24 bit surface, 24 KiB") {
+        packed.unpack(out);
+        return out.data()[0];
+    };
+    BENCHMARK("pack into 24 bit surface") {
+        packed.draw(wide, 0, 0);
+        return packed.row(0)[0];
+    };
+}
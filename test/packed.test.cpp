@@ -0,0 +1,54 @@
+#include "packed.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("Packed surface round trips rgb", "[packed]") {
+    PackedPixmap packed(7, 3, 0x123456);
+    REQUIRE(packed.led(6, 2) == 0x123456);
+    Pixmap wide(7, 3);
+    for (int i = 0; i < 21; ++i) {
+        wide.led_ref(i % 7, i / 7) = static_cast<LedColor>(0xff000000 | i * 0x0a0b0c);
+    }
+    packed.draw(wide, 0, 0);
+    Pixmap out(7, 3);
+    packed.unpack(out);
+    for (int i = 0; i < 21; ++i) {
+        REQUIRE(out.led(i % 7, i / 7) == (wide.led(i % 7, i / 7) & 0xffffff));
+    }
+}
+
+TEST_CASE("Replaced packed surfaces live on while they are referenced", "[packed]") {
+    PackedSurfaceRegistry packed;
+    auto first = packed.create("logo", 4, 2, 0x010203);
+    packed.create("logo", 8, 2, 0x040506);
+    REQUIRE(first->led(3, 1) == 0x010203);
+    REQUIRE(packed.get("logo")->width() == 8);
+    REQUIRE(packed.destroy("logo"));
+    REQUIRE_THROWS_AS(packed.get("logo"), std::out_of_range);
+    REQUIRE_THROWS_AS(packed.create("logo", 0, 2), std::invalid_argument);
+    REQUIRE_THROWS_AS(packed.get("logo"), std::out_of_range);
+}
+
+TEST_CASE("Packed surface takes concurrent draws into disjoint rectangles", "[packed]") {
+    // wider than one conversion chunk, as rpc handlers on several threads may draw into one surface
+    PackedPixmap packed(200, 4);
+    Pixmap red(100, 4, Led::Red), blue(100, 4, Led::Blue);
+    red.clear();
+    blue.clear();
+    auto draw = [&](const Pixmap& src, int x) {
+        for (int i = 0; i < 200; ++i) {
+            packed.draw(src, x, 0);
+        }
+    };
+    std::thread left(draw, std::cref(red), 0);
+    std::thread right(draw, std::cref(blue), 100);
+    left.join();
+    right.join();
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 200; ++x) {
+            REQUIRE(packed.led(x, y) == (x < 100 ? Led::Red : Led::Blue));
+        }
+    }
+}
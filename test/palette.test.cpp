@@ -0,0 +1,43 @@
+#include "palette.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("Palette cycling rotates colors without touching indices", "[palette]") {
+    IndexedPixmap pixmap(4, 1);
+    pixmap.set_palette({Led::Red, Led::Green, Led::Blue, Led::White});
+    pixmap.set_indices({0, 1, 2, 3});
+    pixmap.cycle_palette(0, 2, 1);
+    REQUIRE(pixmap.led(0, 0) == Led::Blue);
+    REQUIRE(pixmap.led(1, 0) == Led::Red);
+    REQUIRE(pixmap.led(2, 0) == Led::Green);
+    REQUIRE(pixmap.led(3, 0) == Led::White);
+
+    Pixmap expanded(4, 1);
+    pixmap.expand(expanded);
+    for (int x = 0; x < 4; ++x) {
+        REQUIRE(expanded.led(x, 0) == pixmap.led(x, 0));
+    }
+}
+
+TEST_CASE("Floyd-Steinberg keeps the average of a flat grey", "[palette]") {
+    constexpr int w = 32, h = 32;
+    IndexedPixmap pixmap(w, h);
+    pixmap.set_palette({Led::Black, Led::White});
+    std::vector<LedColor> grey(w * h, 0x404040);
+
+    pixmap.quantize(grey, false);
+    for (auto index : pixmap.indices()) {
+        REQUIRE(index == 0);
+    }
+
+    pixmap.quantize(grey, true);
+    int white = 0;
+    for (auto index : pixmap.indices()) {
+        white += index;
+    }
+    // 0x40 / 0xff of the leds lit
+    REQUIRE(white > w * h * 20 / 100);
+    REQUIRE(white < w * h * 30 / 100);
+}
@@ -0,0 +1,37 @@
+#include "particles.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <vector>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("Particle integration and splatting on a 128x64 canvas", "[benchmark]") {
+    constexpr int w = 128, h = 64;
+    std::vector<LedColor> frame(static_cast<size_t>(w) * h);
+    for (size_t count : {1000, 10000, 100000}) {
+        Emitter emitter;
+        emitter.w = w;
+        emitter.h = h;
+        // lives far longer than the benchmark runs, so the count stays put
+        emitter.life_min = emitter.life_max = 1e9f;
+
+        ParticleSystem particles(count);
+        particles.set_gravity(0, 20);
+        particles.burst(emitter, count);
+        REQUIRE(particles.size() == count);
+        BENCHMARK(fmt::format("update {} particles", count)) {
+            particles.update(1.0f / 60);
+            return particles.size();
+        };
+
+        // a pool of its own that is never updated, at rest on the canvas, so every particle is written
+        ParticleSystem resting(count);
+        emitter.speed_min = emitter.speed_max = 0;
+        resting.burst(emitter, count);
+        REQUIRE(resting.size() == count);
+        BENCHMARK(fmt::format("splat {} particles", count)) {
+            resting.splat(frame.data(), w, h);
+            return frame[0];
+        };
+    }
+}
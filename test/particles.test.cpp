@@ -0,0 +1,78 @@
+#include "particles.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <limits>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("add_saturate clamps every channel", "[particles]") {
+    for (uint32_t a = 0; a < 256; a += 5) {
+        for (uint32_t b = 0; b < 256; b += 3) {
+            const LedColor x = a | (255 - a) << 8 | b << 16 | (a ^ b) << 24;
+            const LedColor y = b | a << 8 | (255 - b) << 16 | b << 24;
+            const auto sum = add_saturate(x, y);
+            for (int shift = 0; shift < 32; shift += 8) {
+                const auto expected = std::min<uint32_t>(255, (x >> shift & 0xff) + (y >> shift & 0xff));
+                REQUIRE((sum >> shift & 0xff) == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("ParticleSystem integrates, expires and respects its capacity", "[particles]") {
+    ParticleSystem particles(3);
+    particles.set_gravity(0, 10);
+    REQUIRE(particles.spawn(1, 1, 2, 0, 1.0f, Led::Red, Led::Red));
+    REQUIRE(particles.spawn(0, 0, 0, 0, 0.25f, Led::Blue, Led::Blue));
+    REQUIRE(particles.spawn(0, 0, 0, 0, 2.0f, Led::Green, Led::Green));
+    REQUIRE_FALSE(particles.spawn(0, 0, 0, 0, 1.0f, Led::White, Led::White));
+    REQUIRE(particles.dropped() == 1);
+
+    particles.update(0.5f);
+    // the short lived one is swapped out, the rest stay packed
+    REQUIRE(particles.size() == 2);
+    std::vector<LedColor> frame(8 * 8);
+    particles.splat(frame.data(), 8, 8);
+    // semi implicit Euler, velocity first: x = 1 + 2 * 0.5, y = 1 + 5 * 0.5
+    REQUIRE(frame[3 * 8 + 2] == Led::Red);
+    REQUIRE(frame[2 * 8 + 0] == Led::Green);
+
+    // additive on top of what is there
+    particles.splat(frame.data(), 8, 8);
+    REQUIRE(frame[3 * 8 + 2] == Led::Red);
+    particles.update(0.5f);
+    REQUIRE(particles.size() == 1);
+}
+
+TEST_CASE("ParticleSystem splat skips positions that do not fit an int", "[particles]") {
+    ParticleSystem particles(4);
+    REQUIRE(particles.spawn(1e30f, 0, 0, 0, 1.0f, Led::Red, Led::Red));
+    REQUIRE(particles.spawn(0, -1e30f, 0, 0, 1.0f, Led::Red, Led::Red));
+    REQUIRE(particles.spawn(std::numeric_limits<float>::quiet_NaN(), 0, 0, 0, 1.0f, Led::Red, Led::Red));
+    REQUIRE(particles.spawn(0, std::numeric_limits<float>::infinity(), 0, 0, 1.0f, Led::Red, Led::Red));
+    std::vector<LedColor> frame(8 * 8);
+    particles.splat(frame.data(), 8, 8);
+    for (const auto led : frame) {
+        REQUIRE(led == 0);
+    }
+}
+
+TEST_CASE("Huge emission rates are bounded by the pool", "[particles]") {
+    ParticleSystem particles(16);
+    Emitter emitter;
+    float carry = 0;
+    emitter.rate = 1e20f;
+    particles.emit(emitter, 1.0f, carry);
+    REQUIRE(particles.size() == 16);
+    emitter.rate = std::numeric_limits<float>::infinity();
+    particles.emit(emitter, 1.0f, carry);
+    REQUIRE(carry < 1);
+
+    for (bool fireworks : {true, false}) {
+        ParticleEffect effect(16, 8, fireworks, 256);
+        effect.set_param("rate", 1e300);
+        effect.advance(0);
+        effect.advance(100);
+        effect.advance(200);
+        REQUIRE(effect.particles().size() <= 256);
+    }
+}
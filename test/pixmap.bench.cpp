@@ -0,0 +1,36 @@
+#include "render.hpp"
+#include "static_pixmap.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("StaticPixmap against Pixmap", "[benchmark]") {
+    StaticPixmap<8, 8> icon(Led::Red);
+    Pixmap dynamic_icon(8, 8, Led::Red);
+    dynamic_icon.clear();
+    StaticPixmap<16, 32> static_panel;
+    Pixmap dynamic_panel(16, 32);
+    StaticPixmapSource icon_source(icon);
+
+    BENCHMARK("Pixmap 8x8 onto Pixmap 16x32") {
+        dynamic_panel.draw(dynamic_icon, 4, 4);
+        return dynamic_panel.led(4, 4);
+    };
+    BENCHMARK("StaticPixmap 8x8 onto StaticPixmap 16x32") {
+        static_panel.draw(icon, 4, 4);
+        return static_panel.led(4, 4);
+    };
+    BENCHMARK("StaticPixmap 8x8 onto Pixmap 16x32 through adapter") {
+        dynamic_panel.draw(icon_source, 4, 4);
+        return dynamic_panel.led(4, 4);
+    };
+    BENCHMARK("Pixmap 16x32 clear") {
+        dynamic_panel.clear();
+        return dynamic_panel.led(0, 0);
+    };
+    BENCHMARK("StaticPixmap 16x32 clear") {
+        static_panel.clear();
+        return static_panel.led(0, 0);
+    };
+}
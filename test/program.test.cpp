@@ -0,0 +1,71 @@
+#include "program.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+
+using namespace ohtoai::rpi;
+
+namespace {
+    std::vector<LedColor> run(const std::string& source, int w = 4, int y = 0, float t = 0) {
+        PixelProgram program(source);
+        std::vector<LedColor> row(w);
+        program.run_row(row.data(), w, 4, y, t);
+        return row;
+    }
+}
+
+TEST_CASE("PixelProgram evaluates rows", "[program]") {
+    REQUIRE(run("1")[0] == 0xffffff);
+    REQUIRE(run("rgb(x / (w - 1), 0, y / 4)", 4, 2) == std::vector<LedColor>{0x00007f, 0x55007f, 0xaa007f, 0xff007f});
+    REQUIRE(run("a = 0.5; b = a * 2; rgb(b, a - a, -1)")[0] == 0xff0000);
+    REQUIRE(run("hsv(1 / 3, 1, 1)")[0] == hsv_to_rgb({21845, 255, 255}));
+    REQUIRE(run("rgb(step(2, x), clamp(x - 1, 0, 1), mix(0, 1, t))", 4, 0, 1) == std::vector<LedColor>{0x0000ff, 0x0000ff, 0xffffff, 0xffffff});
+    // 2 ^ 3 * 2 / 16 = 1, and x % 2
+    REQUIRE(run("rgb(2 ^ 3 * 2 / 16, x % 2, 0)", 2) == std::vector<LedColor>{0xff0000, 0xffff00});
+}
+
+TEST_CASE("PixelProgram stays in its sandbox", "[program]") {
+    // division by zero and NaN turn black instead of faulting
+    REQUIRE(run("1 / 0")[0] == 0);
+    REQUIRE(run("sqrt(-1) * 0 + (0 / 0)")[0] == 0);
+    REQUIRE_THROWS_AS(PixelProgram("x = 1; x"), std::invalid_argument);
+    REQUIRE_THROWS_AS(PixelProgram("pi = 1; pi"), std::invalid_argument);
+    REQUIRE_THROWS_AS(PixelProgram("rgb(1, 2)"), std::invalid_argument);
+    REQUIRE_THROWS_AS(PixelProgram("exec(1)"), std::invalid_argument);
+    REQUIRE_THROWS_AS(PixelProgram("q + 1"), std::invalid_argument);
+    REQUIRE_THROWS_AS(PixelProgram("1 1"), std::invalid_argument);
+    REQUIRE_THROWS_AS(PixelProgram(std::string(1000, '(') + "1" + std::string(1000, ')')), std::invalid_argument);
+    // unary minus and power chains recurse without emitting, long ones must fail instead of overflowing the stack
+    REQUIRE_THROWS_AS(PixelProgram(std::string(200000, '-') + "1"), std::invalid_argument);
+    std::string powers = "1";
+    for (int i = 0; i < 100000; ++i) {
+        powers += "^1";
+    }
+    REQUIRE_THROWS_AS(PixelProgram(powers), std::invalid_argument);
+    REQUIRE(run("--1")[0] == 0xffffff);
+    std::string long_program = "x";
+    for (int i = 0; i < 300; ++i) {
+        long_program += " + x";
+    }
+    REQUIRE_THROWS_AS(PixelProgram(long_program), std::invalid_argument);
+}
+
+TEST_CASE("ProgramEffect spreads a frame over ticks within its budget", "[program]") {
+    ProgramEffect effect(4, 4, "t");
+    // one instruction free program, so a row costs its width
+    effect.set_param("budget", 8);
+    effect.advance(1000);
+    REQUIRE(effect.led(0, 1) == 0xffffff);
+    REQUIRE(effect.led(0, 2) == 0);
+    effect.advance(1000);
+    REQUIRE(effect.led(0, 3) == 0xffffff);
+    effect.set_program("rgb(1, 0, 0)");
+    effect.advance(0);
+    REQUIRE(effect.led(0, 0) == 0xff0000);
+    REQUIRE_THROWS_AS(effect.set_program("rgb("), std::invalid_argument);
+    REQUIRE_THROWS_AS(effect.set_param("budget", std::nan("")), std::invalid_argument);
+    // clamped, a whole frame per tick
+    effect.set_param("budget", 1e30);
+    effect.set_program("rgb(0, 1, 0)");
+    effect.advance(0);
+    REQUIRE(effect.led(0, 3) == 0x00ff00);
+}
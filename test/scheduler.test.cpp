@@ -0,0 +1,68 @@
+#include "scheduler.hpp"
+#include "fade.hpp"
+#include "animation.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+using namespace ohtoai::rpi;
+using namespace std::chrono_literals;
+
+TEST_CASE("Scheduler runs tasks at a fixed rate and drops missed ticks", "[scheduler]") {
+    RenderScheduler scheduler;
+    int runs = 0;
+    auto start = RenderScheduler::Clock::now();
+    scheduler.every(10ms, [&](auto) { return ++runs < 3 ? TaskResult::changed : TaskResult::done; });
+    // due right away, then once per period
+    REQUIRE(scheduler.tick(start + 1ms) == 1);
+    REQUIRE(scheduler.tick(start + 5ms) == 0);
+    // a long stall runs the task once, not once per missed period
+    REQUIRE(scheduler.tick(start + 100ms) == 1);
+    REQUIRE(scheduler.tick(start + 200ms) == 1);
+    REQUIRE(runs == 3);
+    REQUIRE(scheduler.size() == 0);
+
+    scheduler.every(10ms, [&](auto) { return TaskResult::idle; });
+    REQUIRE(scheduler.tick(start + 300ms) == 0);
+    REQUIRE(scheduler.size() == 1);
+}
+
+TEST_CASE("Fade kernels scale every channel", "[scheduler]") {
+    std::vector<LedColor> leds(5, 0x80ff4002);
+    fade(leds.data(), leds.size(), 127);
+    REQUIRE(leds[0] == 0x407f2001);
+    fade(leds.data(), leds.size(), 255);
+    REQUIRE(leds[4] == 0x407f2001);
+
+    struct Linear {
+        int width() const { return 5; }
+        int height() const { return 1; }
+        int index(int x, int) const { return x; }
+    } device;
+    DecayMap map(5);
+    map.set_region(device, 3, 0, 10, 1, 0);
+    map.apply(leds.data(), leds.size());
+    REQUIRE(leds[2] == 0x407f2001);
+    REQUIRE(leds[3] == 0);
+    REQUIRE(leds[4] == 0);
+}
+
+TEST_CASE("Animation tracks interpolate with easing and finish on the last key", "[scheduler]") {
+    Track position({{0, 0}, {1000, 100, Easing::ease_in}, {2000, 200}});
+    REQUIRE(position.value(0) == 0);
+    REQUIRE(position.value(500) == 50);
+    REQUIRE(position.value(1500) == 125);
+    REQUIRE(position.value(5000) == 200);
+
+    Track color({{0, Led::Black}, {100, Led::White}}, true);
+    REQUIRE(static_cast<LedColor>(color.value(100)) == Led::White);
+
+    AnimationEngine engine;
+    double x = -1;
+    auto start = AnimationEngine::Clock::now();
+    engine.start(Animation().add(position, [&](double v) { x = v; }), start);
+    REQUIRE(engine.evaluate(start + 500ms) == 1);
+    REQUIRE(x == 50);
+    engine.evaluate(start + 3000ms);
+    REQUIRE(x == 200);
+    REQUIRE(engine.size() == 0);
+}
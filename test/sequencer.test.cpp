@@ -0,0 +1,71 @@
+#include "sequencer.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+
+using namespace ohtoai::rpi;
+using namespace std::chrono_literals;
+
+namespace {
+    Scene scene(const std::string& name, uint32_t duration_ms, int at = -1) {
+        Scene scene;
+        scene.name = name;
+        scene.duration_ms = duration_ms;
+        scene.at = at;
+        return scene;
+    }
+
+    /// @brief advance until a cue comes, giving the worker time to prepare
+    std::string next(Sequencer& sequencer, Sequencer::Clock::time_point now, int second_of_day = 0) {
+        for (int attempt = 0; attempt < 1000; ++attempt) {
+            if (auto cue = sequencer.advance(now, second_of_day)) {
+                return cue->scene.name;
+            }
+            std::this_thread::sleep_for(1ms);
+        }
+        return "";
+    }
+}
+
+TEST_CASE("parse_time_of_day", "[sequencer]") {
+    REQUIRE(parse_time_of_day("") == -1);
+    REQUIRE(parse_time_of_day("07:30") == 7 * 3600 + 30 * 60);
+    REQUIRE(parse_time_of_day("23:59:59") == 86399);
+    REQUIRE_THROWS_AS(parse_time_of_day("24:00"), std::invalid_argument);
+    REQUIRE_THROWS_AS(parse_time_of_day("noon"), std::invalid_argument);
+}
+
+TEST_CASE("Sequencer rotates prepared scenes and interrupts at a time of day", "[sequencer]") {
+    std::atomic_int prepared = 0;
+    const auto render_thread = std::this_thread::get_id();
+    std::atomic_bool off_thread = true;
+    Sequencer sequencer([&](const Scene& scene) -> Sequencer::Frame {
+        off_thread = off_thread && std::this_thread::get_id() != render_thread;
+        ++prepared;
+        return std::make_shared<Pixmap>(static_cast<int>(scene.name.size()), 1);
+    });
+    sequencer.add(scene("clock", 1000));
+    sequencer.add(scene("logo", 500));
+    sequencer.add(scene("news", 2000, 12 * 3600));
+    const auto start = Sequencer::Clock::now();
+    REQUIRE_FALSE(sequencer.advance(start, 0));
+
+    sequencer.start();
+    REQUIRE(next(sequencer, start) == "clock");
+    // the successor is prepared while clock shows, it only switches when clock is over
+    std::this_thread::sleep_for(20ms);
+    REQUIRE_FALSE(sequencer.advance(start + 999ms, 0));
+    REQUIRE(next(sequencer, start + 1000ms) == "logo");
+    REQUIRE(next(sequencer, start + 1500ms) == "clock");
+
+    // the scheduled scene gets prepared ahead and cuts in at its second
+    REQUIRE_FALSE(sequencer.advance(start + 1600ms, 12 * 3600 - 10));
+    REQUIRE(next(sequencer, start + 1700ms, 12 * 3600) == "news");
+    REQUIRE_FALSE(sequencer.advance(start + 1800ms, 12 * 3600));
+    // then the rotation carries on where it left
+    REQUIRE(next(sequencer, start + 3700ms, 12 * 3600 + 2) == "logo");
+
+    sequencer.skip();
+    REQUIRE(next(sequencer, start + 3800ms, 12 * 3600 + 3) == "clock");
+    REQUIRE(off_thread);
+    REQUIRE(prepared >= 5);
+}
@@ -0,0 +1,62 @@
+#include "transition.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+using namespace ohtoai::rpi;
+
+namespace {
+    void fill(Pixmap& pixmap, LedColor color) {
+        std::fill_n(pixmap.data(), pixmap.size(), color);
+    }
+
+    size_t count(const Pixmap& pixmap, LedColor color) {
+        return static_cast<size_t>(std::count(pixmap.data(), pixmap.data() + pixmap.size(), color));
+    }
+}
+
+TEST_CASE("Transitions start at the snapshot and end at the next source", "[transition]") {
+    Pixmap dst(8, 4), next(8, 4);
+    for (auto kind : {TransitionKind::crossfade, TransitionKind::wipe, TransitionKind::slide, TransitionKind::dissolve}) {
+        for (auto direction : {Direction::left, Direction::right, Direction::up, Direction::down}) {
+            fill(dst, Led::Red);
+            fill(next, Led::Blue);
+            Transition transition(kind, dst, 100, direction);
+            fill(dst, Led::Black);
+            REQUIRE(transition.render(dst, next, 0));
+            REQUIRE(count(dst, Led::Red) == dst.size());
+            REQUIRE_FALSE(transition.render(dst, next, 100));
+            REQUIRE(count(dst, Led::Blue) == dst.size());
+        }
+    }
+}
+
+TEST_CASE("Transitions halfway", "[transition]") {
+    Pixmap dst(8, 4), next(8, 4);
+    fill(next, Led::Blue);
+    auto halfway = [&](TransitionKind kind, Direction direction) {
+        fill(dst, Led::Red);
+        next.led_ref(0, 0) = Led::Green;
+        Transition transition(kind, dst, 100, direction);
+        transition.render(dst, next, 50);
+    };
+
+    halfway(TransitionKind::crossfade, Direction::left);
+    REQUIRE(dst.led(3, 2) == mix(Led::Red, Led::Blue, 127));
+
+    halfway(TransitionKind::wipe, Direction::right);
+    REQUIRE(dst.led(0, 0) == Led::Green);
+    REQUIRE(dst.led(3, 3) == Led::Blue);
+    REQUIRE(dst.led(4, 0) == Led::Red);
+
+    // the first column of the next source has moved in to the middle
+    halfway(TransitionKind::slide, Direction::left);
+    REQUIRE(dst.led(3, 0) == Led::Red);
+    REQUIRE(dst.led(4, 0) == Led::Green);
+    REQUIRE(dst.led(5, 0) == Led::Blue);
+
+    halfway(TransitionKind::slide, Direction::down);
+    REQUIRE(dst.led(0, 0) == Led::Blue);
+    REQUIRE(dst.led(0, 2) == Led::Red);
+
+    halfway(TransitionKind::dissolve, Direction::left);
+    REQUIRE(count(dst, Led::Red) == dst.size() / 2);
+}
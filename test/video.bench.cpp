@@ -0,0 +1,31 @@
+#include "video.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <vector>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("1080p yuv420p frame down to a 64x32 panel", "[benchmark]") {
+    constexpr int w = 1920, h = 1080;
+    std::vector<uint8_t> luma(static_cast<size_t>(w) * h), chroma(static_cast<size_t>(w / 2) * (h / 2));
+    for (size_t i = 0; i < luma.size(); ++i) {
+        luma[i] = static_cast<uint8_t>(i * 7);
+    }
+    for (size_t i = 0; i < chroma.size(); ++i) {
+        chroma[i] = static_cast<uint8_t>(i * 13);
+    }
+    std::vector<uint8_t> yuv(static_cast<size_t>(w) * 3);
+    std::vector<LedColor> panel(64 * 32);
+    AreaScaler scaler(w, h, 64, 32);
+
+    BENCHMARK("interleave, average and convert") {
+        scaler.begin(panel.data());
+        for (int y = 0; y < h; ++y) {
+            const size_t c = static_cast<size_t>(y / 2) * (w / 2);
+            interleave_yuv(luma.data() + static_cast<size_t>(y) * w, chroma.data() + c, chroma.data() + c, yuv.data(), w);
+            scaler.push_row(yuv.data());
+        }
+        yuv_to_rgb(panel.data(), panel.data(), panel.size());
+        return panel[0];
+    };
+}
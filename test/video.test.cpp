@@ -0,0 +1,110 @@
+#include "video.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+
+using namespace ohtoai::rpi;
+
+TEST_CASE("yuv_to_rgb with BT.601 limited range", "[video]") {
+    const uint8_t y[] = {235, 16, 81, 145}, u[] = {128, 90}, v[] = {128, 240};
+    uint8_t packed[12];
+    interleave_yuv(y, u, v, packed, 4);
+    REQUIRE(std::vector<uint8_t>(packed + 6, packed + 12) == std::vector<uint8_t>{81, 90, 240, 145, 90, 240});
+    std::vector<LedColor> yuv, rgb(4);
+    for (int i = 0; i < 4; ++i) {
+        yuv.push_back(static_cast<LedColor>(packed[i * 3] << 16 | packed[i * 3 + 1] << 8 | packed[i * 3 + 2]));
+    }
+    yuv_to_rgb(yuv.data(), rgb.data(), rgb.size());
+    REQUIRE(rgb[0] == 0xffffff);
+    REQUIRE(rgb[1] == 0x000000);
+    // red within a step, then a lighter pixel sharing its chroma
+    REQUIRE((rgb[2] >> 16) >= 254);
+    REQUIRE((rgb[2] & 0xffff) <= 0x0101);
+    REQUIRE((rgb[3] >> 16) == 255);
+}
+
+TEST_CASE("AreaScaler averages covered areas exactly", "[video]") {
+    auto scale = [](int sw, int sh, int dw, int dh, const std::vector<uint8_t>& grey) {
+        AreaScaler scaler(sw, sh, dw, dh);
+        std::vector<LedColor> out(static_cast<size_t>(dw) * dh);
+        scaler.begin(out.data());
+        std::vector<uint8_t> rgb(static_cast<size_t>(sw) * 3);
+        for (int y = 0; y < sh; ++y) {
+            for (int x = 0; x < sw; ++x) {
+                std::fill_n(rgb.begin() + x * 3, 3, grey[static_cast<size_t>(y) * sw + x]);
+            }
+            scaler.push_row(rgb.data());
+        }
+        std::vector<int> blue;
+        for (auto c : out) {
+            blue.push_back(static_cast<int>(c & 0xff));
+        }
+        return blue;
+    };
+    REQUIRE(scale(4, 2, 2, 1, {0, 40, 100, 100, 20, 60, 100, 200}) == std::vector<int>{30, 125});
+    // each output takes one and a half inputs: (30 + 60 / 2) / 1.5 and (60 / 2 + 90) / 1.5
+    REQUIRE(scale(3, 1, 2, 1, {30, 60, 90}) == std::vector<int>{40, 80});
+    REQUIRE(scale(2, 1, 4, 3, {10, 200}) == std::vector<int>{10, 10, 200, 200, 10, 10, 200, 200, 10, 10, 200, 200});
+    // 4096 x 4200 white would overflow the 32 bit sums
+    REQUIRE_THROWS_AS(AreaScaler(4096, 4200, 16, 16), std::invalid_argument);
+}
+
+TEST_CASE("VideoStream drops frames that are overdue", "[video]") {
+    auto path = (std::filesystem::temp_directory_path() / "ws2812_video_test.rgb").string();
+    {
+        auto file = std::fopen(path.c_str(), "wb");
+        for (int frame = 0; frame < 3; ++frame) {
+            for (int i = 0; i < 4 * 2; ++i) {
+                const uint8_t rgb[3] = {static_cast<uint8_t>(frame * 100), 0, 0};
+                std::fwrite(rgb, 1, 3, file);
+            }
+        }
+        std::fclose(file);
+    }
+    VideoStream stream(path, {4, 2, VideoPixelFormat::rgb24, 10}, 2, 1);
+    for (int i = 0; i < 1000 && stream.decoded() < 3; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    LedColor frame[2] = {};
+    REQUIRE(stream.frame_at(0, frame));
+    REQUIRE(frame[1] == 0);
+    REQUIRE_FALSE(stream.frame_at(50, frame));
+    // frames at 100 and 200 ms are both due, only the newer one is shown
+    REQUIRE(stream.frame_at(250, frame));
+    REQUIRE(frame[0] == 0xc80000);
+    REQUIRE(stream.dropped() == 1);
+    // the reader sees the end of the file after queueing the last frame
+    for (int i = 0; i < 1000 && !stream.finished(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(stream.finished());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("VideoStream clamps fps into a range that keeps timestamps defined", "[video]") {
+    auto path = (std::filesystem::temp_directory_path() / "ws2812_video_fps_test.rgb").string();
+    {
+        auto file = std::fopen(path.c_str(), "wb");
+        const uint8_t rgb[2 * 3] = {};
+        std::fwrite(rgb, 1, sizeof(rgb), file);
+        std::fwrite(rgb, 1, sizeof(rgb), file);
+        std::fclose(file);
+    }
+    REQUIRE_THROWS_AS(VideoStream(path, {2, 1, VideoPixelFormat::rgb24, 0}, 2, 1), std::invalid_argument);
+    REQUIRE_THROWS_AS(VideoStream(path, {2, 1, VideoPixelFormat::rgb24, std::nan("")}, 2, 1), std::invalid_argument);
+    for (const double fps : {1e-300, 1e300, std::numeric_limits<double>::infinity()}) {
+        VideoStream stream(path, {2, 1, VideoPixelFormat::rgb24, fps}, 2, 1);
+        for (int i = 0; i < 1000 && stream.decoded() < 2; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        LedColor frame[2] = {};
+        REQUIRE(stream.frame_at(0, frame));
+        // the second frame lands 1 ms later at the top of the range and 100 s later at the bottom
+        const uint32_t second = fps < 1 ? 100000 : 1;
+        REQUIRE_FALSE(stream.frame_at(second - 1, frame));
+        REQUIRE(stream.frame_at(second, frame));
+    }
+    std::filesystem::remove(path);
+}